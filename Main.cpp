@@ -1,1275 +1,8005 @@
-/*
- * Programmer: Jason Carruthers
- * Last modified: 2/9/16
- *
- * This program implements a z-buffer, though it is modified by my own design as a
- * combination of the z-buffer and a-buffer algorithms found in the book, as I
- * have given triangles (and potentially any polygon) the ability to have
- * transparency.
- * NOTE: This program assumes orthographic projection.
- */
-#include <GL/glut.h>
-#include <math.h>
-#include <list>
-#include <vector>
-#include <ctime>
-#include <map>
-
-
-
-/*
-* Classes
-*/
-class Color3
-{
-public:
-	enum RGBParameters
-	{
-		Red,
-		Green,
-		Blue,
-		Num__RGBParameters,
-	};
-public:
-	//Constructors
-	Color3(float red = 1.0f, float green = 1.0f, float blue = 1.0f)
-	{
-		SetR(red);
-		SetG(green);
-		SetB(blue);
-	}
-
-	//Accessors
-	float GetR() const
-	{
-		return mRGB[(int)Red];
-	}
-	float GetG() const
-	{
-		return mRGB[(int)Green];
-	}
-	float GetB() const
-	{
-		return mRGB[(int)Blue];
-	}
-
-	//Mutators
-	void Set(const Color3 &color)
-	{
-		SetR(color.GetR());
-		SetG(color.GetG());
-		SetB(color.GetB());
-	}
-	void Set(float newRed, float newGreen, float newBlue)
-	{
-		SetR(newRed);
-		SetG(newGreen);
-		SetB(newBlue);
-	}
-	void SetR(float newRed)
-	{
-		newRed = (newRed < 0.0f) ? 0.0f : newRed;
-		newRed = (newRed > 1.0f) ? 1.0f : newRed;
-		mRGB[(int)Red] = newRed;
-	}
-	void SetG(float newGreen)
-	{
-		newGreen = (newGreen < 0.0f) ? 0.0f : newGreen;
-		newGreen = (newGreen > 1.0f) ? 1.0f : newGreen;
-		mRGB[(int)Green] = newGreen;
-	}
-	void SetB(float newBlue)
-	{
-		newBlue = (newBlue < 0.0f) ? 0.0f : newBlue;
-		newBlue = (newBlue > 1.0f) ? 1.0f : newBlue;
-		mRGB[(int)Blue] = newBlue;
-	}
-
-	//Overloaded operators
-	float &operator[](int index)
-	{
-		if (index < 0 || index >= (int)Num__RGBParameters)
-			return mRGB[(int)Red]; //If index out of bounds, return the red value by default.
-		return mRGB[index];
-	}
-	const float &operator[](int index) const
-	{
-		if (index < 0 || index >= (int)Num__RGBParameters)
-			return mRGB[(int)Red]; //If index is out of bounds, return the first element by default.
-		return mRGB[index];
-	}
-
-private:
-	float mRGB[Num__RGBParameters];
-};
-
-
-//Color4 is like Color3 but has an alpha value
-class Color4
-{
-public:
-	enum RGBAParameters
-	{
-		Red,
-		Green,
-		Blue,
-		Alpha,
-		Num__RGBAParameters,
-	};
-public:
-	//Constructors
-	Color4(float red = 1.0f, float green = 1.0f, float blue = 1.0f, float alpha = 1.0f)
-	{
-		SetR(red);
-		SetG(green);
-		SetB(blue);
-		SetA(alpha);
-	}
-
-	//Accessors
-	float GetR() const
-	{
-		return mRGBA[(int)Red];
-	}
-	float GetG() const
-	{
-		return mRGBA[(int)Green];
-	}
-	float GetB() const
-	{
-		return mRGBA[(int)Blue];
-	}
-	float GetA() const
-	{
-		return mRGBA[(int)Alpha];
-	}
-	Color3 GetColor3() const
-	{
-		return Color3(mRGBA[(int)Red], mRGBA[(int)Green], mRGBA[(int)Blue]);
-	}
-
-	//Mutators
-	void Set(const Color4 &color)
-	{
-		SetR(color.GetR());
-		SetG(color.GetG());
-		SetB(color.GetB());
-		SetA(color.GetA());
-	}
-	void Set(float newRed, float newGreen, float newBlue, float newAlpha)
-	{
-		SetR(newRed);
-		SetG(newGreen);
-		SetB(newBlue);
-		SetA(newAlpha);
-	}
-	void SetR(float newRed)
-	{
-		newRed = (newRed < 0.0f) ? 0.0f : newRed;
-		newRed = (newRed > 1.0f) ? 1.0f : newRed;
-		mRGBA[(int)Red] = newRed;
-	}
-	void SetG(float newGreen)
-	{
-		newGreen = (newGreen < 0.0f) ? 0.0f : newGreen;
-		newGreen = (newGreen > 1.0f) ? 1.0f : newGreen;
-		mRGBA[(int)Green] = newGreen;
-	}
-	void SetB(float newBlue)
-	{
-		newBlue = (newBlue < 0.0f) ? 0.0f : newBlue;
-		newBlue = (newBlue > 1.0f) ? 1.0f : newBlue;
-		mRGBA[(int)Blue] = newBlue;
-	}
-	void SetA(float newAlpha)
-	{
-		newAlpha = (newAlpha < 0.0f) ? 0.0f : newAlpha;
-		newAlpha = (newAlpha > 1.0f) ? 1.0f : newAlpha;
-		mRGBA[(int)Alpha] = newAlpha;
-	}
-
-	//Overloaded operators
-	float &operator[](int index)
-	{
-		if (index < 0 || index >= (int)Num__RGBAParameters)
-			return mRGBA[(int)Red]; //If index out of bounds, return the red value by default.
-		return mRGBA[index];
-	}
-	const float &operator[](int index) const
-	{
-		if (index < 0 || index >= (int)Num__RGBAParameters)
-			return mRGBA[(int)Red]; //If index is out of bounds, return the first element by default.
-		return mRGBA[index];
-	}
-
-private:
-	float mRGBA[Num__RGBAParameters];
-};
-
-class Vector2I
-{
-public:
-	enum VectorElements
-	{
-		X,
-		Y,
-		Num__Elements,
-	};
-public:
-	//Constructors
-	Vector2I(int x = 0, int y = 0)
-	{
-		mArr[X] = x;
-		mArr[Y] = y;
-	}
-
-	//Accessors
-	int GetX() const
-	{
-		return mArr[X];
-	}
-	int GetY() const
-	{
-		return mArr[Y];
-	}
-
-	//Mutators
-	void SetX(int newX)
-	{
-		mArr[X] = newX;
-	}
-	void SetY(int newY)
-	{
-		mArr[Y] = newY;
-	}
-
-	//Overloaded operators
-	int &operator[](int index)
-	{
-		if (index < 0 || index >= (int)Num__Elements)
-			return mArr[X]; //If index is out of bounds, return the first element by default.
-		return mArr[index];
-	}
-	const int &operator[](int index) const
-	{
-		if (index < 0 || index >= (int)Num__Elements)
-			return mArr[X]; //If index is out of bounds, return the first element by default.
-		return mArr[index];
-	}
-	friend bool operator== (Vector2I &pair1, Vector2I &pair2)
-	{
-		return (pair1.GetX() == pair2.GetX() && pair1.GetY() == pair2.GetY());
-	}
-
-private:
-	int mArr[Num__Elements];
-};
-
-
-class Vector3I
-{
-public:
-	enum VectorElements
-	{
-		X,
-		Y,
-		Z,
-		Num__Elements,
-	};
-public:
-	//Constructors
-	Vector3I(int x = 0, int y = 0, int z = 0)
-	{
-		mArr[X] = x;
-		mArr[Y] = y;
-		mArr[Z] = z;
-	}
-
-	//Accessors
-	int GetX() const
-	{
-		return mArr[X];
-	}
-	int GetY() const
-	{
-		return mArr[Y];
-	}
-	int GetZ() const
-	{
-		return mArr[Z];
-	}
-
-	//Mutators
-	void SetX(int newX)
-	{
-		mArr[X] = newX;
-	}
-	void SetY(int newY)
-	{
-		mArr[Y] = newY;
-	}
-	void SetZ(int newZ)
-	{
-		mArr[Z] = newZ;
-	}
-
-	//Overloaded operators
-	int &operator[](int index)
-	{
-		if (index < 0 || index >= (int)Num__Elements)
-			return mArr[X]; //If index is out of bounds, return the first element by default.
-		return mArr[index];
-	}
-	const int &operator[](int index) const
-	{
-		if (index < 0 || index >= (int)Num__Elements)
-			return mArr[X]; //If index is out of bounds, return the first element by default.
-		return mArr[index];
-	}
-	friend bool operator== (Vector3I &coord1, Vector3I &coord2)
-	{
-		return (coord1.GetX() == coord2.GetX() && coord1.GetY() == coord2.GetY() && coord1.GetZ() == coord2.GetZ());
-	}
-
-private:
-	int mArr[Num__Elements];
-};
-
-
-class Vector2F
-{
-public:
-	enum VectorElements
-	{
-		X,
-		Y,
-		Num__Elements,
-	};
-public:
-	//Constructors
-	Vector2F(float x = 0, float y = 0)
-	{
-		mArr[X] = x;
-		mArr[Y] = y;
-	}
-
-	//Accessors
-	float GetX() const
-	{
-		return mArr[X];
-	}
-	float GetY() const
-	{
-		return mArr[Y];
-	}
-
-	//Mutators
-	void SetX(float newX)
-	{
-		mArr[X] = newX;
-	}
-	void SetY(float newY)
-	{
-		mArr[Y] = newY;
-	}
-
-	//Overloaded operators
-	float &operator[](int index)
-	{
-		if (index < 0 || index >= (int)Num__Elements)
-			return mArr[X]; //If index is out of bounds, return the first element by default.
-		return mArr[index];
-	}
-	const float &operator[](int index) const
-	{
-		if (index < 0 || index >= (int)Num__Elements)
-			return mArr[X]; //If index is out of bounds, return the first element by default.
-		return mArr[index];
-	}
-	friend bool operator== (Vector2F &pair1, Vector2F &pair2)
-	{
-		return (pair1.GetX() == pair2.GetX() && pair1.GetY() == pair2.GetY());
-	}
-
-private:
-	float mArr[Num__Elements];
-};
-
-
-class Vector3F
-{
-public:
-	enum VectorElements
-	{
-		X,
-		Y,
-		Z,
-		Num__Elements,
-	};
-public:
-	//Constructors
-	Vector3F(float x = 0, float y = 0, float z = 0)
-	{
-		mArr[X] = x;
-		mArr[Y] = y;
-		mArr[Z] = z;
-	}
-
-	//Accessors
-	float GetX() const
-	{
-		return mArr[X];
-	}
-	float GetY() const
-	{
-		return mArr[Y];
-	}
-	float GetZ() const
-	{
-		return mArr[Z];
-	}
-
-	//Mutators
-	void SetX(float newX)
-	{
-		mArr[X] = newX;
-	}
-	void SetY(float newY)
-	{
-		mArr[Y] = newY;
-	}
-	void SetZ(float newZ)
-	{
-		mArr[Z] = newZ;
-	}
-
-	//Overloaded operators
-	float &operator[](int index)
-	{
-		if (index < 0 || index >= (int)Num__Elements)
-			return mArr[X]; //If index is out of bounds, return the first element by default.
-		return mArr[index];
-	}
-	const float &operator[](int index) const
-	{
-		if (index < 0 || index >= (int)Num__Elements)
-			return mArr[X]; //If index is out of bounds, return the first element by default.
-		return mArr[index];
-	}
-	friend bool operator== (Vector3F &coord1, Vector3F &coord2)
-	{
-		return (coord1.GetX() == coord2.GetX() && coord1.GetY() == coord2.GetY() && coord1.GetZ() == coord2.GetZ());
-	}
-
-private:
-	float mArr[Num__Elements];
-};
-
-
-/*
-* Global variables that class Triangle relies on
-*/
-const unsigned int WINDOW_WIDTH = 800;
-const unsigned int WINDOW_HEIGHT = 600;
-const int Z_NEAR = 0;
-const int Z_FAR = -1000;
-const unsigned int SLEEP_DURATION = 1;
-float *pixelBuffer;
-
-
-//Class prototypes
-class Triangle;
-
-//Function prototypes that class Triangle relies on
-void SetPixel(int x, int y, const Color3 &color);
-void UpdateTriangleAndDepthBuffer(Triangle &triangle, const Vector3F &newRelativePosition);
-
-
-
-/*
-* Some triangles aren't displaying correctly, such as the following case(s):
-*		- Drawing a triangle with one vertical edge
-* There may be other cases where the triangle doesn't display properly, but so far
-* the above case(s) are the only ones that have been tested.
-*/
-class Triangle
-{
-public:
-	/*
-	* Constructor
-	*/
-	Triangle(){}
-	Triangle(const Color4 &newColor, const Vector3F &p1, const Vector3F &p2, const Vector3F &p3) :
-		Triangle(p1, p2, p3)
-	{
-		color = newColor;
-	}
-	Triangle(const Vector3F &p1, const Vector3F &p2, const Vector3F &p3)
-	{
-		/*
-		* Sort points by y value, from least to greatest
-		*/
-		vertexArr[0] = p1;
-		vertexArr[1] = p2;
-		vertexArr[2] = p3;
-		for (int i = 0; i < 3; i++)
-		{
-			for (int j = i + 1; j < 3; j++)
-			{
-				if (vertexArr[j].GetY() < vertexArr[i].GetY())
-				{
-					Vector3F temp = vertexArr[j];
-					vertexArr[j] = vertexArr[i];
-					vertexArr[i] = temp;
-				}
-			}
-		}
-
-		/*
-		* If this triangle has a horizontal edge, ensure the two vertices with the same
-		* y-value are also sorted by x-value, from least to greatest x-value.
-		*/
-		if (vertexArr[0].GetY() == vertexArr[1].GetY())
-		{
-			if (vertexArr[0].GetX() > vertexArr[1].GetX())
-			{
-				float tempX = vertexArr[0].GetX();
-				vertexArr[0].SetX(vertexArr[1].GetX());
-				vertexArr[1].SetX(tempX);
-			}
-		}
-		if (vertexArr[1].GetY() == vertexArr[2].GetY())
-		{
-			if (vertexArr[1].GetX() > vertexArr[2].GetX())
-			{
-				float tempX = vertexArr[1].GetX();
-				vertexArr[1].SetX(vertexArr[2].GetX());
-				vertexArr[2].SetX(tempX);
-			}
-		}
-
-		SetRelativeXPairs();
-		relativePosition = Vector3F(0, 0, 0);
-		//UpdatePixelInfo(relativePosition);
-		UpdateTriangleAndDepthBuffer(*this, relativePosition);
-		SetNormalVector();
-	}
-
-	/*
-	* Accessors
-	*/
-public:
-	Color3 GetColor3() const
-	{
-		return Color3(color.GetR(), color.GetG(), color.GetB());
-	}
-
-	/*
-	 * Instead of drawing a triangle directly to the screen (by calling SetPixel), now all Draw()
-	 * functions should update the zbuffer, and each cycle the zbuffer should draw.
-	 */
-	void Draw(const Color3 &color) const
-	{
-		for (unsigned int relativeY = 0; relativeY < relativeXPairVec.size(); relativeY++)
-			for (int x = relativeXPairVec[relativeY].GetX(); x < relativeXPairVec[relativeY].GetY(); x++)
-				SetPixel(x + GetBaseX(relativeY + (int)vertexArr[0].GetY()) + (int)relativePosition.GetX(),
-				relativeY + (int)vertexArr[0].GetY() + (int)relativePosition.GetY(),
-				color);
-
-		/*
-		* Both of these functions update the pixels onscreen, so that each time a new pixel
-		* is "added to" pixelBuffer, it immediately draws onscreen. This way, the lines
-		* animate as they're drawn to the screen.
-		*/
-		//Draws pixel on screen, width and height must match pixel buffer dimension
-		glDrawPixels(WINDOW_WIDTH, WINDOW_HEIGHT, GL_RGB, GL_FLOAT, pixelBuffer);
-		//Window refresh
-		glFlush();
-	}
-
-	int GetBaseX(int worldY) const
-	{
-		//If has horizontal edge...
-		if (vertexArr[0].GetY() == vertexArr[1].GetY() || vertexArr[1].GetY() == vertexArr[2].GetY())
-			return (int)vertexArr[0].GetX();
-
-		//Otherwise, no horizontal edge...
-		if (worldY < vertexArr[1].GetY())
-			return (int)vertexArr[0].GetX();
-		else //if y >= vertexArr[1].GetY()
-		{
-			if (vertexArr[0].GetX() > vertexArr[1].GetX())
-				return (int)vertexArr[1].GetX();
-
-			//Otherwise, this triangle is oriented with its nose in the 3rd quadrant, if
-			//seen as being pivoted by its y-middle vertex. Thus, the x offset is
-			//the same as the bottom left vertex x value of its horizontal-split
-			//upper-triangle.
-			float slope = (vertexArr[2].GetY() - vertexArr[0].GetY()) / (vertexArr[2].GetX() - vertexArr[0].GetX());
-			float pairPtX = ((vertexArr[1].GetY() - vertexArr[0].GetY()) / slope) + vertexArr[0].GetX();
-			return (int)pairPtX;
-		}
-	}
-
-	int GetWorldZ(int worldX, int worldY) const
-	{
-		return (int)((-1 / normalVec[2])*(normalVec[0] * (worldX - vertexArr[0].GetX()) + normalVec[1] * (worldY - vertexArr[0].GetY())) + vertexArr[0].GetZ());
-	}
-
-	/*
-	* Mutators
-	*/
-public:
-	void SetNormalVector()
-	{
-		Vector3F leftEdge(vertexArr[1].GetX() - vertexArr[0].GetX(),
-							vertexArr[1].GetY() - vertexArr[0].GetY(), 
-							vertexArr[1].GetZ() - vertexArr[0].GetZ());
-
-		Vector3F rightEdge(vertexArr[2].GetX() - vertexArr[0].GetX(),
-							vertexArr[2].GetY() - vertexArr[0].GetY(),
-							vertexArr[2].GetZ() - vertexArr[0].GetZ());
-
-		float normalVecX = leftEdge.GetY()*rightEdge.GetZ() - leftEdge.GetZ()*rightEdge.GetY();
-		float normalVecY = leftEdge.GetZ()*rightEdge.GetX() - leftEdge.GetX()*rightEdge.GetZ();
-		float normalVecZ = leftEdge.GetX()*rightEdge.GetY() - leftEdge.GetY()*rightEdge.GetX();
-		normalVec = Vector3F(normalVecX, normalVecY, normalVecZ);
-	}
-
-	//This function should always be called before this triangle's Draw() function is called.
-	//void UpdatePosition(const Vector3F &newRelativeXYPosition)
-	//{
-	//	//Turn all pixels representing previous position to black
-	//	//for (unsigned int pixel = 0; pixel < pixelInfoVec.size(); pixel++)
-	//	//	for (int colorIndex = 0; colorIndex < (int)Color3::Num__RGBParameters; colorIndex++)
-	//	//		pixelBuffer[pixelInfoVec[pixel].GetX() * (int)Color3::Num__RGBParameters + pixelInfoVec[pixel].GetY() * WINDOW_WIDTH * (int)Color3::Num__RGBParameters + colorIndex] = 0.0f; //See pgs. 146-147 to optimize this.
-
-	//	UpdatePixelInfo(newRelativeXYPosition);
-	//}
-
-private:
-	//void UpdatePixelInfo(const Vector3F &newRelativePosition)
-	//{
-	//	relativePosition = newRelativePosition;
-	//	pixelInfoVec.clear();
-
-	//	int worldX, worldY, worldZ;
-	//	for (unsigned int scanLine = 0; scanLine < relativeXPairVec.size(); scanLine++)
-	//	{
-	//		for (int pixelX = (int)relativeXPairVec[scanLine].GetX(); pixelX < (int)relativeXPairVec[scanLine].GetY(); pixelX++)
-	//		{
-	//			worldX = GetBaseX(scanLine + (int)vertexArr[0].GetY()) + pixelX + (int)relativePosition.GetX();
-	//			worldY = (int)vertexArr[0].GetY() + (int)relativePosition.GetY() + scanLine;
-	//			worldZ = GetWorldZ(worldX, worldY);
-	//			pixelInfoVec.push_back(Vector3I(worldX, worldY, worldZ));
-	//		}
-	//	}
-	//}
-
-private:
-	void SetRelativeXPairs()
-	{
-		/*
-		* This function finds pairs of points along the edges of the triangle
-		* that share the same y value. Since each scan line is an integer value,
-		* relative y doesn't need to be explicitly stored, as it can be determined
-		* for a given relativeXPair by adding the index that the given pair is found
-		* at within the relativeXPairVec to the starting scan-line value.
-		*
-		* The xPairs are relative because the distance between edge-points on the same
-		* scan line doesn't differ, but a triangle can move around and have different
-		* screen position, thus affecting the offset x-values of all of its (edge) points.
-		*/
-
-		//If no two vertices share a y-value, horizontally split this triangle about its mid-vertex.
-		if (vertexArr[0].GetY() != vertexArr[1].GetY() && vertexArr[1].GetY() != vertexArr[2].GetY())
-		{
-			//Get point that x-pairs with the y-middle point of the triangle vertices
-			float slope = (vertexArr[2].GetY() - vertexArr[0].GetY()) / (vertexArr[2].GetX() - vertexArr[0].GetX());
-			float pairingPtX = ((vertexArr[1].GetY() - vertexArr[0].GetY()) / slope) + vertexArr[0].GetX();
-			Vector3F pairingPt = Vector3F(pairingPtX, vertexArr[1].GetY(), vertexArr[1].GetZ());
-
-			Triangle bottomTriangle(vertexArr[0], pairingPt, vertexArr[1]);
-			Triangle topTriangle(pairingPt, vertexArr[1], vertexArr[2]);
-
-			relativeXPairVec.insert(relativeXPairVec.begin(),
-				bottomTriangle.relativeXPairVec.begin(), bottomTriangle.relativeXPairVec.end());
-
-			//Check to see if they share the same xPair along the horizontal split, then remove it
-			//if (relativeXPairVec[relativeXPairVec.size() - 1] == topTriangle.relativeXPairVec[0])
-			//topTriangle.relativeXPairVec.erase(topTriangle.relativeXPairVec.begin());
-
-			relativeXPairVec.insert(relativeXPairVec.end(),
-				topTriangle.relativeXPairVec.begin(), topTriangle.relativeXPairVec.end());
-
-			return;
-		}
-
-		/*
-		* Otherwise, this triangle already has one horizontal edge.
-		* First, get the slope of the left edge and the slope of the right edge.
-		* Then for a given y value, get the corresponding x values from both slopes.
-		* Store those two x values as a pair (Vector2I) into the relativeXPairVec.
-		*/
-		float slopeLeftEdge;
-		float slopeRightEdge;
-		if (vertexArr[0].GetY() == vertexArr[1].GetY()) //If horizontal edge is along the bottom edge
-		{
-			slopeLeftEdge = (vertexArr[2].GetY() - vertexArr[0].GetY()) / (vertexArr[2].GetX() - vertexArr[0].GetX());
-			slopeRightEdge = (vertexArr[2].GetY() - vertexArr[1].GetY()) / (vertexArr[2].GetX() - vertexArr[1].GetX());
-		}
-		else //Else the horizontal edge must be along the top edge
-		{
-			slopeLeftEdge = (vertexArr[1].GetY() - vertexArr[0].GetY()) / (vertexArr[1].GetX() - vertexArr[0].GetX());
-			slopeRightEdge = (vertexArr[2].GetY() - vertexArr[0].GetY()) / (vertexArr[2].GetX() - vertexArr[0].GetX());
-		}
-
-		float leftPtX, rightPtX;
-		for (int y = (int)vertexArr[0].GetY(); y < (int)vertexArr[2].GetY(); y++)
-		{
-			if (vertexArr[0].GetY() == vertexArr[1].GetY()) //If horizontal edge is along the bottom edge
-			{
-				leftPtX = ((float)y - vertexArr[0].GetY()) / slopeLeftEdge;
-				rightPtX = (((float)y - vertexArr[1].GetY()) / slopeRightEdge) + (vertexArr[1].GetX() - vertexArr[0].GetX())/*+ 0.5f*/;
-			}
-			else //Else the horizontal edge must be along the top edge
-			{
-				leftPtX = ((float)y - vertexArr[0].GetY()) / slopeLeftEdge;
-				rightPtX = (((float)y - vertexArr[0].GetY()) / slopeRightEdge) /*+ 0.5f*/;
-			}
-			relativeXPairVec.push_back(Vector2I((int)leftPtX, (int)rightPtX));
-		}
-	}
-
-//Make this private later
-public:
-	Color4 color;
-	Vector3F vertexArr[3];
-	Vector3F relativePosition;
-	std::vector<Vector2I> relativeXPairVec; //stored as ints for drawing optimization
-	std::vector<Vector3I> pixelInfoVec;
-	Vector3F normalVec; /*
-						 * A vector normal to this triangle, and thus the plane containing this
-						 * triangle. Used to get the world-z coordinate given a local (x, y) point.
-						 * normalVec is relative to world coordinates.
-						 */
-};
-
-
-class DepthBuffer
-{
-public:
-	/*
-	 * Constructor
-	 */
-	DepthBuffer()
-	{
-		zBuffer = new std::vector<DepthInfo>[WINDOW_WIDTH * WINDOW_HEIGHT];
-		aBuffer = new std::vector<DepthInfo>[WINDOW_WIDTH * WINDOW_HEIGHT];
-		DepthInfo backgroundDepthInfo(Z_FAR, Color4(0.0f, 0.0f, 0.0f, 1.0f));
-		for (int y = 0; y < WINDOW_HEIGHT; y++)
-			for (int x = 0; x < WINDOW_WIDTH; x++)
-			{
-				zBuffer[x + y * WINDOW_WIDTH].push_back(backgroundDepthInfo);
-				aBuffer[x + y * WINDOW_WIDTH].push_back(backgroundDepthInfo);
-			}
-	}
-
-	/*
-	 * Accessors
-	 */
-	Color3 GetVisibleColor3(int x, int y) const
-	{
-		int bufferIndex = x + y * WINDOW_WIDTH;
-		return Color3(aBuffer[bufferIndex][aBuffer[bufferIndex].size() - 1].color.GetR(),
-						aBuffer[bufferIndex][aBuffer[bufferIndex].size() - 1].color.GetG(),
-						aBuffer[bufferIndex][aBuffer[bufferIndex].size() - 1].color.GetB());
-	}
-
-	void Draw() const
-	{
-		/*
-		 * The pixel that should be drawn at a given location is given by the greatest-indexed
-		 * aBuffer color.
-		 */
-		for (int y = 0; y < WINDOW_HEIGHT; y++)
-			for (int x = 0; x < WINDOW_WIDTH; x++)
-				SetPixel(x, y, GetVisibleColor3(x, y));
-
-		/*
-		* Both of these functions update the pixels onscreen, so that each time a new pixel
-		* is "added to" pixelBuffer, it immediately draws onscreen. This way, the lines
-		* animate as they're drawn to the screen.
-		*/
-		//Draws pixel on screen, width and height must match pixel buffer dimension
-		glDrawPixels(WINDOW_WIDTH, WINDOW_HEIGHT, GL_RGB, GL_FLOAT, pixelBuffer);
-		//Window refresh
-		glFlush();
-	}
-
-	/*
-	 * Mutators
-	 */
-	void MaskBuffers(const Triangle &triangleMask)
-	{
-		unsigned int worldX;
-		unsigned int worldY;
-		int worldZ;
-		unsigned int bufferIndex;
-		unsigned int bufferSize;
-		for (unsigned int i = 0; i < triangleMask.pixelInfoVec.size(); i++)
-		{
-			worldX = triangleMask.pixelInfoVec[i].GetX();
-			worldY = triangleMask.pixelInfoVec[i].GetY();
-			worldZ = triangleMask.pixelInfoVec[i].GetZ();
-			bufferIndex = worldX + worldY * WINDOW_WIDTH;
-			bufferSize = zBuffer[bufferIndex].size();
-			for (unsigned int zDepth = 0; zDepth < bufferSize; zDepth++)
-			{
-				if (zBuffer[bufferIndex][zDepth].depth == worldZ)
-				{
-					zBuffer[bufferIndex].erase(zBuffer[bufferIndex].begin() + zDepth);
-					aBuffer[bufferIndex].erase(aBuffer[bufferIndex].begin() + zDepth);
-					Color3 drawColor = aBuffer[bufferIndex][aBuffer[bufferIndex].size() - 1].color.GetColor3();
-					SetPixel(worldX, worldY, drawColor);
-					break;
-				}
-			}
-		}
-	}
-
-
-	void UpdateBuffers(int worldX, int worldY, int worldZ, const Color4 &newColor)
-	{
-		unsigned int bufferIndex;
-		unsigned int bufferSize;
-		unsigned int i = 0;
-
-		bufferIndex = worldX + worldY * WINDOW_WIDTH;
-		bufferSize = zBuffer[bufferIndex].size();
-
-		for (i = 0; i < bufferSize; i++)
-		{
-			if (zBuffer[bufferIndex][i].depth == worldZ)
-			{
-				zBuffer[bufferIndex][i].color = newColor;
-				aBuffer[bufferIndex][i].color = newColor;
-				break;
-			}
-			else if (worldZ < zBuffer[bufferIndex][i].depth)
-			{
-				zBuffer[bufferIndex].insert(zBuffer[bufferIndex].begin() + i, DepthInfo(worldZ, newColor));
-				aBuffer[bufferIndex].insert(aBuffer[bufferIndex].begin() + i, DepthInfo(worldZ, newColor));
-				break;
-			}
-		}
-		if (i == bufferSize)
-		{
-			zBuffer[bufferIndex].push_back(DepthInfo(worldZ, newColor));
-			aBuffer[bufferIndex].push_back(DepthInfo(worldZ, newColor));
-		}
-
-		//if (newColor.GetA() != 1.0f)
-		BlendABuffer(worldX, worldY);
-		SetPixel(worldX, worldY, aBuffer[bufferIndex][aBuffer[bufferIndex].size() - 1].color.GetColor3());
-	}
-	//void UpdateBuffers(const Triangle &triangle)
-	//{
-	//	unsigned int worldX;
-	//	unsigned int worldY;
-	//	int worldZ;
-	//	unsigned int bufferIndex;
-	//	unsigned int bufferSize;
-	//	unsigned int i = 0;
-	//	for (unsigned int pixel = 0; pixel < triangle.pixelInfoVec.size(); pixel++)
-	//	{
-	//		worldX = triangle.pixelInfoVec[pixel].GetX();
-	//		worldY = triangle.pixelInfoVec[pixel].GetY();
-	//		worldZ = triangle.pixelInfoVec[pixel].GetZ();
-	//		bufferIndex = worldX + worldY * WINDOW_WIDTH;
-	//		bufferSize = zBuffer[bufferIndex].size();
-	//		
-	//		for (i = 0; i < bufferSize; i++)
-	//		{
-	//			if (zBuffer[bufferIndex][i].depth == worldZ)
-	//			{
-	//				zBuffer[bufferIndex][i].color = triangle.color;
-	//				aBuffer[bufferIndex][i].color = triangle.color;
-	//				break;
-	//			}
-	//			else if (worldZ < zBuffer[bufferIndex][i].depth)
-	//			{
-	//				zBuffer[bufferIndex].insert(zBuffer[bufferIndex].begin() + i, DepthInfo(worldZ, triangle.color));
-	//				aBuffer[bufferIndex].insert(aBuffer[bufferIndex].begin() + i, DepthInfo(worldZ, triangle.color));
-	//				break;
-	//			}
-	//		}
-	//		if (i == bufferSize)
-	//		{
-	//			zBuffer[bufferIndex].push_back(DepthInfo(worldZ, triangle.color));
-	//			aBuffer[bufferIndex].push_back(DepthInfo(worldZ, triangle.color));
-	//		}
-
-	//		//if (newColor.GetA() != 1.0f)
-	//		BlendABuffer(worldX, worldY);
-	//		Color3 drawColor = aBuffer[bufferIndex][aBuffer[bufferIndex].size() - 1].color.GetColor3();
-	//		SetPixel(worldX, worldY, drawColor);
-	//	}
-	//}
-private:
-	void BlendABuffer(int x, int y)
-	{
-		int bufferIndex = x + y * WINDOW_WIDTH;
-
-		//Assume the background color is always completely opaque.
-		Color3 prevColor3 = aBuffer[bufferIndex][0].color.GetColor3();
-
-		for (unsigned int i = 1; i < aBuffer[bufferIndex].size(); i++)
-		{
-			//If the current pixel is completely opaque, then move onto the next color.
-			if (aBuffer[bufferIndex][i].color.GetA() == 1.0f)
-			{
-				prevColor3 = aBuffer[bufferIndex][i].color.GetColor3();
-				continue;
-			}
-
-			//Blend the current pixel color with the pixel color behind it.
-			aBuffer[bufferIndex][i].color.Set((aBuffer[bufferIndex][i].color.GetR() * aBuffer[bufferIndex][i].color.GetA() + prevColor3.GetR()) / 2,
-				(aBuffer[bufferIndex][i].color.GetG() * aBuffer[bufferIndex][i].color.GetA() + prevColor3.GetG()) / 2,
-				(aBuffer[bufferIndex][i].color.GetB() * aBuffer[bufferIndex][i].color.GetA() + prevColor3.GetB()) / 2,
-				1.0f);
-		}
-	}
-
-private:
-	class DepthInfo
-	{
-	public:
-		DepthInfo(int newDepth = Z_FAR, const Color4 &newColor = Color4(0.0f, 0.0f, 0.0f, 1.0f))
-		{
-			depth = newDepth;
-			color = newColor;
-		}
-	public:
-		int depth;
-		Color4 color;
-	};
-	/*
-	 * Both buffers store Color info sorted from most-positive z-value to most-negative z-value.
-	 * Thus, the pixel that should be drawn at a given location is given by the greatest-indexed
-	 * aBuffer color.
-	 */
-	//std::vector<DepthInfo> zBuffer[WINDOW_WIDTH * WINDOW_HEIGHT]; //Holds unmodified Color4 pixel info of polygons in the scene.
-	//std::vector<DepthInfo> aBuffer[WINDOW_WIDTH * WINDOW_HEIGHT]; //Holds blended Color4 pixel info of polygons in the scene.
-	std::vector<DepthInfo> *zBuffer; //Holds unmodified Color4 pixel info of polygons in the scene.
-	std::vector<DepthInfo> *aBuffer; //Holds blended Color4 pixel info of polygons in the scene.
-};
-
-
-
-/*
-* Global variables
-*/
-DepthBuffer depthBuffer;
-Triangle sun;
-std::vector<Triangle> planetVec;
-std::vector<Triangle> asteroidVec;
-Triangle alienPlanet;
-std::vector<Triangle> alienPlanetRingsVec;
-float theta = 0.0f;
-//Triangle testTriangle(Vector2F(0, 0), Vector2F(100, 0), Vector2F(50, 50)); //works
-//Triangle testTriangle(Vector2F(0, 100), Vector2F(100, 100), Vector2F(50, 150)); //works
-//Triangle testTriangle(Vector2F(0, 80), Vector2F(100, 100), Vector2F(50, 150)); //work
-//Triangle testTriangle(Vector2F(0, 0), Vector2F(10, 20), Vector2F(60, 300)); //works
-//Triangle testTriangle(Vector2F(0, 300), Vector2F(100, 100), Vector2F(50, 400)); //works
-//Triangle testTriangle(Vector2F(0, 100), Vector2F(100, 50), Vector2F(50, 150)); //works
-
-
-/*
-* Function prototypes
-*/
-void Display();
-Color4 GetRandomColor();
-void SetPixel(int x, int y, const Color3 &color);
-void CreateSolarSystem();
-void UpdatePlanets();
-void UpdateSolarSystem();
-void UpdateAsteroids();
-//void UpdateTriangleAndDepthBuffer(Triangle &trianlge, const Vector3F &newRelativePosition);
-
-
-/*
-* Functions
-*/
-int main(int argc, char *argv[])
-{
-	//Seed the random number generator
-	srand(((static_cast<int>(time(0)))));
-
-	//Allocate new pixel buffer, need initialization!!
-	pixelBuffer = new float[WINDOW_WIDTH * WINDOW_HEIGHT * 3];
-
-	glutInit(&argc, argv);
-	glutInitDisplayMode(GLUT_SINGLE | GLUT_RGB);
-	//Set window size to WINDOW_WIDTH*WINDOW_HEIGHT
-	glutInitWindowSize(WINDOW_WIDTH, WINDOW_HEIGHT);
-	//Set window position
-	glutInitWindowPosition(0, 0);
-
-	//Create and set main window title
-	int mainWindow = glutCreateWindow("Alpha Triangles in a 3D Coordinate System");
-	glClearColor(0, 0, 0, 0); //Clears the buffer of OpenGL; sets the background color to black.
-
-	//Init solar system
-	CreateSolarSystem();
-
-	//Sets display function
-	glutDisplayFunc(Display);
-
-	glutMainLoop();//Main display loop, will display until terminate
-	return 0;
-}
-
-
-
-//Main display loop, this function will be called again and again by OpenGL
-void Display()
-{
-	//Misc.
-	glClear(GL_COLOR_BUFFER_BIT);
-	glLoadIdentity();
-
-
-	while (true)
-	{
-		//Display triangles here...
-		//testTriangle.Draw(GetRandomColor());
-		UpdateSolarSystem();
-
-		//Draws pixel on screen, width and height must match pixel buffer dimension
-		glDrawPixels(WINDOW_WIDTH, WINDOW_HEIGHT, GL_RGB, GL_FLOAT, pixelBuffer);
-
-		//Window refresh
-		glFlush();
-
-		//Sleep(SLEEP_DURATION);
-	}
-}
-
-Color4 GetRandomColor()
-{
-	/*
-	* Set R, G, and B to a random number between 0.5 and 1.0, inclusive,
-	* and then return that color.
-	*/
-	float newR = 0.5f + ((rand() % 501) / 1000.0f);
-	float newG = 0.5f + ((rand() % 501) / 1000.0f);
-	float newB = 0.5f + ((rand() % 501) / 1000.0f);
-	float newA = 0.8f + ((rand() % 201) / 1000.0f);
-	return Color4(newR, newG, newB, newA);
-}
-
-void SetPixel(int x, int y, const Color3 &color)
-{
-	//Update the pixelBuffer
-	for (int colorIndex = 0; colorIndex < Color3::Num__RGBParameters; colorIndex++)
-	{
-		if ((x * (int)Color3::Num__RGBParameters + y * WINDOW_WIDTH * (int)Color3::Num__RGBParameters + colorIndex) < 0 ||
-			(x * (int)Color3::Num__RGBParameters + y * WINDOW_WIDTH * (int)Color3::Num__RGBParameters + colorIndex) >= WINDOW_WIDTH*WINDOW_HEIGHT * 3)
-			break;
-		pixelBuffer[x * (int)Color3::Num__RGBParameters + y * WINDOW_WIDTH * (int)Color3::Num__RGBParameters + colorIndex] = color[colorIndex]; //See pgs. 146-147 to optimize this.
-	}
-
-	//Sleep(SLEEP_DURATION);
-}
-
-void UpdateTriangleAndDepthBuffer(Triangle &triangle, const Vector3F &newRelativePosition)
-{
-	triangle.relativePosition = newRelativePosition;
-	triangle.pixelInfoVec.clear();
-
-	int worldX, worldY, worldZ;
-	for (unsigned int scanLine = 0; scanLine < triangle.relativeXPairVec.size(); scanLine++)
-	{
-		for (int pixelX = (int)triangle.relativeXPairVec[scanLine].GetX(); pixelX < (int)triangle.relativeXPairVec[scanLine].GetY(); pixelX++)
-		{
-			worldX = triangle.GetBaseX(scanLine + (int)triangle.vertexArr[0].GetY()) + pixelX + (int)triangle.relativePosition.GetX();
-			worldY = (int)triangle.vertexArr[0].GetY() + (int)triangle.relativePosition.GetY() + scanLine;
-			worldZ = triangle.GetWorldZ(worldX, worldY);
-			triangle.pixelInfoVec.push_back(Vector3I(worldX, worldY, worldZ));
-
-			depthBuffer.UpdateBuffers(worldX, worldY, worldZ, triangle.color);
-		}
-	}
-}
-
-
-
-void CreateSolarSystem()
-{
-	sun = Triangle(Color4(1.0f, 1.0f, 0.0f, 0.95f),
-		Vector3F(WINDOW_WIDTH / 2 - 50, WINDOW_HEIGHT / 2 - 50, -1.0f),
-		Vector3F(WINDOW_WIDTH / 2 + 50, WINDOW_HEIGHT / 2 - 30, -1.0f),
-		Vector3F(WINDOW_WIDTH / 2, WINDOW_HEIGHT / 2 + 20, -1.0f));
-
-	//Mercury
-	planetVec.push_back(Triangle(Color4(8.0f, 0.1f, 0.3f, 0.95f),
-		Vector3F(WINDOW_WIDTH / 2 - 20, WINDOW_HEIGHT / 2, -2.0f),
-		Vector3F(WINDOW_WIDTH / 2 + 10, WINDOW_HEIGHT / 2 - 20, -2.0f),
-		Vector3F(WINDOW_WIDTH / 2 + 35, WINDOW_HEIGHT / 2 + 30, -2.0f)));
-
-
-	////Venus
-	planetVec.push_back(Triangle(Color4(139 / 255.0f, 69 / 255.0f, 16 / 255.0f, 0.95f),
-		Vector3F(WINDOW_WIDTH / 2 - 15, WINDOW_HEIGHT / 2 - 10, -3.0f),
-		Vector3F(WINDOW_WIDTH / 2 + 5, WINDOW_HEIGHT / 2 - 5, -3.0f),
-		Vector3F(WINDOW_WIDTH / 2 + 25, WINDOW_HEIGHT / 2 + 40, -3.0f)));
-
-	////Earth
-	planetVec.push_back(Triangle(Color4(0.0f, 1.0f, 0.8f, 0.95f),
-		Vector3F(WINDOW_WIDTH / 2 - 20, WINDOW_HEIGHT / 2, -4.0f),
-		Vector3F(WINDOW_WIDTH / 2 + 10, WINDOW_HEIGHT / 2 - 20, -4.0f),
-		Vector3F(WINDOW_WIDTH / 2 + 35, WINDOW_HEIGHT / 2 + 30, -4.0f)));
-
-	////Mars
-	planetVec.push_back(Triangle(Color4(1.0f, 0.0f, 0.0f, 0.95f),
-		Vector3F(WINDOW_WIDTH / 2 - 10, WINDOW_HEIGHT / 2 - 10, -5.0f),
-		Vector3F(WINDOW_WIDTH / 2 + 5, WINDOW_HEIGHT / 2 + 15, -5.0f),
-		Vector3F(WINDOW_WIDTH / 2 + 15, WINDOW_HEIGHT / 2 + 10, -5.0f)));
-
-	//Jupiter
-	planetVec.push_back(Triangle(Color4(244 / 255.0f, 164 / 255.0f, 96 / 255.0f, 0.95f),
-		Vector3F(WINDOW_WIDTH / 2 - 35, WINDOW_HEIGHT / 2 - 35, -6.0f),
-		Vector3F(WINDOW_WIDTH / 2 + 35, WINDOW_HEIGHT / 2, -6.0f),
-		Vector3F(WINDOW_WIDTH / 2, WINDOW_HEIGHT / 2 + 33, -6.0f)));
-
-	//Saturn
-	planetVec.push_back(Triangle(Color4(218 / 255.0f, 165 / 255.0f, 32 / 255.0f, 0.95f),
-		Vector3F(WINDOW_WIDTH / 2 - 30, WINDOW_HEIGHT / 2 + 5, -7.0f),
-		Vector3F(WINDOW_WIDTH / 2 + 25, WINDOW_HEIGHT / 2 - 30, -7.0f),
-		Vector3F(WINDOW_WIDTH / 2 + 10, WINDOW_HEIGHT / 2 + 28, -7.0f)));
-
-	////Uranus
-	//planetVec.push_back(Triangle(Color4(0.2f, 0.7f, 1.0f, 0.95f),
-	//	Vector3F(WINDOW_WIDTH / 2 - 20, WINDOW_HEIGHT / 2, -8.0f),
-	//	Vector3F(WINDOW_WIDTH / 2 + 10, WINDOW_HEIGHT / 2 - 20, -8.0f),
-	//	Vector3F(WINDOW_WIDTH / 2 + 35, WINDOW_HEIGHT / 2 + 30, -8.0f)));
-
-	//////Neptune
-	//planetVec.push_back(Triangle(Color4(0.1f, 0.5f, 0.8f, 0.95f),
-	//	Vector3F(WINDOW_WIDTH / 2 - 15, WINDOW_HEIGHT / 2 - 10, -9.0f),
-	//	Vector3F(WINDOW_WIDTH / 2 + 5, WINDOW_HEIGHT / 2 - 5, -9.0f),
-	//	Vector3F(WINDOW_WIDTH / 2 + 25, WINDOW_HEIGHT / 2 + 40, -9.0f)));
-
-	////Pluto
-	//planetVec.push_back(Triangle(Color4(0.7f, 0.7f, 1.0f, 0.95f),
-	//	Vector3F(WINDOW_WIDTH / 2 - 10, WINDOW_HEIGHT / 2 - 5, -10.0f),
-	//	Vector3F(WINDOW_WIDTH / 2 + 5, WINDOW_HEIGHT / 2 + 5, -10.0f),
-	//	Vector3F(WINDOW_WIDTH / 2 + 15, WINDOW_HEIGHT / 2 + 10, -10.0f)));
-
-
-	//Create alien planet
-	alienPlanet = Triangle(Color4(120 / 255.0f, 81 / 255.0f, 169 / 255.0f, 1.0f),
-		Vector3F(50, 0, -30.0f),
-		Vector3F(100, 150, -30.0f),
-		Vector3F(75, WINDOW_HEIGHT - 1, 0.0f));
-}
-
-//Still needs a prototype above
-void UpdatePlanets()
-{
-	const float PI = 3.14159f;
-	Vector3F newRelativePosition;
-	int radius = 0;
-	float speedFactor = 0;
-	for (unsigned int planet = 0; planet < planetVec.size(); planet++)
-	{
-		radius = 40 * (planet + 1);
-		speedFactor = (planetVec.size() - planet) * (PI / 2);
-		newRelativePosition = Vector3F(radius * cos(theta * speedFactor),
-			radius * sin(theta * speedFactor),
-			0.0f);
-		
-		//Remove pixel colors from depthBuffer array corresponding to previous position
-		depthBuffer.MaskBuffers(planetVec[planet]);
-
-		//Update the planetVec[planet] triangle's relativePosition
-		//planetVec[planet].UpdatePosition(newRelativePosition);
-
-		//Update the pixel colors in depthBuffer array corresponding to new position
-		//depthBuffer.UpdateBuffers(planetVec[planet]);
-
-		UpdateTriangleAndDepthBuffer(planetVec[planet], newRelativePosition);
-	}
-	
-	//This function is way too slow. Find ways to not have to loop through every single pixel,
-	//and only redraw the pixels that need to be redrawn. (Most of the screen is the background
-	//color and these pixels shouldn't need to be redrawn every frame).
-	//depthBuffer.Draw();
-
-	theta += 0.01f;
-}
-
-
-//Asteroid global variables
-const int MAX_ASTEROIDS = 10;
-const int NEEDED_ELAPSED_TIME = CLOCKS_PER_SEC / 2; //Half a second
-const int ASTEROID_X_SPEEED = 40;
-int timeOfLastCreatedAsteroid = -1;
-
-
-void CreateAsteroid()
-{
-	float newOpacity = 0.5f + ((rand() % 6) / 5.0f);
-	Vector3F newVertex = Vector3F(0.0f, (float)(15 + (rand() % (WINDOW_HEIGHT - 36))), -10.0f);
-	asteroidVec.push_back(Triangle(GetRandomColor(),
-		newVertex,
-		Vector3F((float)(rand() % 30), newVertex.GetY() + 5.0f + (float)(rand() % 16), -10.0f),
-		Vector3F(20.0f + (float)(rand() % 70), newVertex.GetY() - 15.0f + (float)(rand() % 16), -10.0f)));
-	/*
-	asteroidVec.push_back(Triangle(Color4((165 + (rand() % 16)) / 255.0f, (42 + (rand() % 16)) / 255.0f, (42 - (rand() % 16)) / 255.0f, newOpacity),
-		newVertex,
-		Vector3F((float)(rand() % 30), newVertex.GetY() + 5.0f + (float)(rand() % 16), -10.0f),
-		Vector3F(20.0f + (float)(rand() % 70), newVertex.GetY() - 15.0f + (float)(rand() % 16), -10.0f)));
-		*/
-}
-
-void UpdateAsteroids()
-{
-	Vector3F newRelativePosition;
-	unsigned int vecSize = asteroidVec.size();
-	for (unsigned int asteroid = 0; asteroid < vecSize; asteroid++)
-	{
-		newRelativePosition = Vector3F(asteroidVec[asteroid].relativePosition.GetX() + ASTEROID_X_SPEEED,
-										0.0f,
-										0.0f);
-		depthBuffer.MaskBuffers(asteroidVec[asteroid]);
-
-		//If an asteroid has gone off-screen, erase it.
-		if (asteroidVec[asteroid].vertexArr[0].GetX() + asteroidVec[asteroid].relativePosition.GetX() >= WINDOW_WIDTH ||
-			asteroidVec[asteroid].vertexArr[1].GetX() + asteroidVec[asteroid].relativePosition.GetX() >= WINDOW_WIDTH ||
-			asteroidVec[asteroid].vertexArr[2].GetX() + asteroidVec[asteroid].relativePosition.GetX() >= WINDOW_WIDTH)
-		{
-			asteroidVec.erase(asteroidVec.begin() + asteroid);
-			return;
-		}
-
-		UpdateTriangleAndDepthBuffer(asteroidVec[asteroid], newRelativePosition);
-	}
-
-	if (vecSize < MAX_ASTEROIDS && (int)clock() - timeOfLastCreatedAsteroid >= NEEDED_ELAPSED_TIME)
-	{
-		CreateAsteroid();
-		timeOfLastCreatedAsteroid = (int)clock();
-	}
-}
-
-void UpdateSolarSystem()
-{
-	UpdateTriangleAndDepthBuffer(sun, sun.relativePosition);
-
-	UpdatePlanets();
-	UpdateAsteroids();
-
-	UpdateTriangleAndDepthBuffer(alienPlanet, alienPlanet.relativePosition);
-}
\ No newline at end of file
+/*
+ * Programmer: Jason Carruthers
+ * Last modified: 2/9/16
+ *
+ * This program implements a z-buffer, though it is modified by my own design as a
+ * combination of the z-buffer and a-buffer algorithms found in the book, as I
+ * have given triangles (and potentially any polygon) the ability to have
+ * transparency.
+ * NOTE: This program assumes orthographic projection.
+ */
+#include <GL/glut.h>
+#include <math.h>
+#include <list>
+#include <vector>
+#include <ctime>
+#include <map>
+#include <cstring>
+#include <cstdlib>
+#include <cstdio>
+#include <chrono>
+#include <string>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <limits>
+#include <new>
+#include <deque>
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define COLOR4V_SSE2 //Color4V holds its channels in an SSE register
+#define AFFINE_TRANSFORM_SSE2 //AffineTransform::TransformVertices() transforms four vertices at a time
+#endif
+#ifdef __linux__
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+
+
+/*
+* Classes
+*/
+class Color3
+{
+public:
+	enum RGBParameters
+	{
+		Red,
+		Green,
+		Blue,
+		Num__RGBParameters,
+	};
+public:
+	//Constructors
+	Color3(float red = 1.0f, float green = 1.0f, float blue = 1.0f)
+	{
+		SetR(red);
+		SetG(green);
+		SetB(blue);
+	}
+
+	//Accessors
+	float GetR() const
+	{
+		return mRGB[(int)Red];
+	}
+	float GetG() const
+	{
+		return mRGB[(int)Green];
+	}
+	float GetB() const
+	{
+		return mRGB[(int)Blue];
+	}
+
+	//Mutators
+	void Set(const Color3 &color)
+	{
+		SetR(color.GetR());
+		SetG(color.GetG());
+		SetB(color.GetB());
+	}
+	void Set(float newRed, float newGreen, float newBlue)
+	{
+		SetR(newRed);
+		SetG(newGreen);
+		SetB(newBlue);
+	}
+	void SetR(float newRed)
+	{
+		newRed = (newRed < 0.0f) ? 0.0f : newRed;
+		newRed = (newRed > 1.0f) ? 1.0f : newRed;
+		mRGB[(int)Red] = newRed;
+	}
+	void SetG(float newGreen)
+	{
+		newGreen = (newGreen < 0.0f) ? 0.0f : newGreen;
+		newGreen = (newGreen > 1.0f) ? 1.0f : newGreen;
+		mRGB[(int)Green] = newGreen;
+	}
+	void SetB(float newBlue)
+	{
+		newBlue = (newBlue < 0.0f) ? 0.0f : newBlue;
+		newBlue = (newBlue > 1.0f) ? 1.0f : newBlue;
+		mRGB[(int)Blue] = newBlue;
+	}
+
+	//Overloaded operators
+	float &operator[](int index)
+	{
+		if (index < 0 || index >= (int)Num__RGBParameters)
+			return mRGB[(int)Red]; //If index out of bounds, return the red value by default.
+		return mRGB[index];
+	}
+	const float &operator[](int index) const
+	{
+		if (index < 0 || index >= (int)Num__RGBParameters)
+			return mRGB[(int)Red]; //If index is out of bounds, return the first element by default.
+		return mRGB[index];
+	}
+
+private:
+	float mRGB[Num__RGBParameters];
+};
+
+
+//Color4 is like Color3 but has an alpha value
+class Color4
+{
+public:
+	enum RGBAParameters
+	{
+		Red,
+		Green,
+		Blue,
+		Alpha,
+		Num__RGBAParameters,
+	};
+public:
+	//Constructors
+	Color4(float red = 1.0f, float green = 1.0f, float blue = 1.0f, float alpha = 1.0f)
+	{
+		SetR(red);
+		SetG(green);
+		SetB(blue);
+		SetA(alpha);
+	}
+
+	//Accessors
+	float GetR() const
+	{
+		return mRGBA[(int)Red];
+	}
+	float GetG() const
+	{
+		return mRGBA[(int)Green];
+	}
+	float GetB() const
+	{
+		return mRGBA[(int)Blue];
+	}
+	float GetA() const
+	{
+		return mRGBA[(int)Alpha];
+	}
+	Color3 GetColor3() const
+	{
+		return Color3(mRGBA[(int)Red], mRGBA[(int)Green], mRGBA[(int)Blue]);
+	}
+
+	//Mutators
+	void Set(const Color4 &color)
+	{
+		SetR(color.GetR());
+		SetG(color.GetG());
+		SetB(color.GetB());
+		SetA(color.GetA());
+	}
+	void Set(float newRed, float newGreen, float newBlue, float newAlpha)
+	{
+		SetR(newRed);
+		SetG(newGreen);
+		SetB(newBlue);
+		SetA(newAlpha);
+	}
+	void SetR(float newRed)
+	{
+		newRed = (newRed < 0.0f) ? 0.0f : newRed;
+		newRed = (newRed > 1.0f) ? 1.0f : newRed;
+		mRGBA[(int)Red] = newRed;
+	}
+	void SetG(float newGreen)
+	{
+		newGreen = (newGreen < 0.0f) ? 0.0f : newGreen;
+		newGreen = (newGreen > 1.0f) ? 1.0f : newGreen;
+		mRGBA[(int)Green] = newGreen;
+	}
+	void SetB(float newBlue)
+	{
+		newBlue = (newBlue < 0.0f) ? 0.0f : newBlue;
+		newBlue = (newBlue > 1.0f) ? 1.0f : newBlue;
+		mRGBA[(int)Blue] = newBlue;
+	}
+	void SetA(float newAlpha)
+	{
+		newAlpha = (newAlpha < 0.0f) ? 0.0f : newAlpha;
+		newAlpha = (newAlpha > 1.0f) ? 1.0f : newAlpha;
+		mRGBA[(int)Alpha] = newAlpha;
+	}
+
+	//Overloaded operators
+	float &operator[](int index)
+	{
+		if (index < 0 || index >= (int)Num__RGBAParameters)
+			return mRGBA[(int)Red]; //If index out of bounds, return the red value by default.
+		return mRGBA[index];
+	}
+	const float &operator[](int index) const
+	{
+		if (index < 0 || index >= (int)Num__RGBAParameters)
+			return mRGBA[(int)Red]; //If index is out of bounds, return the first element by default.
+		return mRGBA[index];
+	}
+
+private:
+	float mRGBA[Num__RGBAParameters];
+};
+
+
+/*
+ * A Color4 for the blend kernels, held in one 16-byte SIMD register so that all four channels
+ * are computed by each instruction. Unlike Color4, nothing is clamped as it's computed: the
+ * blend rules keep every channel within [0, 1] anyway, and colors are only clamped once, when
+ * they're written out (see PackedColor::Set()).
+ */
+class alignas(16) Color4V
+{
+public:
+	//Constructors
+	Color4V()
+	{
+	}
+	Color4V(float red, float green, float blue, float alpha)
+	{
+#ifdef COLOR4V_SSE2
+		mRGBA = _mm_setr_ps(red, green, blue, alpha);
+#else
+		mRGBA[(int)Color4::Red] = red;
+		mRGBA[(int)Color4::Green] = green;
+		mRGBA[(int)Color4::Blue] = blue;
+		mRGBA[(int)Color4::Alpha] = alpha;
+#endif
+	}
+
+	//Accessors
+	float GetR() const
+	{
+		return Get(Color4::Red);
+	}
+	float GetG() const
+	{
+		return Get(Color4::Green);
+	}
+	float GetB() const
+	{
+		return Get(Color4::Blue);
+	}
+	float GetA() const
+	{
+		return Get(Color4::Alpha);
+	}
+	float Get(Color4::RGBAParameters channel) const
+	{
+#ifdef COLOR4V_SSE2
+		float rgbaArr[Color4::Num__RGBAParameters];
+		_mm_storeu_ps(rgbaArr, mRGBA);
+		return rgbaArr[(int)channel];
+#else
+		return mRGBA[(int)channel];
+#endif
+	}
+	Color3 GetColor3() const
+	{
+		return Color3(GetR(), GetG(), GetB());
+	}
+
+	//The alpha channel copied into all four channels
+	Color4V GetAlphaSplat() const
+	{
+#ifdef COLOR4V_SSE2
+		return Color4V(_mm_shuffle_ps(mRGBA, mRGBA, _MM_SHUFFLE(3, 3, 3, 3)));
+#else
+		return Color4V(GetA(), GetA(), GetA(), GetA());
+#endif
+	}
+
+	//This color, with its alpha channel replaced by 1 (fully opaque)
+	Color4V GetOpaque() const
+	{
+#ifdef COLOR4V_SSE2
+		const __m128 rgbMask = _mm_castsi128_ps(_mm_setr_epi32(-1, -1, -1, 0));
+		return Color4V(_mm_or_ps(_mm_and_ps(mRGBA, rgbMask), _mm_setr_ps(0.0f, 0.0f, 0.0f, 1.0f)));
+#else
+		return Color4V(GetR(), GetG(), GetB(), 1.0f);
+#endif
+	}
+
+	//Overloaded operators
+	Color4V operator+(const Color4V &other) const
+	{
+#ifdef COLOR4V_SSE2
+		return Color4V(_mm_add_ps(mRGBA, other.mRGBA));
+#else
+		return Color4V(GetR() + other.GetR(), GetG() + other.GetG(), GetB() + other.GetB(), GetA() + other.GetA());
+#endif
+	}
+	Color4V operator*(const Color4V &other) const
+	{
+#ifdef COLOR4V_SSE2
+		return Color4V(_mm_mul_ps(mRGBA, other.mRGBA));
+#else
+		return Color4V(GetR() * other.GetR(), GetG() * other.GetG(), GetB() * other.GetB(), GetA() * other.GetA());
+#endif
+	}
+	Color4V operator*(float scale) const
+	{
+#ifdef COLOR4V_SSE2
+		return Color4V(_mm_mul_ps(mRGBA, _mm_set1_ps(scale)));
+#else
+		return Color4V(GetR() * scale, GetG() * scale, GetB() * scale, GetA() * scale);
+#endif
+	}
+
+private:
+	friend class PackedColor; //Packs and unpacks whole registers
+#ifdef COLOR4V_SSE2
+	explicit Color4V(__m128 newRGBA)
+	{
+		mRGBA = newRGBA;
+	}
+
+	__m128 mRGBA;
+#else
+	float mRGBA[Color4::Num__RGBAParameters];
+#endif
+};
+
+
+/*
+ * Color4 packed into one byte per channel, so that fragments can be stored compactly.
+ * Converting a Color4 rounds each channel to the nearest 1/255.
+ */
+class PackedColor
+{
+public:
+	//Constructors
+	PackedColor(const Color4 &color = Color4(0.0f, 0.0f, 0.0f, 1.0f))
+	{
+		Set(color);
+	}
+
+	//Accessors
+	float GetR() const
+	{
+		return mRGBA[(int)Color4::Red] * (1.0f / 255.0f);
+	}
+	float GetG() const
+	{
+		return mRGBA[(int)Color4::Green] * (1.0f / 255.0f);
+	}
+	float GetB() const
+	{
+		return mRGBA[(int)Color4::Blue] * (1.0f / 255.0f);
+	}
+	float GetA() const
+	{
+		return mRGBA[(int)Color4::Alpha] * (1.0f / 255.0f);
+	}
+	Color3 GetColor3() const
+	{
+		return Color3(GetR(), GetG(), GetB());
+	}
+	Color4 GetColor4() const
+	{
+		return Color4(GetR(), GetG(), GetB(), GetA());
+	}
+	Color4V GetColor4V() const
+	{
+#ifdef COLOR4V_SSE2
+		int packedRGBA;
+		memcpy(&packedRGBA, mRGBA, sizeof(packedRGBA));
+		__m128i zero = _mm_setzero_si128();
+		__m128i channels = _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(packedRGBA), zero), zero);
+		return Color4V(_mm_mul_ps(_mm_cvtepi32_ps(channels), _mm_set1_ps(1.0f / 255.0f)));
+#else
+		return Color4V(GetR(), GetG(), GetB(), GetA());
+#endif
+	}
+	bool IsOpaque() const
+	{
+		return mRGBA[(int)Color4::Alpha] == 255;
+	}
+	bool operator==(const PackedColor &other) const
+	{
+		return memcmp(mRGBA, other.mRGBA, sizeof(mRGBA)) == 0;
+	}
+	bool operator!=(const PackedColor &other) const
+	{
+		return !(*this == other);
+	}
+
+	//Mutators
+	void Set(const Color4 &color)
+	{
+		Set(color.GetR(), color.GetG(), color.GetB(), color.GetA());
+	}
+	/*
+	 * The one place blended colors are clamped. Returns the color as it was stored, the same as
+	 * GetColor4V() would, without having to unpack it again.
+	 */
+	Color4V Set(const Color4V &color)
+	{
+#ifdef COLOR4V_SSE2
+		__m128 clamped = _mm_min_ps(_mm_max_ps(color.mRGBA, _mm_setzero_ps()), _mm_set1_ps(1.0f));
+		__m128i channels = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(clamped, _mm_set1_ps(255.0f)), _mm_set1_ps(0.5f)));
+		__m128i packedChannels = _mm_packs_epi32(channels, channels);
+		int packedRGBA = _mm_cvtsi128_si32(_mm_packus_epi16(packedChannels, packedChannels));
+		memcpy(mRGBA, &packedRGBA, sizeof(packedRGBA));
+		return Color4V(_mm_mul_ps(_mm_cvtepi32_ps(channels), _mm_set1_ps(1.0f / 255.0f)));
+#else
+		Set(color.GetR(), color.GetG(), color.GetB(), color.GetA());
+		return GetColor4V();
+#endif
+	}
+	void Set(float newRed, float newGreen, float newBlue, float newAlpha)
+	{
+		mRGBA[(int)Color4::Red] = PackChannel(newRed);
+		mRGBA[(int)Color4::Green] = PackChannel(newGreen);
+		mRGBA[(int)Color4::Blue] = PackChannel(newBlue);
+		mRGBA[(int)Color4::Alpha] = PackChannel(newAlpha);
+	}
+
+private:
+	static unsigned char PackChannel(float channel)
+	{
+		channel = (channel < 0.0f) ? 0.0f : channel;
+		channel = (channel > 1.0f) ? 1.0f : channel;
+		return (unsigned char)(channel * 255.0f + 0.5f);
+	}
+
+private:
+	unsigned char mRGBA[Color4::Num__RGBAParameters];
+};
+
+class Vector2I
+{
+public:
+	enum VectorElements
+	{
+		X,
+		Y,
+		Num__Elements,
+	};
+public:
+	//Constructors
+	Vector2I(int x = 0, int y = 0)
+	{
+		mArr[X] = x;
+		mArr[Y] = y;
+	}
+
+	//Accessors
+	int GetX() const
+	{
+		return mArr[X];
+	}
+	int GetY() const
+	{
+		return mArr[Y];
+	}
+
+	//Mutators
+	void SetX(int newX)
+	{
+		mArr[X] = newX;
+	}
+	void SetY(int newY)
+	{
+		mArr[Y] = newY;
+	}
+
+	//Overloaded operators
+	int &operator[](int index)
+	{
+		if (index < 0 || index >= (int)Num__Elements)
+			return mArr[X]; //If index is out of bounds, return the first element by default.
+		return mArr[index];
+	}
+	const int &operator[](int index) const
+	{
+		if (index < 0 || index >= (int)Num__Elements)
+			return mArr[X]; //If index is out of bounds, return the first element by default.
+		return mArr[index];
+	}
+	friend bool operator== (const Vector2I &pair1, const Vector2I &pair2)
+	{
+		return (pair1.GetX() == pair2.GetX() && pair1.GetY() == pair2.GetY());
+	}
+
+private:
+	int mArr[Num__Elements];
+};
+
+
+class Vector3I
+{
+public:
+	enum VectorElements
+	{
+		X,
+		Y,
+		Z,
+		Num__Elements,
+	};
+public:
+	//Constructors
+	Vector3I(int x = 0, int y = 0, int z = 0)
+	{
+		mArr[X] = x;
+		mArr[Y] = y;
+		mArr[Z] = z;
+	}
+
+	//Accessors
+	int GetX() const
+	{
+		return mArr[X];
+	}
+	int GetY() const
+	{
+		return mArr[Y];
+	}
+	int GetZ() const
+	{
+		return mArr[Z];
+	}
+
+	//Mutators
+	void SetX(int newX)
+	{
+		mArr[X] = newX;
+	}
+	void SetY(int newY)
+	{
+		mArr[Y] = newY;
+	}
+	void SetZ(int newZ)
+	{
+		mArr[Z] = newZ;
+	}
+
+	//Overloaded operators
+	int &operator[](int index)
+	{
+		if (index < 0 || index >= (int)Num__Elements)
+			return mArr[X]; //If index is out of bounds, return the first element by default.
+		return mArr[index];
+	}
+	const int &operator[](int index) const
+	{
+		if (index < 0 || index >= (int)Num__Elements)
+			return mArr[X]; //If index is out of bounds, return the first element by default.
+		return mArr[index];
+	}
+	friend bool operator== (const Vector3I &coord1, const Vector3I &coord2)
+	{
+		return (coord1.GetX() == coord2.GetX() && coord1.GetY() == coord2.GetY() && coord1.GetZ() == coord2.GetZ());
+	}
+
+private:
+	int mArr[Num__Elements];
+};
+
+
+class Vector2F
+{
+public:
+	enum VectorElements
+	{
+		X,
+		Y,
+		Num__Elements,
+	};
+public:
+	//Constructors
+	Vector2F(float x = 0, float y = 0)
+	{
+		mArr[X] = x;
+		mArr[Y] = y;
+	}
+
+	//Accessors
+	float GetX() const
+	{
+		return mArr[X];
+	}
+	float GetY() const
+	{
+		return mArr[Y];
+	}
+
+	//Mutators
+	void SetX(float newX)
+	{
+		mArr[X] = newX;
+	}
+	void SetY(float newY)
+	{
+		mArr[Y] = newY;
+	}
+
+	//Overloaded operators
+	float &operator[](int index)
+	{
+		if (index < 0 || index >= (int)Num__Elements)
+			return mArr[X]; //If index is out of bounds, return the first element by default.
+		return mArr[index];
+	}
+	const float &operator[](int index) const
+	{
+		if (index < 0 || index >= (int)Num__Elements)
+			return mArr[X]; //If index is out of bounds, return the first element by default.
+		return mArr[index];
+	}
+	friend bool operator== (const Vector2F &pair1, const Vector2F &pair2)
+	{
+		return (pair1.GetX() == pair2.GetX() && pair1.GetY() == pair2.GetY());
+	}
+
+private:
+	float mArr[Num__Elements];
+};
+
+
+class Vector3F
+{
+public:
+	enum VectorElements
+	{
+		X,
+		Y,
+		Z,
+		Num__Elements,
+	};
+public:
+	//Constructors
+	Vector3F(float x = 0, float y = 0, float z = 0)
+	{
+		mArr[X] = x;
+		mArr[Y] = y;
+		mArr[Z] = z;
+	}
+
+	//Accessors
+	float GetX() const
+	{
+		return mArr[X];
+	}
+	float GetY() const
+	{
+		return mArr[Y];
+	}
+	float GetZ() const
+	{
+		return mArr[Z];
+	}
+
+	//Mutators
+	void SetX(float newX)
+	{
+		mArr[X] = newX;
+	}
+	void SetY(float newY)
+	{
+		mArr[Y] = newY;
+	}
+	void SetZ(float newZ)
+	{
+		mArr[Z] = newZ;
+	}
+
+	//Overloaded operators
+	float &operator[](int index)
+	{
+		if (index < 0 || index >= (int)Num__Elements)
+			return mArr[X]; //If index is out of bounds, return the first element by default.
+		return mArr[index];
+	}
+	const float &operator[](int index) const
+	{
+		if (index < 0 || index >= (int)Num__Elements)
+			return mArr[X]; //If index is out of bounds, return the first element by default.
+		return mArr[index];
+	}
+	friend bool operator== (const Vector3F &coord1, const Vector3F &coord2)
+	{
+		return (coord1.GetX() == coord2.GetX() && coord1.GetY() == coord2.GetY() && coord1.GetZ() == coord2.GetZ());
+	}
+
+private:
+	float mArr[Num__Elements];
+};
+
+
+/*
+ * A 3D affine transform: a 3x3 linear part (rotation, scale, shear) followed by a translation,
+ * applied as x' = M * x + t. Transforms compose like matrices, so (a * b) applies b first.
+ * Vertices are transformed in batches held as separate x, y and z arrays, four at a time with
+ * SSE2.
+ */
+class AffineTransform
+{
+public:
+	//Constructors
+	AffineTransform()
+	{
+		for (int row = 0; row < 3; row++)
+			for (int column = 0; column < 4; column++)
+				mArr[row][column] = (row == column) ? 1.0f : 0.0f;
+	}
+
+	//Factories
+	static AffineTransform Translation(const Vector3F &offset)
+	{
+		AffineTransform transform;
+		for (int row = 0; row < 3; row++)
+			transform.mArr[row][3] = offset[row];
+		return transform;
+	}
+	static AffineTransform Scale(float scaleX, float scaleY, float scaleZ)
+	{
+		AffineTransform transform;
+		transform.mArr[0][0] = scaleX;
+		transform.mArr[1][1] = scaleY;
+		transform.mArr[2][2] = scaleZ;
+		return transform;
+	}
+	//Rotations by angle radians about the x-, y- and z-axes (the z-axis points out of the screen)
+	static AffineTransform RotationX(float angle)
+	{
+		return Rotation(1, 2, angle);
+	}
+	static AffineTransform RotationY(float angle)
+	{
+		return Rotation(2, 0, angle);
+	}
+	static AffineTransform RotationZ(float angle)
+	{
+		return Rotation(0, 1, angle);
+	}
+
+	//Accessors
+	float Get(int row, int column) const
+	{
+		return mArr[row][column];
+	}
+	Vector3F Apply(const Vector3F &vertex) const
+	{
+		return Vector3F(mArr[0][0] * vertex.GetX() + mArr[0][1] * vertex.GetY() + mArr[0][2] * vertex.GetZ() + mArr[0][3],
+			mArr[1][0] * vertex.GetX() + mArr[1][1] * vertex.GetY() + mArr[1][2] * vertex.GetZ() + mArr[1][3],
+			mArr[2][0] * vertex.GetX() + mArr[2][1] * vertex.GetY() + mArr[2][2] * vertex.GetZ() + mArr[2][3]);
+	}
+
+	/*
+	 * Transforms count vertices from xArr, yArr and zArr into outXArr, outYArr and outZArr, which
+	 * mustn't overlap them. Four vertices are transformed per SSE2 instruction, and the rest one
+	 * at a time.
+	 */
+	void TransformVertices(const float *xArr, const float *yArr, const float *zArr, unsigned int count,
+		float *outXArr, float *outYArr, float *outZArr) const
+	{
+		unsigned int vertex = 0;
+#ifdef AFFINE_TRANSFORM_SSE2
+		//Each row is written out, rather than looped over, so that it's all kept in registers.
+		const __m128 m00 = _mm_set1_ps(mArr[0][0]), m01 = _mm_set1_ps(mArr[0][1]), m02 = _mm_set1_ps(mArr[0][2]), m03 = _mm_set1_ps(mArr[0][3]);
+		const __m128 m10 = _mm_set1_ps(mArr[1][0]), m11 = _mm_set1_ps(mArr[1][1]), m12 = _mm_set1_ps(mArr[1][2]), m13 = _mm_set1_ps(mArr[1][3]);
+		const __m128 m20 = _mm_set1_ps(mArr[2][0]), m21 = _mm_set1_ps(mArr[2][1]), m22 = _mm_set1_ps(mArr[2][2]), m23 = _mm_set1_ps(mArr[2][3]);
+		for (; vertex + 4 <= count; vertex += 4)
+		{
+			__m128 x = _mm_loadu_ps(xArr + vertex), y = _mm_loadu_ps(yArr + vertex), z = _mm_loadu_ps(zArr + vertex);
+			_mm_storeu_ps(outXArr + vertex, _mm_add_ps(_mm_add_ps(_mm_mul_ps(m00, x), _mm_mul_ps(m01, y)), _mm_add_ps(_mm_mul_ps(m02, z), m03)));
+			_mm_storeu_ps(outYArr + vertex, _mm_add_ps(_mm_add_ps(_mm_mul_ps(m10, x), _mm_mul_ps(m11, y)), _mm_add_ps(_mm_mul_ps(m12, z), m13)));
+			_mm_storeu_ps(outZArr + vertex, _mm_add_ps(_mm_add_ps(_mm_mul_ps(m20, x), _mm_mul_ps(m21, y)), _mm_add_ps(_mm_mul_ps(m22, z), m23)));
+		}
+#endif
+		TransformVerticesScalar(xArr + vertex, yArr + vertex, zArr + vertex, count - vertex, outXArr + vertex, outYArr + vertex, outZArr + vertex);
+	}
+	//TransformVertices() one vertex at a time
+	void TransformVerticesScalar(const float *xArr, const float *yArr, const float *zArr, unsigned int count,
+		float *outXArr, float *outYArr, float *outZArr) const
+	{
+		for (unsigned int vertex = 0; vertex < count; vertex++)
+		{
+			//Summed in the same order as the SSE2 path, so that both give identical results
+			outXArr[vertex] = (mArr[0][0] * xArr[vertex] + mArr[0][1] * yArr[vertex]) + (mArr[0][2] * zArr[vertex] + mArr[0][3]);
+			outYArr[vertex] = (mArr[1][0] * xArr[vertex] + mArr[1][1] * yArr[vertex]) + (mArr[1][2] * zArr[vertex] + mArr[1][3]);
+			outZArr[vertex] = (mArr[2][0] * xArr[vertex] + mArr[2][1] * yArr[vertex]) + (mArr[2][2] * zArr[vertex] + mArr[2][3]);
+		}
+	}
+
+	//Overloaded operators
+	friend AffineTransform operator* (const AffineTransform &a, const AffineTransform &b)
+	{
+		AffineTransform product;
+		for (int row = 0; row < 3; row++)
+		{
+			for (int column = 0; column < 4; column++)
+			{
+				product.mArr[row][column] = a.mArr[row][0] * b.mArr[0][column] + a.mArr[row][1] * b.mArr[1][column] +
+					a.mArr[row][2] * b.mArr[2][column] + ((column == 3) ? a.mArr[row][3] : 0.0f);
+			}
+		}
+		return product;
+	}
+	friend bool operator== (const AffineTransform &a, const AffineTransform &b)
+	{
+		for (int row = 0; row < 3; row++)
+			for (int column = 0; column < 4; column++)
+				if (a.mArr[row][column] != b.mArr[row][column])
+					return false;
+		return true;
+	}
+
+private:
+	//A rotation in the plane of axes first and second, from first towards second
+	static AffineTransform Rotation(int first, int second, float angle)
+	{
+		AffineTransform transform;
+		transform.mArr[first][first] = cos(angle);
+		transform.mArr[first][second] = -sin(angle);
+		transform.mArr[second][first] = sin(angle);
+		transform.mArr[second][second] = cos(angle);
+		return transform;
+	}
+
+private:
+	float mArr[3][4]; //Rows of the linear part, each followed by its translation
+};
+
+
+/*
+ * A xoshiro128** pseudo-random number generator. Unlike rand(), each RandomStream has its
+ * own state, so any number of threads can draw from their own streams without contending
+ * for (or racing on) shared state, and a given seed always reproduces the same sequence on
+ * every platform. Streams seeded with the same seed but different stream indices are
+ * statistically independent of each other.
+ */
+class RandomStream
+{
+public:
+	//Constructors
+	RandomStream(unsigned long long seed = 0, unsigned int streamIndex = 0)
+	{
+		Seed(seed, streamIndex);
+	}
+
+	//Mutators
+	void Seed(unsigned long long seed, unsigned int streamIndex = 0)
+	{
+		//Expand (seed, streamIndex) into the 128-bit state with SplitMix64, which never yields an all-zero state.
+		unsigned long long splitMixState = seed ^ ((unsigned long long)streamIndex * 0xD1342543DE82EF95ULL);
+		for (int i = 0; i < 4; i += 2)
+		{
+			splitMixState += 0x9E3779B97F4A7C15ULL;
+			unsigned long long z = splitMixState;
+			z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+			z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+			z = z ^ (z >> 31);
+			mState[i] = (unsigned int)z;
+			mState[i + 1] = (unsigned int)(z >> 32);
+		}
+	}
+
+	unsigned int Next()
+	{
+		unsigned int result = RotateLeft(mState[1] * 5, 7) * 9;
+		unsigned int t = mState[1] << 9;
+		mState[2] ^= mState[0];
+		mState[3] ^= mState[1];
+		mState[1] ^= mState[2];
+		mState[0] ^= mState[3];
+		mState[2] ^= t;
+		mState[3] = RotateLeft(mState[3], 11);
+		return result;
+	}
+
+	//A random integer in [0, bound), a drop-in replacement for rand() % bound.
+	int NextInt(int bound)
+	{
+		return (int)(((unsigned long long)Next() * (unsigned int)bound) >> 32);
+	}
+
+private:
+	static unsigned int RotateLeft(unsigned int x, int k)
+	{
+		return (x << k) | (x >> (32 - k));
+	}
+
+private:
+	unsigned int mState[4];
+};
+
+
+/*
+* Global variables that class Triangle relies on
+*/
+const unsigned int WINDOW_WIDTH = 800;
+const unsigned int WINDOW_HEIGHT = 600;
+const int Z_NEAR = 0;
+const int Z_FAR = -1000;
+const unsigned int SLEEP_DURATION = 1;
+const unsigned int BACKGROUND_PRIMITIVE_ID = 0;
+const int COVERAGE_GRID_SIZE = 4; //Each pixel is split into COVERAGE_GRID_SIZE*COVERAGE_GRID_SIZE subpixels when anti-aliasing.
+const int COVERAGE_SUBPIXELS = COVERAGE_GRID_SIZE * COVERAGE_GRID_SIZE;
+const unsigned short FULL_COVERAGE = 0xFFFF; //One bit per subpixel
+const unsigned int GRID_CELL_SIZE = 32; //In pixels, see class SpatialGrid
+const unsigned int CACHE_LINE_SIZE = 64; //In bytes
+const size_t HUGE_PAGE_SIZE = 2 * 1024 * 1024; //In bytes, see AllocateLargeBuffer()
+const int SPAN_CHUNK_SIZE = 256; //Pixels whose depths and coverages are computed at a time for class DepthBuffer's span calls
+const float SPLAT_MAX_AREA = 6.0f; //In pixels, the largest triangle that's drawn as a Splat
+const float SPLAT_MAX_EXTENT = 4.0f; //In pixels, the widest and tallest triangle that's drawn as a Splat
+const unsigned int MAX_RENDER_ROW_STEP = 4; //The coarsest vertical resolution, see class ResolutionController
+thread_local unsigned int nextPrimitiveId = BACKGROUND_PRIMITIVE_ID + 1; //Each thread numbers the primitives it creates, see RunScenes()
+bool antiAliasing = false;
+bool incrementalUpdates = true; //If false, primitives are always fully masked and re-rasterized (the reference path)
+bool sortLastRasterization = false; //If true, batches of moved primitives are rasterized in parallel, see class FragmentStore
+
+
+//Class prototypes
+class Triangle;
+class TriangleShape;
+class TriangleShapeCache;
+class Polygon;
+class MeshFace;
+class TriangleMesh;
+class Splat;
+class FragmentStore;
+class DepthBuffer;
+class RenderContext;
+
+//Function prototypes that class Triangle relies on
+void SetPixel(float *pixelBuffer, int x, int y, const Color3 &color);
+bool ClipScanLineToViewport(const RenderContext &context, int worldY, int &startX, int &endX);
+void UpdateTriangleAndDepthBuffer(RenderContext &context, Triangle &triangle, const Vector3F &newRelativePosition);
+void UpdatePolygonAndDepthBuffer(RenderContext &context, Polygon &polygon, const Vector3F &newRelativePosition);
+void TranslateTriangleInDepthBuffer(RenderContext &context, Triangle &triangle, const Vector3F &newRelativePosition);
+void TranslatePolygonInDepthBuffer(RenderContext &context, Polygon &polygon, const Vector3F &newRelativePosition);
+void UpdateMeshAndDepthBuffer(RenderContext &context, TriangleMesh &mesh, const Vector3F &newRelativePosition);
+unsigned short GetCoverageMask(const Vector3F *vertexArr, unsigned int vertexCount, const Vector3F &position, int worldX, int worldY);
+void SeedThreadRandomStream(unsigned int streamIndex);
+
+//Function prototypes that class DepthBuffer relies on
+template <class Element>
+void AppendCheckpointArray(std::vector<char> &data, const Element *arr, size_t count);
+template <class Element>
+bool ReadCheckpointArray(const char *&data, size_t &bytes, const Element *&arr, size_t count);
+void ForEachRowBand(const std::function<void(int firstRow, int lastRow)> &job, unsigned int rowCount = WINDOW_HEIGHT);
+void *AllocateLargeBuffer(size_t bytes);
+void FreeLargeBuffer(void *buffer, size_t bytes);
+void ReportLargeBuffer(const char *name, const void *buffer, size_t bytes, unsigned int rowCount);
+void CopyPixelRow(float *pixelBuffer, int fromY, int toY);
+
+
+/*
+ * A span of pixels [startX, endX) on scan line y.
+ */
+class ScanSpan
+{
+public:
+	ScanSpan(int newY = 0, int newStartX = 0, int newEndX = 0)
+	{
+		y = newY;
+		startX = newStartX;
+		endX = newEndX;
+	}
+public:
+	int y;
+	int startX;
+	int endX;
+};
+
+
+/*
+ * What a triangle's rasterization depends on besides its color, depth and position: its
+ * scan-converted x-pairs (see Triangle::ScanConvert()), its plane's normal (from which its depth
+ * gradients follow) and its untranslated bounds. Every triangle of the same shape shares one,
+ * from triangleShapeCache, so that identical bodies are scan converted once and only take the
+ * memory of one x-pair list between them.
+ *
+ * Shapes are keyed by the sorted vertices' x and y, and the depths of the last two relative to
+ * the first, which is all that everything here is computed from. So triangles that only differ
+ * in depth (or relativePosition) share their shape.
+ */
+class TriangleShape
+{
+public:
+	static const int KEY_LENGTH = 8;
+
+	//Sets keyArr to the key of the vertices sortedArr, sorted by Triangle::SortVertices().
+	static void GetKey(const Vector3F sortedArr[3], float keyArr[KEY_LENGTH])
+	{
+		for (int i = 0; i < 3; i++)
+		{
+			keyArr[i * 2] = sortedArr[i].GetX();
+			keyArr[i * 2 + 1] = sortedArr[i].GetY();
+		}
+		keyArr[6] = sortedArr[1].GetZ() - sortedArr[0].GetZ();
+		keyArr[7] = sortedArr[2].GetZ() - sortedArr[0].GetZ();
+	}
+
+//Make this private later
+public:
+	float keyArr[KEY_LENGTH];
+	std::vector<Vector2I> relativeXPairVec; //See Triangle::ScanConvert()
+	Vector3F normalVec; //See Triangle::GetNormalVector()
+	Vector2F minCorner; //Untranslated bounds
+	Vector2F maxCorner;
+	unsigned int referenceCount; //Triangles using this shape. Once none are, it's recycled.
+	unsigned int index; //Into TriangleShapeCache::shapeDeque
+	unsigned int nextInBucket; //The next shape in this one's hash bucket, or TriangleShapeCache::NO_SHAPE
+};
+
+/*
+ * The shapes of every triangle, found by a hash of their key (see TriangleShape::GetKey()).
+ * Triangles hold counted references to them (see class TriangleShapeReference). A shape no
+ * triangle is using is recycled along with its x-pair list's capacity, so once the cache has
+ * grown to the number of shapes in use, spawning a triangle doesn't allocate for its shape,
+ * whether it's a new shape or not. Scenes that are rendered at once (see RunScenes()) spawn
+ * triangles on several threads, so Acquire(), Retain() and Release() lock the cache.
+ */
+class TriangleShapeCache
+{
+public:
+	static const unsigned int MIN_BUCKET_COUNT = 1024; //A power of two. It's doubled whenever there are more shapes than buckets.
+	static const unsigned int NO_SHAPE = 0xFFFFFFFF;
+
+	/*
+	 * Constructor
+	 */
+	TriangleShapeCache() :
+		bucketVec(MIN_BUCKET_COUNT, NO_SHAPE)
+	{
+	}
+
+	/*
+	 * Accessors
+	 */
+	//Shapes that are in use
+	unsigned int GetShapeCount() const
+	{
+		return (unsigned int)(shapeDeque.size() - freeShapeVec.size());
+	}
+	//Every shape's memory, recycled ones included
+	size_t GetBytes() const
+	{
+		size_t bytes = bucketVec.capacity() * sizeof(unsigned int) + freeShapeVec.capacity() * sizeof(unsigned int);
+		for (unsigned int shape = 0; shape < shapeDeque.size(); shape++)
+			bytes += sizeof(TriangleShape) + shapeDeque[shape].relativeXPairVec.capacity() * sizeof(Vector2I);
+		return bytes;
+	}
+
+	/*
+	 * Mutators
+	 */
+	//The shape of the vertices sortedArr, sorted by Triangle::SortVertices(), with a reference taken to it.
+	const TriangleShape *Acquire(const Vector3F sortedArr[3]);
+	void Retain(const TriangleShape *shape)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		shapeDeque[shape->index].referenceCount++;
+	}
+	void Release(const TriangleShape *shape)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		TriangleShape &releasedShape = shapeDeque[shape->index];
+		if (--releasedShape.referenceCount != 0)
+			return;
+
+		//Unlink it from its bucket, and keep it (and its x-pair list's capacity) for the next new shape.
+		unsigned int *link = &bucketVec[GetBucket(releasedShape.keyArr)];
+		while (*link != releasedShape.index)
+			link = &shapeDeque[*link].nextInBucket;
+		*link = releasedShape.nextInBucket;
+		freeShapeVec.push_back(releasedShape.index);
+	}
+
+private:
+	unsigned int GetBucket(const float keyArr[TriangleShape::KEY_LENGTH]) const
+	{
+		//FNV-1a over the key's bytes
+		const unsigned char *byteArr = (const unsigned char *)keyArr;
+		unsigned int hash = 2166136261u;
+		for (unsigned int byte = 0; byte < TriangleShape::KEY_LENGTH * sizeof(float); byte++)
+			hash = (hash ^ byteArr[byte]) * 16777619u;
+		return hash & (bucketVec.size() - 1);
+	}
+
+	//Spreads the shapes in use over bucketCount buckets.
+	void Rehash(unsigned int bucketCount)
+	{
+		std::vector<unsigned int> oldBucketVec(bucketCount, NO_SHAPE);
+		oldBucketVec.swap(bucketVec);
+		for (unsigned int bucket = 0; bucket < oldBucketVec.size(); bucket++)
+		{
+			unsigned int nextShape;
+			for (unsigned int shape = oldBucketVec[bucket]; shape != NO_SHAPE; shape = nextShape)
+			{
+				nextShape = shapeDeque[shape].nextInBucket;
+				unsigned int newBucket = GetBucket(shapeDeque[shape].keyArr);
+				shapeDeque[shape].nextInBucket = bucketVec[newBucket];
+				bucketVec[newBucket] = shape;
+			}
+		}
+	}
+
+private:
+	std::deque<TriangleShape> shapeDeque; //Never shrinks, so shapes never move
+	std::vector<unsigned int> bucketVec; //The first shape in each bucket
+	std::vector<unsigned int> freeShapeVec; //Recycled shapes
+	std::mutex mutex;
+};
+
+const unsigned int TriangleShapeCache::NO_SHAPE; //It's passed by reference to the vectors' constructors, so it needs a definition
+
+TriangleShapeCache triangleShapeCache; //Defined before every Triangle, so that it outlives them
+
+//A counted reference to a shape in triangleShapeCache, so that a Triangle's copies share its shape.
+class TriangleShapeReference
+{
+public:
+	/*
+	* Constructor
+	*/
+	TriangleShapeReference()
+	{
+		shape = NULL;
+	}
+	TriangleShapeReference(const TriangleShapeReference &otherReference)
+	{
+		shape = otherReference.shape;
+		if (shape != NULL)
+			triangleShapeCache.Retain(shape);
+	}
+	TriangleShapeReference(TriangleShapeReference &&otherReference)
+	{
+		shape = otherReference.shape;
+		otherReference.shape = NULL;
+	}
+	~TriangleShapeReference()
+	{
+		if (shape != NULL)
+			triangleShapeCache.Release(shape);
+	}
+	TriangleShapeReference &operator=(const TriangleShapeReference &otherReference)
+	{
+		if (otherReference.shape != NULL)
+			triangleShapeCache.Retain(otherReference.shape);
+		if (shape != NULL)
+			triangleShapeCache.Release(shape);
+		shape = otherReference.shape;
+		return *this;
+	}
+	TriangleShapeReference &operator=(TriangleShapeReference &&otherReference)
+	{
+		std::swap(shape, otherReference.shape);
+		return *this;
+	}
+
+	/*
+	* Accessors
+	*/
+	const TriangleShape *operator->() const
+	{
+		return shape;
+	}
+
+	/*
+	* Mutators
+	*/
+	//Refers to the shape of the vertices sortedArr instead.
+	void Set(const Vector3F sortedArr[3])
+	{
+		const TriangleShape *newShape = triangleShapeCache.Acquire(sortedArr);
+		if (shape != NULL)
+			triangleShapeCache.Release(shape);
+		shape = newShape;
+	}
+
+private:
+	const TriangleShape *shape;
+};
+
+
+
+/*
+* Some triangles aren't displaying correctly, such as the following case(s):
+*		- Drawing a triangle with one vertical edge
+* There may be other cases where the triangle doesn't display properly, but so far
+* the above case(s) are the only ones that have been tested.
+*/
+class Triangle
+{
+public:
+	/*
+	* Constructor
+	*/
+	Triangle()
+	{
+		primitiveId = BACKGROUND_PRIMITIVE_ID;
+		dirty = true;
+	}
+	Triangle(RenderContext &context, const Vector3F &p1, const Vector3F &p2, const Vector3F &p3) :
+		Triangle(context, Color4(), p1, p2, p3)
+	{
+	}
+	//An instance of the shape p1, p2, p3 (see class TriangleShape), rasterized into context at newRelativePosition.
+	Triangle(RenderContext &context, const Color4 &newColor, const Vector3F &p1, const Vector3F &p2, const Vector3F &p3, const Vector3F &newRelativePosition = Vector3F(0, 0, 0))
+	{
+		color = newColor; //Must be set before rasterizing below.
+		primitiveId = nextPrimitiveId++;
+		dirty = true;
+		vertexArr[0] = p1;
+		vertexArr[1] = p2;
+		vertexArr[2] = p3;
+		SortVertices(vertexArr);
+
+		SetShape(); //Must be set before rasterizing, since GetWorldZ() depends on its normal.
+		relativePosition = newRelativePosition;
+		//UpdatePixelInfo(relativePosition);
+		UpdateTriangleAndDepthBuffer(context, *this, relativePosition);
+	}
+
+	/*
+	 * Sets this triangle up as the constructor does, from vertices that are already sorted, but
+	 * leaves rasterizing it to the caller. For triangles whose fragments are already in the
+	 * depth buffer, such as ones restored from a checkpoint (see ReadCheckpoint()).
+	 */
+	void SetUp(const Color4 &newColor, const Vector3F sortedArr[3], const Vector3F &newRelativePosition, unsigned int newPrimitiveId)
+	{
+		color = newColor;
+		primitiveId = newPrimitiveId;
+		dirty = true;
+		for (int i = 0; i < 3; i++)
+			vertexArr[i] = sortedArr[i];
+		SetShape();
+		relativePosition = newRelativePosition;
+	}
+
+	/*
+	* Accessors
+	*/
+public:
+	Color3 GetColor3() const
+	{
+		return Color3(color.GetR(), color.GetG(), color.GetB());
+	}
+
+	/*
+	 * Instead of drawing a triangle directly to the screen (by calling SetPixel), now all Draw()
+	 * functions should update the zbuffer, and each cycle the zbuffer should draw.
+	 */
+	void Draw(const RenderContext &context, const Color3 &color) const;
+
+	int GetBaseX(int worldY) const
+	{
+		return GetBaseX(vertexArr, worldY);
+	}
+	//The x offset of scan line worldY's relativeXPair, for the vertices sorted by SortVertices().
+	static int GetBaseX(const Vector3F sortedArr[3], int worldY)
+	{
+		//If has horizontal edge...
+		if (sortedArr[0].GetY() == sortedArr[1].GetY() || sortedArr[1].GetY() == sortedArr[2].GetY())
+			return (int)sortedArr[0].GetX();
+
+		//Otherwise, no horizontal edge...
+		if (worldY < sortedArr[1].GetY())
+			return (int)sortedArr[0].GetX();
+		else //if y >= sortedArr[1].GetY()
+		{
+			if (sortedArr[0].GetX() > sortedArr[1].GetX())
+				return (int)sortedArr[1].GetX();
+
+			//Otherwise, this triangle is oriented with its nose in the 3rd quadrant, if
+			//seen as being pivoted by its y-middle vertex. Thus, the x offset is
+			//the same as the bottom left vertex x value of its horizontal-split
+			//upper-triangle.
+			float slope = (sortedArr[2].GetY() - sortedArr[0].GetY()) / (sortedArr[2].GetX() - sortedArr[0].GetX());
+			float pairPtX = ((sortedArr[1].GetY() - sortedArr[0].GetY()) / slope) + sortedArr[0].GetX();
+			return (int)pairPtX;
+		}
+	}
+
+	int GetWorldZ(int worldX, int worldY) const
+	{
+		return GetWorldZ(worldX, worldY, relativePosition);
+	}
+	//The depth at (worldX, worldY) if this triangle were translated to position instead.
+	int GetWorldZ(int worldX, int worldY, const Vector3F &position) const
+	{
+		const Vector3F &normalVec = shape->normalVec;
+		float localX = (float)(worldX - (int)position.GetX()) - vertexArr[0].GetX();
+		float localY = (float)(worldY - (int)position.GetY()) - vertexArr[0].GetY();
+		return (int)((-1 / normalVec[2])*(normalVec[0] * localX + normalVec[1] * localY) + vertexArr[0].GetZ() + position.GetZ());
+	}
+
+	//The world-space bounding box of this triangle at its current relativePosition
+	void GetBounds(Vector2F &minCorner, Vector2F &maxCorner) const
+	{
+		minCorner = Vector2F(shape->minCorner.GetX() + (int)relativePosition.GetX(), shape->minCorner.GetY() + (int)relativePosition.GetY());
+		maxCorner = Vector2F(shape->maxCorner.GetX() + (int)relativePosition.GetX(), shape->maxCorner.GetY() + (int)relativePosition.GetY());
+	}
+
+	//Which subpixels of pixel (worldX, worldY) this triangle covers. Always full unless anti-aliasing.
+	unsigned short GetCoverage(int worldX, int worldY) const
+	{
+		return GetCoverage(worldX, worldY, relativePosition);
+	}
+	unsigned short GetCoverage(int worldX, int worldY, const Vector3F &position) const
+	{
+		if (!antiAliasing)
+			return FULL_COVERAGE;
+		return GetCoverageMask(vertexArr, 3, position, worldX, worldY);
+	}
+
+	/*
+	* Mutators
+	*/
+public:
+	//Refers to the shape of vertexArr (see class TriangleShape). Call it after changing vertexArr directly.
+	void SetShape()
+	{
+		shape.Set(vertexArr);
+	}
+	/*
+	 * A vector normal to the triangle sortedArr, and thus the plane containing it. Used to get
+	 * the world-z coordinate given a local (x, y) point. It's relative to world coordinates.
+	 */
+	static Vector3F GetNormalVector(const Vector3F sortedArr[3])
+	{
+		Vector3F leftEdge(sortedArr[1].GetX() - sortedArr[0].GetX(),
+							sortedArr[1].GetY() - sortedArr[0].GetY(), 
+							sortedArr[1].GetZ() - sortedArr[0].GetZ());
+
+		Vector3F rightEdge(sortedArr[2].GetX() - sortedArr[0].GetX(),
+							sortedArr[2].GetY() - sortedArr[0].GetY(),
+							sortedArr[2].GetZ() - sortedArr[0].GetZ());
+
+		float normalVecX = leftEdge.GetY()*rightEdge.GetZ() - leftEdge.GetZ()*rightEdge.GetY();
+		float normalVecY = leftEdge.GetZ()*rightEdge.GetX() - leftEdge.GetX()*rightEdge.GetZ();
+		float normalVecZ = leftEdge.GetX()*rightEdge.GetY() - leftEdge.GetY()*rightEdge.GetX();
+		return Vector3F(normalVecX, normalVecY, normalVecZ);
+	}
+
+	//This function should always be called before this triangle's Draw() function is called.
+	//void UpdatePosition(const Vector3F &newRelativeXYPosition)
+	//{
+	//	//Turn all pixels representing previous position to black
+	//	//for (unsigned int pixel = 0; pixel < pixelInfoVec.size(); pixel++)
+	//	//	for (int colorIndex = 0; colorIndex < (int)Color3::Num__RGBParameters; colorIndex++)
+	//	//		pixelBuffer[pixelInfoVec[pixel].GetX() * (int)Color3::Num__RGBParameters + pixelInfoVec[pixel].GetY() * WINDOW_WIDTH * (int)Color3::Num__RGBParameters + colorIndex] = 0.0f; //See pgs. 146-147 to optimize this.
+
+	//	UpdatePixelInfo(newRelativeXYPosition);
+	//}
+
+private:
+	//void UpdatePixelInfo(const Vector3F &newRelativePosition)
+	//{
+	//	relativePosition = newRelativePosition;
+	//	pixelInfoVec.clear();
+
+	//	int worldX, worldY, worldZ;
+	//	for (unsigned int scanLine = 0; scanLine < relativeXPairVec.size(); scanLine++)
+	//	{
+	//		for (int pixelX = (int)relativeXPairVec[scanLine].GetX(); pixelX < (int)relativeXPairVec[scanLine].GetY(); pixelX++)
+	//		{
+	//			worldX = GetBaseX(scanLine + (int)vertexArr[0].GetY()) + pixelX + (int)relativePosition.GetX();
+	//			worldY = (int)vertexArr[0].GetY() + (int)relativePosition.GetY() + scanLine;
+	//			worldZ = GetWorldZ(worldX, worldY);
+	//			pixelInfoVec.push_back(Vector3I(worldX, worldY, worldZ));
+	//		}
+	//	}
+	//}
+
+private:
+	friend int RunKernelBenchmarks(); //Times ScanConvert() directly
+	friend class MeshFace; //Scan converts the same way
+	friend class TriangleMesh;
+	friend class TriangleShapeCache; //Scan converts each new shape
+
+	static void SortVertices(Vector3F sortedArr[3])
+	{
+		/*
+		* Sort points by y value, from least to greatest
+		*/
+		for (int i = 0; i < 3; i++)
+		{
+			for (int j = i + 1; j < 3; j++)
+			{
+				if (sortedArr[j].GetY() < sortedArr[i].GetY())
+				{
+					Vector3F temp = sortedArr[j];
+					sortedArr[j] = sortedArr[i];
+					sortedArr[i] = temp;
+				}
+			}
+		}
+
+		/*
+		* If this triangle has a horizontal edge, ensure the two vertices with the same
+		* y-value are also sorted by x-value, from least to greatest x-value.
+		*/
+		if (sortedArr[0].GetY() == sortedArr[1].GetY())
+		{
+			if (sortedArr[0].GetX() > sortedArr[1].GetX())
+			{
+				float tempX = sortedArr[0].GetX();
+				sortedArr[0].SetX(sortedArr[1].GetX());
+				sortedArr[1].SetX(tempX);
+			}
+		}
+		if (sortedArr[1].GetY() == sortedArr[2].GetY())
+		{
+			if (sortedArr[1].GetX() > sortedArr[2].GetX())
+			{
+				float tempX = sortedArr[1].GetX();
+				sortedArr[1].SetX(sortedArr[2].GetX());
+				sortedArr[2].SetX(tempX);
+			}
+		}
+	}
+
+	static void ScanConvert(const Vector3F sortedArr[3], std::vector<Vector2I> &xPairVec)
+	{
+		/*
+		* This function finds pairs of points along the edges of the triangle
+		* that share the same y value. Since each scan line is an integer value,
+		* relative y doesn't need to be explicitly stored, as it can be determined
+		* for a given relativeXPair by adding the index that the given pair is found
+		* at within the relativeXPairVec to the starting scan-line value.
+		*
+		* The xPairs are relative because the distance between edge-points on the same
+		* scan line doesn't differ, but a triangle can move around and have different
+		* screen position, thus affecting the offset x-values of all of its (edge) points.
+		*/
+		xPairVec.clear();
+
+		//If no two vertices share a y-value, horizontally split this triangle about its mid-vertex.
+		if (sortedArr[0].GetY() != sortedArr[1].GetY() && sortedArr[1].GetY() != sortedArr[2].GetY())
+		{
+			//Get point that x-pairs with the y-middle point of the triangle vertices
+			float slope = (sortedArr[2].GetY() - sortedArr[0].GetY()) / (sortedArr[2].GetX() - sortedArr[0].GetX());
+			float pairingPtX = ((sortedArr[1].GetY() - sortedArr[0].GetY()) / slope) + sortedArr[0].GetX();
+			Vector3F pairingPt = Vector3F(pairingPtX, sortedArr[1].GetY(), sortedArr[1].GetZ());
+
+			/*
+			* Both halves are scan converted in place, rather than by constructing a bottom
+			* and a top Triangle, since constructing a Triangle also rasterizes it into the
+			* depth buffer.
+			*/
+			Vector3F bottomArr[3] = { sortedArr[0], pairingPt, sortedArr[1] };
+			Vector3F topArr[3] = { pairingPt, sortedArr[1], sortedArr[2] };
+			SortVertices(bottomArr);
+			SortVertices(topArr);
+
+			AppendHorizontalEdgeXPairs(bottomArr, xPairVec);
+
+			//Check to see if they share the same xPair along the horizontal split, then remove it
+			//if (relativeXPairVec[relativeXPairVec.size() - 1] == topTriangle.relativeXPairVec[0])
+			//topTriangle.relativeXPairVec.erase(topTriangle.relativeXPairVec.begin());
+
+			AppendHorizontalEdgeXPairs(topArr, xPairVec);
+			return;
+		}
+
+		AppendHorizontalEdgeXPairs(sortedArr, xPairVec);
+	}
+
+	static void AppendHorizontalEdgeXPairs(const Vector3F sortedArr[3], std::vector<Vector2I> &xPairVec)
+	{
+		/*
+		* The triangle given by sortedArr already has one horizontal edge.
+		* First, get the slope of the left edge and the slope of the right edge.
+		* Then for a given y value, get the corresponding x values from both slopes.
+		* Store those two x values as a pair (Vector2I) into xPairVec.
+		*/
+		float slopeLeftEdge;
+		float slopeRightEdge;
+		if (sortedArr[0].GetY() == sortedArr[1].GetY()) //If horizontal edge is along the bottom edge
+		{
+			slopeLeftEdge = (sortedArr[2].GetY() - sortedArr[0].GetY()) / (sortedArr[2].GetX() - sortedArr[0].GetX());
+			slopeRightEdge = (sortedArr[2].GetY() - sortedArr[1].GetY()) / (sortedArr[2].GetX() - sortedArr[1].GetX());
+		}
+		else //Else the horizontal edge must be along the top edge
+		{
+			slopeLeftEdge = (sortedArr[1].GetY() - sortedArr[0].GetY()) / (sortedArr[1].GetX() - sortedArr[0].GetX());
+			slopeRightEdge = (sortedArr[2].GetY() - sortedArr[0].GetY()) / (sortedArr[2].GetX() - sortedArr[0].GetX());
+		}
+
+		float leftPtX, rightPtX;
+		for (int y = (int)sortedArr[0].GetY(); y < (int)sortedArr[2].GetY(); y++)
+		{
+			if (sortedArr[0].GetY() == sortedArr[1].GetY()) //If horizontal edge is along the bottom edge
+			{
+				leftPtX = ((float)y - sortedArr[0].GetY()) / slopeLeftEdge;
+				rightPtX = (((float)y - sortedArr[1].GetY()) / slopeRightEdge) + (sortedArr[1].GetX() - sortedArr[0].GetX())/*+ 0.5f*/;
+			}
+			else //Else the horizontal edge must be along the top edge
+			{
+				leftPtX = ((float)y - sortedArr[0].GetY()) / slopeLeftEdge;
+				rightPtX = (((float)y - sortedArr[0].GetY()) / slopeRightEdge) /*+ 0.5f*/;
+			}
+			xPairVec.push_back(Vector2I((int)leftPtX, (int)rightPtX));
+		}
+	}
+
+//Make this private later
+public:
+	Color4 color;
+	Vector3F vertexArr[3];
+	Vector3F relativePosition;
+	TriangleShapeReference shape; //Its x-pairs (stored as ints for drawing optimization), normal and bounds, shared with every triangle of the same shape
+	std::vector<ScanSpan> coveredSpanVec; //The onscreen world-space spans this triangle's resident fragments cover, sorted by y.
+	unsigned int primitiveId; //Tags this triangle's fragments in the depth buffer, since depth alone isn't unique.
+	bool dirty; /*
+				 * False while this triangle's fragments are resident in the depth buffer and
+				 * up to date. Set it to true after changing color (or vertexArr) directly, so
+				 * that the next UpdateTriangleAndDepthBuffer() call re-rasterizes it even if it
+				 * hasn't moved. Call SetShape() first if vertexArr changed.
+				 */
+};
+
+
+//Out-of-class definition of the TriangleShapeCache function that scan converts with Triangle.
+const TriangleShape *TriangleShapeCache::Acquire(const Vector3F sortedArr[3])
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	float keyArr[TriangleShape::KEY_LENGTH];
+	TriangleShape::GetKey(sortedArr, keyArr);
+	unsigned int bucket = GetBucket(keyArr);
+	for (unsigned int shape = bucketVec[bucket]; shape != NO_SHAPE; shape = shapeDeque[shape].nextInBucket)
+	{
+		if (memcmp(shapeDeque[shape].keyArr, keyArr, sizeof(keyArr)) == 0)
+		{
+			shapeDeque[shape].referenceCount++;
+			return &shapeDeque[shape];
+		}
+	}
+
+	//A new shape, in a recycled one if there is one
+	if (freeShapeVec.empty())
+	{
+		freeShapeVec.push_back((unsigned int)shapeDeque.size());
+		shapeDeque.push_back(TriangleShape());
+		if (shapeDeque.size() > bucketVec.size())
+		{
+			Rehash(bucketVec.size() * 2);
+			bucket = GetBucket(keyArr);
+		}
+	}
+	TriangleShape &newShape = shapeDeque[freeShapeVec.back()];
+	newShape.index = freeShapeVec.back();
+	freeShapeVec.pop_back();
+	memcpy(newShape.keyArr, keyArr, sizeof(keyArr));
+	Triangle::ScanConvert(sortedArr, newShape.relativeXPairVec);
+	newShape.normalVec = Triangle::GetNormalVector(sortedArr);
+	newShape.minCorner = Vector2F(sortedArr[0].GetX(), sortedArr[0].GetY());
+	newShape.maxCorner = newShape.minCorner;
+	for (int i = 1; i < 3; i++)
+	{
+		newShape.minCorner.SetX((sortedArr[i].GetX() < newShape.minCorner.GetX()) ? sortedArr[i].GetX() : newShape.minCorner.GetX());
+		newShape.minCorner.SetY((sortedArr[i].GetY() < newShape.minCorner.GetY()) ? sortedArr[i].GetY() : newShape.minCorner.GetY());
+		newShape.maxCorner.SetX((sortedArr[i].GetX() > newShape.maxCorner.GetX()) ? sortedArr[i].GetX() : newShape.maxCorner.GetX());
+		newShape.maxCorner.SetY((sortedArr[i].GetY() > newShape.maxCorner.GetY()) ? sortedArr[i].GetY() : newShape.maxCorner.GetY());
+	}
+	newShape.referenceCount = 1;
+	newShape.nextInBucket = bucketVec[bucket];
+	bucketVec[bucket] = newShape.index;
+	return &newShape;
+}
+
+
+
+/*
+ * A planar polygon with any number of vertices (quads, n-gons). Unlike Triangle, it is
+ * scan converted directly with an active edge table, so it never has to be split into
+ * smaller primitives. A pixel is covered if its (x, y) lies in [left edge, right edge)
+ * and [bottom, top) of the polygon, so adjacent polygons sharing an edge never overlap.
+ */
+class Polygon
+{
+public:
+	/*
+	* Constructor
+	*/
+	Polygon()
+	{
+		primitiveId = BACKGROUND_PRIMITIVE_ID;
+		dirty = true;
+	}
+	Polygon(RenderContext &context, const Color4 &newColor, const std::vector<Vector3F> &newVertexVec)
+	{
+		color = newColor;
+		primitiveId = nextPrimitiveId++;
+		dirty = true;
+		vertexVec = newVertexVec;
+		SetSpans();
+		SetNormalVector();
+		relativePosition = Vector3F(0, 0, 0);
+		UpdatePolygonAndDepthBuffer(context, *this, relativePosition);
+	}
+
+	/*
+	* Accessors
+	*/
+public:
+	int GetWorldZ(int worldX, int worldY) const
+	{
+		return GetWorldZ(worldX, worldY, relativePosition);
+	}
+	int GetWorldZ(int worldX, int worldY, const Vector3F &position) const
+	{
+		float localX = (float)(worldX - (int)position.GetX()) - vertexVec[0].GetX();
+		float localY = (float)(worldY - (int)position.GetY()) - vertexVec[0].GetY();
+		return (int)((-1 / normalVec[2])*(normalVec[0] * localX + normalVec[1] * localY) + vertexVec[0].GetZ() + position.GetZ());
+	}
+
+	//See Triangle::GetBounds()
+	void GetBounds(Vector2F &minCorner, Vector2F &maxCorner) const
+	{
+		minCorner = Vector2F(vertexVec[0].GetX(), vertexVec[0].GetY());
+		maxCorner = minCorner;
+		for (unsigned int i = 1; i < vertexVec.size(); i++)
+		{
+			minCorner.SetX((vertexVec[i].GetX() < minCorner.GetX()) ? vertexVec[i].GetX() : minCorner.GetX());
+			minCorner.SetY((vertexVec[i].GetY() < minCorner.GetY()) ? vertexVec[i].GetY() : minCorner.GetY());
+			maxCorner.SetX((vertexVec[i].GetX() > maxCorner.GetX()) ? vertexVec[i].GetX() : maxCorner.GetX());
+			maxCorner.SetY((vertexVec[i].GetY() > maxCorner.GetY()) ? vertexVec[i].GetY() : maxCorner.GetY());
+		}
+		minCorner = Vector2F(minCorner.GetX() + (int)relativePosition.GetX(), minCorner.GetY() + (int)relativePosition.GetY());
+		maxCorner = Vector2F(maxCorner.GetX() + (int)relativePosition.GetX(), maxCorner.GetY() + (int)relativePosition.GetY());
+	}
+
+	//See Triangle::GetCoverage(). Assumes this polygon is convex.
+	unsigned short GetCoverage(int worldX, int worldY) const
+	{
+		return GetCoverage(worldX, worldY, relativePosition);
+	}
+	unsigned short GetCoverage(int worldX, int worldY, const Vector3F &position) const
+	{
+		if (!antiAliasing)
+			return FULL_COVERAGE;
+		return GetCoverageMask(&vertexVec[0], vertexVec.size(), position, worldX, worldY);
+	}
+
+	/*
+	* Mutators
+	*/
+private:
+	void SetNormalVector()
+	{
+		//Newell's method, which stays well-defined even if some of the vertices are collinear.
+		float normalVecX = 0.0f, normalVecY = 0.0f, normalVecZ = 0.0f;
+		for (unsigned int i = 0; i < vertexVec.size(); i++)
+		{
+			const Vector3F &current = vertexVec[i];
+			const Vector3F &next = vertexVec[(i + 1) % vertexVec.size()];
+			normalVecX += (current.GetY() - next.GetY()) * (current.GetZ() + next.GetZ());
+			normalVecY += (current.GetZ() - next.GetZ()) * (current.GetX() + next.GetX());
+			normalVecZ += (current.GetX() - next.GetX()) * (current.GetY() + next.GetY());
+		}
+		normalVec = Vector3F(normalVecX, normalVecY, normalVecZ);
+	}
+
+	void SetSpans()
+	{
+		spanVec.clear();
+		if (vertexVec.size() < 3)
+			return;
+
+		float minY = vertexVec[0].GetY(), maxY = vertexVec[0].GetY();
+		for (unsigned int i = 1; i < vertexVec.size(); i++)
+		{
+			minY = (vertexVec[i].GetY() < minY) ? vertexVec[i].GetY() : minY;
+			maxY = (vertexVec[i].GetY() > maxY) ? vertexVec[i].GetY() : maxY;
+		}
+		int firstScanLine = (int)ceil(minY);
+		int endScanLine = (int)ceil(maxY);
+		if (firstScanLine >= endScanLine)
+			return;
+
+		/*
+		* Build the edge table: every non-horizontal edge is bucketed by the first scan line
+		* it crosses, along with the x-value where it crosses it and how much x changes for
+		* each following scan line.
+		*/
+		std::vector<std::vector<ActiveEdge> > edgeTable(endScanLine - firstScanLine);
+		for (unsigned int i = 0; i < vertexVec.size(); i++)
+		{
+			const Vector3F &lower = (vertexVec[i].GetY() < vertexVec[(i + 1) % vertexVec.size()].GetY()) ?
+				vertexVec[i] : vertexVec[(i + 1) % vertexVec.size()];
+			const Vector3F &upper = (&lower == &vertexVec[i]) ? vertexVec[(i + 1) % vertexVec.size()] : vertexVec[i];
+			int edgeFirstScanLine = (int)ceil(lower.GetY());
+			int edgeEndScanLine = (int)ceil(upper.GetY());
+			if (edgeFirstScanLine >= edgeEndScanLine)
+				continue; //Horizontal, or too short to cross any scan line
+
+			float inverseSlope = (upper.GetX() - lower.GetX()) / (upper.GetY() - lower.GetY());
+			float x = lower.GetX() + (edgeFirstScanLine - lower.GetY()) * inverseSlope;
+			edgeTable[edgeFirstScanLine - firstScanLine].push_back(ActiveEdge(edgeEndScanLine, x, inverseSlope));
+		}
+
+		/*
+		* Walk the scan lines from bottom to top, keeping the edges that cross the current scan
+		* line sorted by x in activeEdgeVec. Each consecutive pair of active edges bounds a span.
+		*/
+		std::vector<ActiveEdge> activeEdgeVec;
+		for (int y = firstScanLine; y < endScanLine; y++)
+		{
+			activeEdgeVec.insert(activeEdgeVec.end(), edgeTable[y - firstScanLine].begin(), edgeTable[y - firstScanLine].end());
+			for (unsigned int i = 0; i < activeEdgeVec.size();)
+			{
+				if (activeEdgeVec[i].endScanLine <= y)
+					activeEdgeVec.erase(activeEdgeVec.begin() + i);
+				else
+					i++;
+			}
+
+			//Insertion sort, since the active edges are nearly always still in order from the last scan line.
+			for (unsigned int i = 1; i < activeEdgeVec.size(); i++)
+			{
+				ActiveEdge edge = activeEdgeVec[i];
+				int j = (int)i - 1;
+				for (; j >= 0 && activeEdgeVec[j].x > edge.x; j--)
+					activeEdgeVec[j + 1] = activeEdgeVec[j];
+				activeEdgeVec[j + 1] = edge;
+			}
+
+			for (unsigned int i = 0; i + 1 < activeEdgeVec.size(); i += 2)
+			{
+				int startX = (int)ceil(activeEdgeVec[i].x);
+				int endX = (int)ceil(activeEdgeVec[i + 1].x);
+				if (startX < endX)
+					spanVec.push_back(ScanSpan(y, startX, endX));
+			}
+
+			for (unsigned int i = 0; i < activeEdgeVec.size(); i++)
+				activeEdgeVec[i].x += activeEdgeVec[i].inverseSlope;
+		}
+	}
+
+private:
+	class ActiveEdge
+	{
+	public:
+		ActiveEdge(int newEndScanLine = 0, float newX = 0.0f, float newInverseSlope = 0.0f)
+		{
+			endScanLine = newEndScanLine;
+			x = newX;
+			inverseSlope = newInverseSlope;
+		}
+	public:
+		int endScanLine; //The first scan line this edge no longer crosses
+		float x; //Where this edge crosses the current scan line
+		float inverseSlope; //dx/dy
+	};
+
+//Make this private later
+public:
+	Color4 color;
+	std::vector<Vector3F> vertexVec;
+	Vector3F relativePosition;
+	std::vector<ScanSpan> spanVec; //Relative to the polygon's untranslated position
+	std::vector<ScanSpan> coveredSpanVec; //See Triangle::coveredSpanVec
+	unsigned int primitiveId; //See Triangle::primitiveId
+	bool dirty; //See Triangle::dirty
+	Vector3F normalVec; //See Triangle::normalVec
+};
+
+
+/*
+ * One triangle of a TriangleMesh. It holds only the indices of its vertices, its plane and the
+ * spans it covers, and reads its vertices from the mesh's shared vertex buffer. Unlike a
+ * Triangle, it doesn't keep its scan-converted x-pairs, but redoes them whenever its covered
+ * spans are. It rasterizes exactly like a Triangle built from the same three vertices.
+ */
+class MeshFace
+{
+public:
+	/*
+	* Constructor
+	*/
+	MeshFace()
+	{
+		mesh = NULL;
+		primitiveId = BACKGROUND_PRIMITIVE_ID;
+		dirty = true;
+	}
+
+	/*
+	* Accessors
+	*/
+public:
+	void GetVertices(Vector3F vertexArr[3]) const;
+	void ScanConvert(std::vector<Vector2I> &xPairVec, int &firstY) const;
+
+	int GetWorldZ(int worldX, int worldY) const;
+	//See Triangle::GetWorldZ()
+	int GetWorldZ(int worldX, int worldY, const Vector3F &position) const
+	{
+		float localX = (float)(worldX - (int)position.GetX()) - planeOrigin.GetX();
+		float localY = (float)(worldY - (int)position.GetY()) - planeOrigin.GetY();
+		return (int)((-1 / normalVec[2])*(normalVec[0] * localX + normalVec[1] * localY) + planeOrigin.GetZ() + position.GetZ());
+	}
+
+	//See Triangle::GetCoverage()
+	unsigned short GetCoverage(int worldX, int worldY) const;
+	unsigned short GetCoverage(int worldX, int worldY, const Vector3F &position) const
+	{
+		if (!antiAliasing)
+			return FULL_COVERAGE;
+		Vector3F vertexArr[3];
+		GetVertices(vertexArr);
+		return GetCoverageMask(vertexArr, 3, position, worldX, worldY);
+	}
+
+//Make this private later
+public:
+	const TriangleMesh *mesh;
+	unsigned int indexArr[3]; //Into the mesh's vertex buffer
+	Color4 color;
+	Vector3F planeOrigin; //The first of the sorted vertices (see Triangle::SortVertices()), which the plane is relative to
+	Vector3F normalVec; //See Triangle::normalVec
+	std::vector<ScanSpan> coveredSpanVec; //See Triangle::coveredSpanVec
+	unsigned int primitiveId; //See Triangle::primitiveId
+	bool dirty; //See Triangle::dirty
+};
+
+
+/*
+ * An indexed triangle mesh: a vertex buffer shared by every face, and an index buffer with three
+ * vertices per face. Shared vertices are stored (and moved) once, however many faces use them,
+ * and the faces are rasterized together, in one batch with sortLastRasterization. Each face has
+ * its own primitiveId, from a contiguous range.
+ *
+ * The vertex buffer is kept as the model's vertices and as those vertices under the mesh's
+ * transform, each as separate x, y and z arrays so that they can be transformed in SIMD batches
+ * (see TransformMeshesInDepthBuffer()). relativePosition is applied on top of the transform.
+ */
+class TriangleMesh
+{
+public:
+	/*
+	* Constructor
+	*/
+	TriangleMesh()
+	{
+	}
+	TriangleMesh(RenderContext &context, const Color4 &newColor, const std::vector<Vector3F> &newVertexVec, const std::vector<unsigned int> &newIndexVec,
+		const AffineTransform &newTransform = AffineTransform())
+	{
+		for (unsigned int vertex = 0; vertex < newVertexVec.size(); vertex++)
+		{
+			modelXVec.push_back(newVertexVec[vertex].GetX());
+			modelYVec.push_back(newVertexVec[vertex].GetY());
+			modelZVec.push_back(newVertexVec[vertex].GetZ());
+		}
+		xVec.resize(modelXVec.size());
+		yVec.resize(modelYVec.size());
+		zVec.resize(modelZVec.size());
+		indexVec = newIndexVec;
+		faceVec.resize(indexVec.size() / 3);
+		for (unsigned int face = 0; face < faceVec.size(); face++)
+		{
+			faceVec[face].mesh = this;
+			faceVec[face].color = newColor;
+			faceVec[face].primitiveId = nextPrimitiveId++;
+			for (int i = 0; i < 3; i++)
+				faceVec[face].indexArr[i] = indexVec[face * 3 + i];
+		}
+		SetTransform(newTransform);
+		relativePosition = Vector3F(0, 0, 0);
+		UpdateMeshAndDepthBuffer(context, *this, relativePosition);
+	}
+	//The faces point back at their mesh, so copies repoint them.
+	TriangleMesh(const TriangleMesh &otherMesh)
+	{
+		*this = otherMesh;
+	}
+	TriangleMesh &operator=(const TriangleMesh &otherMesh)
+	{
+		modelXVec = otherMesh.modelXVec;
+		modelYVec = otherMesh.modelYVec;
+		modelZVec = otherMesh.modelZVec;
+		xVec = otherMesh.xVec;
+		yVec = otherMesh.yVec;
+		zVec = otherMesh.zVec;
+		transform = otherMesh.transform;
+		indexVec = otherMesh.indexVec;
+		faceVec = otherMesh.faceVec;
+		relativePosition = otherMesh.relativePosition;
+		for (unsigned int face = 0; face < faceVec.size(); face++)
+			faceVec[face].mesh = this;
+		return *this;
+	}
+
+	/*
+	* Accessors
+	*/
+public:
+	unsigned int GetVertexCount() const
+	{
+		return (unsigned int)xVec.size();
+	}
+	Vector3F GetVertex(unsigned int vertex) const
+	{
+		return Vector3F(xVec[vertex], yVec[vertex], zVec[vertex]);
+	}
+
+	//See Triangle::GetBounds(). Shared vertices are only looked at once.
+	void GetBounds(Vector2F &minCorner, Vector2F &maxCorner) const
+	{
+		minCorner = Vector2F(xVec[0], yVec[0]);
+		maxCorner = minCorner;
+		for (unsigned int i = 1; i < xVec.size(); i++)
+		{
+			minCorner.SetX((xVec[i] < minCorner.GetX()) ? xVec[i] : minCorner.GetX());
+			minCorner.SetY((yVec[i] < minCorner.GetY()) ? yVec[i] : minCorner.GetY());
+			maxCorner.SetX((xVec[i] > maxCorner.GetX()) ? xVec[i] : maxCorner.GetX());
+			maxCorner.SetY((yVec[i] > maxCorner.GetY()) ? yVec[i] : maxCorner.GetY());
+		}
+		minCorner = Vector2F(minCorner.GetX() + (int)relativePosition.GetX(), minCorner.GetY() + (int)relativePosition.GetY());
+		maxCorner = Vector2F(maxCorner.GetX() + (int)relativePosition.GetX(), maxCorner.GetY() + (int)relativePosition.GetY());
+	}
+
+	//The primitiveId the mesh as a whole goes by, e.g. in spatialGrid
+	unsigned int GetPrimitiveId() const
+	{
+		return faceVec.empty() ? BACKGROUND_PRIMITIVE_ID : faceVec[0].primitiveId;
+	}
+
+	/*
+	* Mutators
+	*/
+public:
+	/*
+	 * Transforms the model's vertices by newTransform, and sets up the faces again. Call it once
+	 * the mesh has been masked out of the depth buffer.
+	 */
+	void SetTransform(const AffineTransform &newTransform)
+	{
+		transform = newTransform;
+		if (!modelXVec.empty())
+			transform.TransformVertices(&modelXVec[0], &modelYVec[0], &modelZVec[0], modelXVec.size(), &xVec[0], &yVec[0], &zVec[0]);
+		SetFaces();
+	}
+
+	/*
+	 * Sets up every face's plane from the vertex buffer, and marks it dirty. Call it after
+	 * changing the vertex buffer, once the mesh has been masked out of the depth buffer.
+	 */
+	void SetFaces()
+	{
+		for (unsigned int face = 0; face < faceVec.size(); face++)
+		{
+			Vector3F sortedArr[3];
+			faceVec[face].GetVertices(sortedArr);
+			Triangle::SortVertices(sortedArr);
+			faceVec[face].planeOrigin = sortedArr[0];
+			faceVec[face].normalVec = Triangle::GetNormalVector(sortedArr);
+			faceVec[face].dirty = true;
+		}
+	}
+
+//Make this private later
+public:
+	std::vector<float> modelXVec, modelYVec, modelZVec; //The model's vertices, before transform
+	std::vector<float> xVec, yVec, zVec; //The vertices under transform: untranslated, and shared by every face
+	AffineTransform transform;
+	std::vector<unsigned int> indexVec; //Three vertex indices per face
+	std::vector<MeshFace> faceVec;
+	Vector3F relativePosition; //Of every face
+};
+
+//Out-of-class definitions of the MeshFace functions that read from its mesh.
+void MeshFace::GetVertices(Vector3F vertexArr[3]) const
+{
+	for (int i = 0; i < 3; i++)
+		vertexArr[i] = mesh->GetVertex(indexArr[i]);
+}
+
+//Sets xPairVec to the untranslated [startX, endX) of each scan line from firstY on, base x included.
+void MeshFace::ScanConvert(std::vector<Vector2I> &xPairVec, int &firstY) const
+{
+	Vector3F sortedArr[3];
+	GetVertices(sortedArr);
+	Triangle::SortVertices(sortedArr);
+	Triangle::ScanConvert(sortedArr, xPairVec);
+	firstY = (int)sortedArr[0].GetY();
+	for (unsigned int scanLine = 0; scanLine < xPairVec.size(); scanLine++)
+	{
+		int baseX = Triangle::GetBaseX(sortedArr, scanLine + firstY);
+		xPairVec[scanLine] = Vector2I(xPairVec[scanLine].GetX() + baseX, xPairVec[scanLine].GetY() + baseX);
+	}
+}
+
+int MeshFace::GetWorldZ(int worldX, int worldY) const
+{
+	return GetWorldZ(worldX, worldY, mesh->relativePosition);
+}
+
+unsigned short MeshFace::GetCoverage(int worldX, int worldY) const
+{
+	return GetCoverage(worldX, worldY, mesh->relativePosition);
+}
+
+
+/*
+ * A triangle too small for its shape to show (see IsSplatSized()), drawn as a splat instead: a
+ * square of whole pixels with about the triangle's area (one pixel for a point splat), at the
+ * depth of its centroid. It has no scan-converted spans to set up or keep, since its footprint
+ * is just the square, so it only costs as much as the pixels it produces. Splats are batched
+ * into the depth buffer by RasterizeSplats(), rather than when they're constructed.
+ */
+class Splat
+{
+public:
+	/*
+	* Constructor
+	*/
+	Splat()
+	{
+		cornerX = cornerY = depth = 0;
+		size = 1;
+		primitiveId = BACKGROUND_PRIMITIVE_ID;
+		dirty = true;
+	}
+	//Stands in for the triangle p1, p2, p3.
+	Splat(const Color4 &newColor, const Vector3F &p1, const Vector3F &p2, const Vector3F &p3)
+	{
+		color = newColor;
+		primitiveId = nextPrimitiveId++;
+		dirty = true;
+		float area = fabs((p2.GetX() - p1.GetX()) * (p3.GetY() - p1.GetY()) - (p3.GetX() - p1.GetX()) * (p2.GetY() - p1.GetY())) / 2;
+		size = (int)(sqrt(area) + 0.5f);
+		size = (size < 1) ? 1 : size;
+		cornerX = (int)floor((p1.GetX() + p2.GetX() + p3.GetX()) / 3 - size / 2.0f + 0.5f);
+		cornerY = (int)floor((p1.GetY() + p2.GetY() + p3.GetY()) / 3 - size / 2.0f + 0.5f);
+		depth = (int)((p1.GetZ() + p2.GetZ() + p3.GetZ()) / 3);
+		relativePosition = Vector3F(0, 0, 0);
+	}
+
+	/*
+	* Accessors
+	*/
+public:
+	//A splat is flat and covers its pixels fully, with or without anti-aliasing.
+	int GetWorldZ(int worldX, int worldY) const
+	{
+		return GetWorldZ(worldX, worldY, relativePosition);
+	}
+	int GetWorldZ(int /*worldX*/, int /*worldY*/, const Vector3F &position) const
+	{
+		return depth + (int)position.GetZ();
+	}
+	unsigned short GetCoverage(int /*worldX*/, int /*worldY*/) const
+	{
+		return FULL_COVERAGE;
+	}
+	unsigned short GetCoverage(int /*worldX*/, int /*worldY*/, const Vector3F &/*position*/) const
+	{
+		return FULL_COVERAGE;
+	}
+
+	//The pixels [startX, endX) x [startY, endY) covered at position, clipped to the viewport. False if there are none.
+	bool GetFootprint(const Vector3F &position, int &startX, int &startY, int &endX, int &endY) const
+	{
+		startX = cornerX + (int)position.GetX();
+		startY = cornerY + (int)position.GetY();
+		endX = startX + size;
+		endY = startY + size;
+		startX = (startX < 0) ? 0 : startX;
+		startY = (startY < 0) ? 0 : startY;
+		endX = (endX > (int)WINDOW_WIDTH) ? (int)WINDOW_WIDTH : endX;
+		endY = (endY > (int)WINDOW_HEIGHT) ? (int)WINDOW_HEIGHT : endY;
+		return startX < endX && startY < endY;
+	}
+
+	//The world-space bounding box of this splat at its current relativePosition
+	void GetBounds(Vector2F &minCorner, Vector2F &maxCorner) const
+	{
+		minCorner = Vector2F((float)(cornerX + (int)relativePosition.GetX()), (float)(cornerY + (int)relativePosition.GetY()));
+		maxCorner = Vector2F(minCorner.GetX() + size, minCorner.GetY() + size);
+	}
+
+//Make this private later
+public:
+	Color4 color;
+	int cornerX; //The untranslated top-left pixel of the square
+	int cornerY;
+	int depth; //Untranslated
+	int size; //The square's side, in pixels
+	Vector3F relativePosition;
+	unsigned int primitiveId; //See Triangle::primitiveId
+	bool dirty; //If true, the splat isn't resident in the depth buffer
+};
+
+//True if a triangle is small enough to be drawn as a Splat: it covers only a few pixels, and isn't long enough for its shape to show.
+bool IsSplatSized(const Vector3F &p1, const Vector3F &p2, const Vector3F &p3)
+{
+	float minX = p1.GetX(), maxX = p1.GetX(), minY = p1.GetY(), maxY = p1.GetY();
+	const Vector3F *vertexArr[2] = { &p2, &p3 };
+	for (int i = 0; i < 2; i++)
+	{
+		minX = (vertexArr[i]->GetX() < minX) ? vertexArr[i]->GetX() : minX;
+		maxX = (vertexArr[i]->GetX() > maxX) ? vertexArr[i]->GetX() : maxX;
+		minY = (vertexArr[i]->GetY() < minY) ? vertexArr[i]->GetY() : minY;
+		maxY = (vertexArr[i]->GetY() > maxY) ? vertexArr[i]->GetY() : maxY;
+	}
+	float area = fabs((p2.GetX() - p1.GetX()) * (p3.GetY() - p1.GetY()) - (p3.GetX() - p1.GetX()) * (p2.GetY() - p1.GetY())) / 2;
+	return area <= SPLAT_MAX_AREA && maxX - minX <= SPLAT_MAX_EXTENT && maxY - minY <= SPLAT_MAX_EXTENT;
+}
+
+
+/*
+ * A fragment as it's stored in a depth buffer: its depth, which of the pixel's subpixels it
+ * covers, its unblended color and the primitive it belongs to. With 16-bit depths it packs into
+ * 12 bytes. Colors are converted to and from Color4 where fragments are inserted and blended,
+ * and depths are clamped to DepthType (Z_FAR to Z_NEAR fits a short with plenty of room to
+ * spare for sloped primitives).
+ */
+template <class DepthType>
+class DepthInfo
+{
+public:
+	DepthInfo(int newDepth = Z_FAR, const PackedColor &newColor = PackedColor(),
+		unsigned int newPrimitiveId = BACKGROUND_PRIMITIVE_ID, unsigned short newCoverage = FULL_COVERAGE)
+	{
+		depth = PackDepth(newDepth);
+		coverage = newCoverage;
+		color = newColor;
+		primitiveId = newPrimitiveId;
+	}
+
+	static DepthType PackDepth(int worldZ)
+	{
+		long long clampedZ = worldZ;
+		clampedZ = (clampedZ < std::numeric_limits<DepthType>::min()) ? std::numeric_limits<DepthType>::min() : clampedZ;
+		clampedZ = (clampedZ > std::numeric_limits<DepthType>::max()) ? std::numeric_limits<DepthType>::max() : clampedZ;
+		return (DepthType)clampedZ;
+	}
+public:
+	DepthType depth;
+	unsigned short coverage; //Which of the pixel's subpixels this fragment covers
+	PackedColor color;
+	unsigned int primitiveId;
+};
+
+
+/*
+ * Storage policies decide how each pixel's fragment lists are held. A storage policy gives
+ * every pixel a depth-sorted list of DepthInfos and a parallel list of blended colors, both
+ * with the interface of std::vector.
+ *
+ * VectorStorage keeps one heap-allocated std::vector per pixel for each list. The arrays of
+ * vectors are large buffers, constructed band by band by the workers that own the rows.
+ */
+template <class DepthType>
+class VectorStorage
+{
+public:
+	typedef std::vector<DepthInfo<DepthType> > FragmentList;
+	typedef std::vector<PackedColor> BlendedList;
+
+	static const char *GetName()
+	{
+		return "pixels";
+	}
+
+	VectorStorage(unsigned int newWidth, unsigned int newHeight)
+	{
+		width = newWidth;
+		height = newHeight;
+		zBuffer = (FragmentList *)AllocateLargeBuffer(width * height * sizeof(FragmentList));
+		aBuffer = (BlendedList *)AllocateLargeBuffer(width * height * sizeof(BlendedList));
+		ForEachRowBand([this](int firstRow, int lastRow)
+		{
+			for (unsigned int bufferIndex = firstRow * width; bufferIndex < lastRow * width; bufferIndex++)
+			{
+				new (&zBuffer[bufferIndex]) FragmentList();
+				new (&aBuffer[bufferIndex]) BlendedList();
+			}
+		}, height);
+	}
+	~VectorStorage()
+	{
+		for (unsigned int bufferIndex = 0; bufferIndex < width * height; bufferIndex++)
+		{
+			zBuffer[bufferIndex].~FragmentList();
+			aBuffer[bufferIndex].~BlendedList();
+		}
+		FreeLargeBuffer(zBuffer, width * height * sizeof(FragmentList));
+		FreeLargeBuffer(aBuffer, width * height * sizeof(BlendedList));
+	}
+
+	//Reports how the arrays of lists are backed and placed. The lists' contents are on the heap.
+	void ReportMemory() const
+	{
+		ReportLargeBuffer("zBuffer lists", zBuffer, width * height * sizeof(FragmentList), height);
+		ReportLargeBuffer("aBuffer lists", aBuffer, width * height * sizeof(BlendedList), height);
+	}
+
+	//The arrays of lists, and every list's contents
+	size_t GetBytes() const
+	{
+		size_t bytes = width * height * (sizeof(FragmentList) + sizeof(BlendedList));
+		for (unsigned int bufferIndex = 0; bufferIndex < width * height; bufferIndex++)
+			bytes += zBuffer[bufferIndex].capacity() * sizeof(DepthInfo<DepthType>) + aBuffer[bufferIndex].capacity() * sizeof(PackedColor);
+		return bytes;
+	}
+
+	FragmentList &GetFragmentList(unsigned int bufferIndex)
+	{
+		return zBuffer[bufferIndex];
+	}
+	const FragmentList &GetFragmentList(unsigned int bufferIndex) const
+	{
+		return zBuffer[bufferIndex];
+	}
+	BlendedList &GetBlendedList(unsigned int bufferIndex)
+	{
+		return aBuffer[bufferIndex];
+	}
+	const BlendedList &GetBlendedList(unsigned int bufferIndex) const
+	{
+		return aBuffer[bufferIndex];
+	}
+
+private:
+	/*
+	 * Both buffers store Color info sorted from most-positive z-value to most-negative z-value.
+	 * Thus, the pixel that should be drawn at a given location is given by the greatest-indexed
+	 * aBuffer color.
+	 */
+	//std::vector<DepthInfo> zBuffer[WINDOW_WIDTH * WINDOW_HEIGHT]; //Holds unmodified Color4 pixel info of polygons in the scene.
+	//std::vector<DepthInfo> aBuffer[WINDOW_WIDTH * WINDOW_HEIGHT]; //Holds blended Color4 pixel info of polygons in the scene.
+	FragmentList *zBuffer; //Holds unmodified Color4 pixel info of polygons in the scene.
+	BlendedList *aBuffer; //Holds the blended color of each zBuffer fragment, at the same index.
+	unsigned int width;
+	unsigned int height;
+};
+
+
+/*
+ * Blend policies decide how a fragment's color is combined with the (already blended) color
+ * behind it. Fragments that HidesBehind() are stored as they are, and the rest are stored as
+ * Blend()'s result, which is always opaque. DEPENDS_ON_BEHIND is false when the color behind
+ * is never used, so that only changed fragments are re-blended.
+ */
+//Every fragment hides whatever is behind it, whatever its alpha.
+class OpaqueBlend
+{
+public:
+	static const bool DEPENDS_ON_BEHIND = false;
+	static const char *GetName()
+	{
+		return "opaque";
+	}
+	static bool HidesBehind(const PackedColor &/*color*/)
+	{
+		return true;
+	}
+	static Color4V Blend(const PackedColor &color, const Color4V &/*behindColor*/)
+	{
+		return color.GetColor4V().GetOpaque();
+	}
+};
+
+//The original rule: translucent fragments are averaged with what's behind them, after being scaled by their alpha.
+class AlphaBlend
+{
+public:
+	static const bool DEPENDS_ON_BEHIND = true;
+	static const char *GetName()
+	{
+		return "alpha";
+	}
+	static bool HidesBehind(const PackedColor &color)
+	{
+		return color.IsOpaque();
+	}
+	static Color4V Blend(const PackedColor &color, const Color4V &behindColor)
+	{
+		Color4V colorV = color.GetColor4V();
+		return ((colorV * colorV.GetAlphaSplat() + behindColor) * 0.5f).GetOpaque();
+	}
+};
+
+//Fragments add their color, scaled by their alpha, to what's behind them, saturating at white.
+class AdditiveBlend
+{
+public:
+	static const bool DEPENDS_ON_BEHIND = true;
+	static const char *GetName()
+	{
+		return "additive";
+	}
+	static bool HidesBehind(const PackedColor &/*color*/)
+	{
+		return false;
+	}
+	static Color4V Blend(const PackedColor &color, const Color4V &behindColor)
+	{
+		Color4V colorV = color.GetColor4V();
+		return (colorV * colorV.GetAlphaSplat() + behindColor).GetOpaque();
+	}
+};
+
+
+/*
+ * How much memory a depth buffer's fragments take, and where (see DepthBuffer::GetFragmentUsage()).
+ * Fragments are the ones in front of the background. currentBytes and peakBytes count them
+ * live, while the breakdowns by region and by primitive are found by walking the buffer.
+ */
+class FragmentUsage
+{
+public:
+	FragmentUsage()
+	{
+		budgetBytes = 0;
+		currentBytes = 0;
+		peakBytes = 0;
+		heldBytes = 0;
+		mergedCount = 0;
+	}
+
+	//Make this private later
+	size_t budgetBytes; //0 if there's no budget
+	size_t currentBytes;
+	size_t peakBytes; //Since the buffer was created, sampled once a frame
+	size_t heldBytes; //Everything GetFragmentBytes() counts, allocated capacity and background included
+	unsigned long long mergedCount; //Fragments merged into the background to keep within the budget
+	std::vector<size_t> regionBytesVec; //One per GRID_CELL_SIZE*GRID_CELL_SIZE cell, row by row
+	std::vector<std::pair<unsigned int, size_t> > primitiveBytesVec; //(primitiveId, bytes), most bytes first
+};
+
+
+//A DepthInfo's members, widened and without its padding, so that the same scene always writes the same bytes
+class CheckpointFragment
+{
+public:
+	int depth;
+	PackedColor color;
+	unsigned int primitiveId;
+	unsigned int coverage;
+};
+
+//An IntervalDepthBuffer run's members, widened and without its padding, for the same reason
+class CheckpointRun
+{
+public:
+	unsigned int startX;
+	unsigned int endX;
+	unsigned int coverage;
+	int depth;
+	PackedColor color;
+	unsigned int primitiveId;
+	unsigned int sequence;
+};
+
+
+/*
+ * The interface the rest of the renderer draws through. Fragments are inserted, removed and
+ * moved a span of pixels at a time, with each pixel's depth and coverage computed beforehand,
+ * so that the per-pixel loops are compiled into each configuration of SpecializedDepthBuffer
+ * rather than dispatched per pixel. Spans must already be clipped to the buffer.
+ */
+class DepthBuffer
+{
+public:
+	/*
+	 * Constructors
+	 */
+	DepthBuffer(unsigned int newWidth, unsigned int newHeight)
+	{
+		width = newWidth;
+		height = newHeight;
+		fragmentBudget = 0;
+		pixelBuffer = NULL;
+		rowStep = 1;
+	}
+	virtual ~DepthBuffer()
+	{
+	}
+
+	/*
+	 * Accessors
+	 */
+	unsigned int GetWidth() const
+	{
+		return width;
+	}
+	unsigned int GetHeight() const
+	{
+		return height;
+	}
+	virtual const char *GetName() const = 0; //Of the blend
+	virtual const char *GetStorageName() const = 0;
+	virtual int GetDepthBits() const = 0;
+	size_t GetFragmentBudget() const
+	{
+		return fragmentBudget;
+	}
+	float *GetPixelBuffer() const
+	{
+		return pixelBuffer;
+	}
+	unsigned int GetRowStep() const
+	{
+		return rowStep;
+	}
+
+	//Whether row worldY is rasterized at the current row step. The rows in between are filled in by Resolve().
+	bool IsRenderedRow(int worldY) const
+	{
+		return worldY % (int)rowStep == 0;
+	}
+
+	//The rendered row that row worldY shows.
+	int GetRenderedRow(int worldY) const
+	{
+		return worldY - worldY % (int)rowStep;
+	}
+
+	//Reports how the buffers are backed by pages, and on which NUMA nodes (see ReportLargeBuffer()).
+	virtual void ReportMemory() const = 0;
+
+	//The memory the fragments are held in, on the heap included.
+	virtual size_t GetFragmentBytes() const = 0;
+
+	//Fills usage with how much memory the fragments take, and where.
+	void GetFragmentUsage(FragmentUsage &usage) const
+	{
+		std::map<unsigned int, size_t> primitiveBytesMap;
+		usage = FragmentUsage();
+		usage.budgetBytes = fragmentBudget;
+		usage.heldBytes = GetFragmentBytes();
+		usage.regionBytesVec.assign(GetRegionColumns() * ((height + GRID_CELL_SIZE - 1) / GRID_CELL_SIZE), 0);
+		AddFragmentUsage(usage, primitiveBytesMap);
+		usage.primitiveBytesVec.assign(primitiveBytesMap.begin(), primitiveBytesMap.end());
+		std::sort(usage.primitiveBytesVec.begin(), usage.primitiveBytesVec.end(),
+			[](const std::pair<unsigned int, size_t> &a, const std::pair<unsigned int, size_t> &b) { return a.second > b.second; });
+	}
+
+	/*
+	 * Appends every fragment (and whatever else is needed to blend them again) to data, as a
+	 * section of a checkpoint file (see WriteCheckpoint()). It holds no pointers, so it can be
+	 * read straight out of a mapping wherever the file is mapped.
+	 */
+	virtual void AppendCheckpoint(std::vector<char> &data) const = 0;
+
+	//Writes every pixel's visible color to pixelBuffer.
+	virtual void Resolve() const = 0;
+
+	/*
+	 * Brings pixelBuffer up to date with the frame just rendered. Buffers that draw each pixel
+	 * as it's blended only need to fill in the rows that aren't rendered, so they override
+	 * this; the rest resolve every pixel.
+	 */
+	virtual void ResolveFrame() const
+	{
+		Resolve();
+	}
+
+	void Draw() const
+	{
+		ResolveFrame();
+
+		/*
+		* Both of these functions update the pixels onscreen, so that each time a new pixel
+		* is "added to" pixelBuffer, it immediately draws onscreen. This way, the lines
+		* animate as they're drawn to the screen.
+		*/
+		//Draws pixel on screen, width and height must match pixel buffer dimension
+		glDrawPixels(WINDOW_WIDTH, WINDOW_HEIGHT, GL_RGB, GL_FLOAT, pixelBuffer);
+		//Window refresh
+		glFlush();
+	}
+
+	/*
+	 * Mutators
+	 */
+	//Removes every fragment but the background's, and redraws the whole pixelBuffer to match.
+	virtual void Clear() = 0;
+
+	//The frame Resolve() writes to (see NewPixelBuffer()), which has to be set before anything is drawn.
+	void SetPixelBuffer(float *newPixelBuffer)
+	{
+		pixelBuffer = newPixelBuffer;
+	}
+
+	/*
+	 * Only rows that are multiples of newRowStep are rasterized from now on (see class
+	 * ResolutionController). The fragments already in the buffer are left as they are, so it
+	 * should be cleared first.
+	 */
+	void SetRowStep(unsigned int newRowStep)
+	{
+		rowStep = newRowStep;
+	}
+
+	/*
+	 * Replaces every fragment with the ones in a section written by AppendCheckpoint(), by a
+	 * depth buffer of the same configuration, without blending anything again. Returns false,
+	 * without changing anything, if the section is malformed. Call Resolve() to draw the
+	 * restored frame, since ResolveFrame() may only fill in the rows that aren't rendered.
+	 */
+	virtual bool RestoreCheckpoint(const char *data, size_t bytes) = 0;
+
+	/*
+	 * Limits the memory of the fragments in front of the background to about bytes, or lifts
+	 * the limit if bytes is 0. Once the limit is reached, a pixel that gets a new fragment
+	 * merges its farthest fragment into its background instead of holding another one, so
+	 * whatever is drawn costs more detail rather than more memory.
+	 */
+	virtual void SetFragmentBudget(size_t bytes)
+	{
+		fragmentBudget = bytes;
+	}
+
+	//Inserts (or updates) the fragments of pixels [startX, endX) on row worldY whose coverage isn't 0.
+	virtual void InsertSpan(int worldY, int startX, int endX, const int *worldZArr, const unsigned short *coverageArr,
+		const Color4 &color, unsigned int primitiveId) = 0;
+
+	virtual void RemoveSpan(int worldY, int startX, int endX, const int *worldZArr, unsigned int primitiveId) = 0;
+
+	//Moves a primitive's fragments on pixels [startX, endX) of row worldY to new depths and coverages, in place.
+	virtual void MoveSpan(int worldY, int startX, int endX, const int *oldWorldZArr, const int *newWorldZArr,
+		const unsigned short *oldCoverageArr, const unsigned short *newCoverageArr, const Color4 &color, unsigned int primitiveId) = 0;
+
+	/*
+	 * Merges the fragments appended to pixels [startX, endX) of row worldY of fragmentStore into
+	 * the buffers, then blends and draws each pixel once. The fragments are inserted from back to
+	 * front, and fragments at the same depth in the order their primitives were created, so that
+	 * the result doesn't depend on which thread appended them first. Pixels that were already
+	 * resolved are skipped.
+	 */
+	virtual void ResolveFragmentSpan(FragmentStore &fragmentStore, int worldY, int startX, int endX) = 0;
+
+	/*
+	 * The coveredSpanVec of a primitive only ever holds pixels that were clipped to the viewport.
+	 * Once masked, the primitive's fragments are no longer resident, so it is marked dirty.
+	 */
+	void MaskBuffers(Triangle &triangleMask)
+	{
+		MaskPrimitive(triangleMask);
+	}
+	void MaskBuffers(Polygon &polygonMask)
+	{
+		MaskPrimitive(polygonMask);
+	}
+	void MaskBuffers(MeshFace &faceMask)
+	{
+		MaskPrimitive(faceMask);
+	}
+	void MaskBuffers(Splat &splatMask)
+	{
+		int startX, startY, endX, endY;
+		if (!splatMask.dirty && splatMask.GetFootprint(splatMask.relativePosition, startX, startY, endX, endY))
+		{
+			int worldZArr[SPAN_CHUNK_SIZE];
+			for (int worldX = startX; worldX < endX; worldX++)
+				worldZArr[worldX - startX] = splatMask.GetWorldZ(worldX, startY);
+			for (int worldY = startY; worldY < endY; worldY++)
+				if (IsRenderedRow(worldY))
+					RemoveSpan(worldY, startX, endX, worldZArr, splatMask.primitiveId);
+		}
+		splatMask.dirty = true;
+	}
+	void MaskBuffers(TriangleMesh &meshMask)
+	{
+		for (unsigned int face = 0; face < meshMask.faceVec.size(); face++)
+			MaskPrimitive(meshMask.faceVec[face]);
+	}
+
+private:
+	//Removes the primitive's fragments SPAN_CHUNK_SIZE pixels at a time.
+	template <class Primitive>
+	void MaskPrimitive(Primitive &primitiveMask)
+	{
+		int worldZArr[SPAN_CHUNK_SIZE];
+		const std::vector<ScanSpan> &spanVec = primitiveMask.coveredSpanVec;
+		for (unsigned int span = 0; span < spanVec.size(); span++)
+		{
+			for (int startX = spanVec[span].startX; startX < spanVec[span].endX; startX += SPAN_CHUNK_SIZE)
+			{
+				int endX = (startX + SPAN_CHUNK_SIZE < spanVec[span].endX) ? startX + SPAN_CHUNK_SIZE : spanVec[span].endX;
+				for (int worldX = startX; worldX < endX; worldX++)
+					worldZArr[worldX - startX] = primitiveMask.GetWorldZ(worldX, spanVec[span].y);
+				RemoveSpan(spanVec[span].y, startX, endX, worldZArr, primitiveMask.primitiveId);
+			}
+		}
+		primitiveMask.coveredSpanVec.clear();
+		primitiveMask.dirty = true;
+	}
+
+protected:
+	//Adds the current and peak bytes, and every fragment's bytes to its region and to its primitive in primitiveBytesMap.
+	virtual void AddFragmentUsage(FragmentUsage &usage, std::map<unsigned int, size_t> &primitiveBytesMap) const = 0;
+
+	unsigned int GetRegionColumns() const
+	{
+		return (width + GRID_CELL_SIZE - 1) / GRID_CELL_SIZE;
+	}
+	unsigned int GetRegion(int x, int y) const
+	{
+		return (y / GRID_CELL_SIZE) * GetRegionColumns() + x / GRID_CELL_SIZE;
+	}
+
+	void SetPixel(int x, int y, const Color3 &color) const
+	{
+		::SetPixel(pixelBuffer, x, y, color);
+	}
+	void CopyPixelRow(int fromY, int toY) const
+	{
+		::CopyPixelRow(pixelBuffer, fromY, toY);
+	}
+
+	unsigned int width;
+	unsigned int height;
+	size_t fragmentBudget; //In bytes, 0 for none
+	float *pixelBuffer; //Not owned
+	unsigned int rowStep;
+};
+
+
+/*
+ * A DepthBuffer specialized at compile time on how it stores fragments (StoragePolicy), how it
+ * blends them (BlendPolicy) and how many bits their depths get (DepthType). See the explicit
+ * instantiations below for the configurations that are built, and NewDepthBuffer() for
+ * choosing one at runtime.
+ */
+template <template <class> class StoragePolicy, class BlendPolicy, class DepthType>
+class SpecializedDepthBuffer : public DepthBuffer
+{
+public:
+	typedef DepthInfo<DepthType> Fragment;
+	typedef typename StoragePolicy<DepthType>::FragmentList FragmentList;
+	typedef typename StoragePolicy<DepthType>::BlendedList BlendedList;
+
+	/*
+	 * Constructor
+	 */
+	SpecializedDepthBuffer(unsigned int newWidth = WINDOW_WIDTH, unsigned int newHeight = WINDOW_HEIGHT) :
+		DepthBuffer(newWidth, newHeight), storage(newWidth, newHeight), rowUsageVec(newHeight, RowUsage())
+	{
+		rowFragmentBudget = std::numeric_limits<unsigned int>::max();
+		peakFragmentCount = 0;
+
+		//The lists' first fragments are allocated by the workers that own their rows, too.
+		ForEachRowBand([this](int firstRow, int lastRow)
+		{
+			Fragment backgroundDepthInfo(Z_FAR, Color4(0.0f, 0.0f, 0.0f, 1.0f));
+			for (unsigned int bufferIndex = firstRow * width; bufferIndex < lastRow * width; bufferIndex++)
+			{
+				storage.GetFragmentList(bufferIndex).push_back(backgroundDepthInfo);
+				storage.GetBlendedList(bufferIndex).push_back(backgroundDepthInfo.color);
+			}
+		}, height);
+	}
+
+	/*
+	 * Accessors
+	 */
+	const char *GetName() const
+	{
+		return BlendPolicy::GetName();
+	}
+	const char *GetStorageName() const
+	{
+		return StoragePolicy<DepthType>::GetName();
+	}
+	int GetDepthBits() const
+	{
+		return sizeof(DepthType) * 8;
+	}
+
+	void ReportMemory() const
+	{
+		storage.ReportMemory();
+	}
+	size_t GetFragmentBytes() const
+	{
+		return storage.GetBytes();
+	}
+
+	//The fragments in front of the background, counted as they're inserted and removed
+	size_t GetFragmentCount() const
+	{
+		size_t fragmentCount = 0;
+		for (unsigned int y = 0; y < height; y++)
+			fragmentCount += rowUsageVec[y].fragmentCount;
+		return fragmentCount;
+	}
+
+	//The section is where each pixel's list starts, then every pixel's fragments and then their blended colors, in pixel order.
+	void AppendCheckpoint(std::vector<char> &data) const
+	{
+		std::vector<unsigned int> fragmentStartVec(1, 0);
+		for (unsigned int bufferIndex = 0; bufferIndex < width * height; bufferIndex++)
+			fragmentStartVec.push_back(fragmentStartVec.back() + storage.GetFragmentList(bufferIndex).size());
+		AppendCheckpointArray(data, &fragmentStartVec[0], fragmentStartVec.size());
+
+		std::vector<CheckpointFragment> fragmentVec;
+		std::vector<PackedColor> blendedVec;
+		fragmentVec.reserve(fragmentStartVec.back());
+		blendedVec.reserve(fragmentStartVec.back());
+		for (unsigned int bufferIndex = 0; bufferIndex < width * height; bufferIndex++)
+		{
+			const FragmentList &zList = storage.GetFragmentList(bufferIndex);
+			const BlendedList &aList = storage.GetBlendedList(bufferIndex);
+			for (unsigned int i = 0; i < zList.size(); i++)
+				fragmentVec.push_back(GetCheckpointFragment(zList[i]));
+			blendedVec.insert(blendedVec.end(), aList.begin(), aList.end());
+		}
+		AppendCheckpointArray(data, fragmentVec.empty() ? NULL : &fragmentVec[0], fragmentVec.size());
+		AppendCheckpointArray(data, blendedVec.empty() ? NULL : &blendedVec[0], blendedVec.size());
+	}
+
+	Color3 GetVisibleColor3(int x, int y) const
+	{
+		const BlendedList &aList = storage.GetBlendedList(x + y * width);
+		return aList[aList.size() - 1].GetColor3();
+	}
+
+	/*
+	 * The pixel that should be drawn at a given location is given by the greatest-indexed
+	 * aBuffer color. The rows are shared out among the worker pool in bands. Rows that aren't
+	 * rendered (see IsRenderedRow()) repeat the row above them. The peak usage is sampled here,
+	 * once a frame.
+	 */
+	void Resolve() const
+	{
+		ForEachRowBand([this](int firstRow, int lastRow)
+		{
+			for (int y = firstRow; y < lastRow; y++)
+			{
+				if (y != firstRow && !IsRenderedRow(y))
+				{
+					CopyPixelRow(y - 1, y);
+					continue;
+				}
+				for (int x = 0; x < (int)width; x++)
+					SetPixel(x, y, GetVisibleColor3(x, GetRenderedRow(y)));
+			}
+		}, height);
+		peakFragmentCount = std::max(peakFragmentCount, GetFragmentCount());
+	}
+
+	/*
+	 * Every rendered pixel was already drawn when its list last changed, so only the rows that
+	 * aren't rendered are filled in, each from the rendered row it repeats. Those rows are never
+	 * read here, so the bands don't have to be copied in order.
+	 */
+	void ResolveFrame() const
+	{
+		if (GetRowStep() > 1)
+		{
+			ForEachRowBand([this](int firstRow, int lastRow)
+			{
+				for (int y = firstRow; y < lastRow; y++)
+					if (!IsRenderedRow(y))
+						CopyPixelRow(GetRenderedRow(y), y);
+			}, height);
+		}
+		peakFragmentCount = std::max(peakFragmentCount, GetFragmentCount());
+	}
+
+	/*
+	 * Mutators
+	 */
+	/*
+	 * The lists are refilled band by band by the workers that own the rows, the same as they're
+	 * first allocated. Every pixel's list has to start with its background and be in depth
+	 * order, as InsertFragment() keeps it, and every row has to be within its share of the
+	 * fragment budget.
+	 */
+	bool RestoreCheckpoint(const char *data, size_t bytes)
+	{
+		const unsigned int *fragmentStartArr;
+		const CheckpointFragment *fragmentArr;
+		const PackedColor *blendedArr;
+		if (!ReadCheckpointArray(data, bytes, fragmentStartArr, width * height + 1))
+			return false;
+		unsigned int fragmentCount = fragmentStartArr[width * height];
+		if (fragmentStartArr[0] != 0 || !ReadCheckpointArray(data, bytes, fragmentArr, fragmentCount) ||
+			!ReadCheckpointArray(data, bytes, blendedArr, fragmentCount))
+			return false;
+		for (unsigned int bufferIndex = 0; bufferIndex < width * height; bufferIndex++)
+			if (fragmentStartArr[bufferIndex + 1] <= fragmentStartArr[bufferIndex] || fragmentStartArr[bufferIndex + 1] > fragmentCount)
+				return false; //Every pixel has at least the background
+		for (unsigned int y = 0; y < height; y++)
+			if (fragmentStartArr[(y + 1) * width] - fragmentStartArr[y * width] - width > rowFragmentBudget)
+				return false;
+		for (unsigned int bufferIndex = 0; bufferIndex < width * height; bufferIndex++)
+		{
+			//The background only takes a primitive's id once the budget has merged fragments into it, see MergeFarthestFragments().
+			const CheckpointFragment &background = fragmentArr[fragmentStartArr[bufferIndex]];
+			if (background.depth != Fragment::PackDepth(Z_FAR) ||
+				(background.primitiveId != BACKGROUND_PRIMITIVE_ID && fragmentBudget == 0))
+				return false;
+			for (unsigned int fragment = fragmentStartArr[bufferIndex]; fragment < fragmentStartArr[bufferIndex + 1]; fragment++)
+				if (fragmentArr[fragment].depth != Fragment::PackDepth(fragmentArr[fragment].depth) || fragmentArr[fragment].coverage > FULL_COVERAGE ||
+					(fragment != fragmentStartArr[bufferIndex] && fragmentArr[fragment].depth < fragmentArr[fragment - 1].depth))
+					return false;
+		}
+
+		ForEachRowBand([this, fragmentStartArr, fragmentArr, blendedArr](int firstRow, int lastRow)
+		{
+			for (unsigned int bufferIndex = firstRow * width; bufferIndex < lastRow * width; bufferIndex++)
+			{
+				unsigned int start = fragmentStartArr[bufferIndex], end = fragmentStartArr[bufferIndex + 1];
+				FragmentList &zList = storage.GetFragmentList(bufferIndex);
+				zList.clear();
+				for (unsigned int fragment = start; fragment < end; fragment++)
+					zList.push_back(GetFragment(fragmentArr[fragment]));
+				storage.GetBlendedList(bufferIndex).assign(blendedArr + start, blendedArr + end);
+			}
+			for (int y = firstRow; y < lastRow; y++)
+				rowUsageVec[y].fragmentCount = fragmentStartArr[(y + 1) * width] - fragmentStartArr[y * width] - width;
+		}, height);
+		return true;
+	}
+
+	//The budget is split evenly among the rows, so that each row's worker keeps to its share without locking.
+	void SetFragmentBudget(size_t bytes)
+	{
+		DepthBuffer::SetFragmentBudget(bytes);
+		rowFragmentBudget = (bytes == 0) ? std::numeric_limits<unsigned int>::max() : (unsigned int)(bytes / FRAGMENT_BYTES / height);
+	}
+
+	void Clear()
+	{
+		ForEachRowBand([this](int firstRow, int lastRow)
+		{
+			Fragment backgroundDepthInfo(Z_FAR, Color4(0.0f, 0.0f, 0.0f, 1.0f));
+			for (int y = firstRow; y < lastRow; y++)
+			{
+				for (int x = 0; x < (int)width; x++)
+				{
+					storage.GetFragmentList(x + y * width).assign(1, backgroundDepthInfo);
+					storage.GetBlendedList(x + y * width).assign(1, backgroundDepthInfo.color);
+					SetPixel(x, y, backgroundDepthInfo.color.GetColor3());
+				}
+				rowUsageVec[y].fragmentCount = 0;
+			}
+		}, height);
+	}
+
+	void InsertSpan(int worldY, int startX, int endX, const int *worldZArr, const unsigned short *coverageArr,
+		const Color4 &color, unsigned int primitiveId)
+	{
+		for (int worldX = startX; worldX < endX; worldX++)
+			if (coverageArr[worldX - startX] != 0)
+				UpdateBuffers(worldX, worldY, worldZArr[worldX - startX], color, primitiveId, coverageArr[worldX - startX]);
+	}
+
+	void RemoveSpan(int worldY, int startX, int endX, const int *worldZArr, unsigned int primitiveId)
+	{
+		for (int worldX = startX; worldX < endX; worldX++)
+			RemoveFragment(worldX, worldY, worldZArr[worldX - startX], primitiveId);
+	}
+
+	void MoveSpan(int worldY, int startX, int endX, const int *oldWorldZArr, const int *newWorldZArr,
+		const unsigned short *oldCoverageArr, const unsigned short *newCoverageArr, const Color4 &color, unsigned int primitiveId)
+	{
+		for (int worldX = startX; worldX < endX; worldX++)
+			MoveFragment(worldX, worldY, oldWorldZArr[worldX - startX], newWorldZArr[worldX - startX],
+				oldCoverageArr[worldX - startX], newCoverageArr[worldX - startX], color, primitiveId);
+	}
+
+	void ResolveFragmentSpan(FragmentStore &fragmentStore, int worldY, int startX, int endX);
+
+	/*
+	 * The caller is responsible for clipping (worldX, worldY) to the viewport beforehand. With a
+	 * budget, lists that have shrunk to a quarter of their capacity are trimmed, so that pixels
+	 * that were crowded once don't hold on to the memory.
+	 */
+	void RemoveFragment(int worldX, int worldY, int worldZ, unsigned int primitiveId)
+	{
+		unsigned int bufferIndex = worldX + worldY * width;
+		FragmentList &zList = storage.GetFragmentList(bufferIndex);
+		BlendedList &aList = storage.GetBlendedList(bufferIndex);
+		unsigned int bufferSize = zList.size();
+		DepthType packedZ = Fragment::PackDepth(worldZ);
+		for (unsigned int zDepth = 0; zDepth < bufferSize; zDepth++)
+		{
+			if (zList[zDepth].depth == packedZ && zList[zDepth].primitiveId == primitiveId)
+			{
+				zList.erase(zList.begin() + zDepth);
+				aList.erase(aList.begin() + zDepth);
+				rowUsageVec[worldY].fragmentCount--;
+				if (fragmentBudget != 0 && zList.capacity() >= MIN_TRIMMED_CAPACITY && zList.capacity() >= 4 * zList.size())
+				{
+					zList.shrink_to_fit();
+					aList.shrink_to_fit();
+				}
+				BlendABuffer(worldX, worldY, zDepth); //Everything in front of the removed fragment was blended with it
+				Color3 drawColor = aList[aList.size() - 1].GetColor3();
+				SetPixel(worldX, worldY, drawColor);
+				return;
+			}
+		}
+
+		//The fragment was merged into the background (see MergeFarthestFragments()), which goes back to black without it.
+		if (zList[0].primitiveId == primitiveId)
+		{
+			zList[0] = Fragment(Z_FAR, Color4(0.0f, 0.0f, 0.0f, 1.0f));
+			aList[0] = zList[0].color;
+			BlendABuffer(worldX, worldY);
+			SetPixel(worldX, worldY, aList[aList.size() - 1].GetColor3());
+		}
+	}
+
+	//Moves a primitive's fragment at (worldX, worldY) from oldWorldZ to newWorldZ, and updates its coverage, in place.
+	void MoveFragment(int worldX, int worldY, int oldWorldZ, int newWorldZ, unsigned short oldCoverage, unsigned short newCoverage,
+		const Color4 &color, unsigned int primitiveId)
+	{
+		if (oldWorldZ == newWorldZ && oldCoverage == newCoverage)
+			return;
+		if (oldWorldZ != newWorldZ || newCoverage == 0)
+			RemoveFragment(worldX, worldY, oldWorldZ, primitiveId);
+		if (newCoverage != 0)
+			UpdateBuffers(worldX, worldY, newWorldZ, color, primitiveId, newCoverage);
+	}
+
+	//The caller is responsible for clipping (worldX, worldY) to the viewport beforehand.
+	void UpdateBuffers(int worldX, int worldY, int worldZ, const Color4 &newColor, unsigned int primitiveId,
+		unsigned short coverage = FULL_COVERAGE)
+	{
+		unsigned int bufferIndex = worldX + worldY * width;
+		unsigned int i = InsertFragment(bufferIndex, worldZ, PackedColor(newColor), primitiveId, coverage);
+
+		//if (newColor.GetA() != 1.0f)
+		BlendABuffer(worldX, worldY, i);
+		MergeFarthestFragments(worldX, worldY);
+		const BlendedList &aList = storage.GetBlendedList(bufferIndex);
+		SetPixel(worldX, worldY, aList[aList.size() - 1].GetColor3());
+	}
+	//void UpdateBuffers(const Triangle &triangle)
+	//{
+	//	unsigned int worldX;
+	//	unsigned int worldY;
+	//	int worldZ;
+	//	unsigned int bufferIndex;
+	//	unsigned int bufferSize;
+	//	unsigned int i = 0;
+	//	for (unsigned int pixel = 0; pixel < triangle.pixelInfoVec.size(); pixel++)
+	//	{
+	//		worldX = triangle.pixelInfoVec[pixel].GetX();
+	//		worldY = triangle.pixelInfoVec[pixel].GetY();
+	//		worldZ = triangle.pixelInfoVec[pixel].GetZ();
+	//		bufferIndex = worldX + worldY * WINDOW_WIDTH;
+	//		bufferSize = zBuffer[bufferIndex].size();
+	//		
+	//		for (i = 0; i < bufferSize; i++)
+	//		{
+	//			if (zBuffer[bufferIndex][i].depth == worldZ)
+	//			{
+	//				zBuffer[bufferIndex][i].color = triangle.color;
+	//				aBuffer[bufferIndex][i].color = triangle.color;
+	//				break;
+	//			}
+	//			else if (worldZ < zBuffer[bufferIndex][i].depth)
+	//			{
+	//				zBuffer[bufferIndex].insert(zBuffer[bufferIndex].begin() + i, DepthInfo(worldZ, triangle.color));
+	//				aBuffer[bufferIndex].insert(aBuffer[bufferIndex].begin() + i, DepthInfo(worldZ, triangle.color));
+	//				break;
+	//			}
+	//		}
+	//		if (i == bufferSize)
+	//		{
+	//			zBuffer[bufferIndex].push_back(DepthInfo(worldZ, triangle.color));
+	//			aBuffer[bufferIndex].push_back(DepthInfo(worldZ, triangle.color));
+	//		}
+
+	//		//if (newColor.GetA() != 1.0f)
+	//		BlendABuffer(worldX, worldY);
+	//		Color3 drawColor = aBuffer[bufferIndex][aBuffer[bufferIndex].size() - 1].color.GetColor3();
+	//		SetPixel(worldX, worldY, drawColor);
+	//	}
+	//}
+private:
+	template <class DepthBufferType>
+	friend void BenchmarkFragmentLists(DepthBufferType &kernelBuffer); //Times BlendABuffer() directly
+
+	static CheckpointFragment GetCheckpointFragment(const Fragment &fragment)
+	{
+		CheckpointFragment record = CheckpointFragment();
+		record.depth = fragment.depth;
+		record.color = fragment.color;
+		record.primitiveId = fragment.primitiveId;
+		record.coverage = fragment.coverage;
+		return record;
+	}
+	static Fragment GetFragment(const CheckpointFragment &record)
+	{
+		return Fragment(record.depth, record.color, record.primitiveId, (unsigned short)record.coverage);
+	}
+
+	/*
+	 * Inserts a fragment into the depth-sorted lists of pixel bufferIndex, after any fragments
+	 * at the same depth, or replaces the primitive's fragment if it's already there at this
+	 * depth. Returns the index it ended up at, which is the first one that needs re-blending.
+	 */
+	unsigned int InsertFragment(unsigned int bufferIndex, int worldZ, const PackedColor &newColor, unsigned int primitiveId,
+		unsigned short coverage)
+	{
+		FragmentList &zList = storage.GetFragmentList(bufferIndex);
+		BlendedList &aList = storage.GetBlendedList(bufferIndex);
+		RowUsage &rowUsage = rowUsageVec[bufferIndex / width];
+		unsigned int bufferSize = zList.size();
+		DepthType packedZ = Fragment::PackDepth(worldZ);
+		unsigned int i = 0;
+		for (i = 0; i < bufferSize; i++)
+		{
+			if (zList[i].depth == packedZ && zList[i].primitiveId == primitiveId)
+			{
+				zList[i].color = newColor;
+				aList[i] = newColor;
+				zList[i].coverage = coverage;
+				break;
+			}
+			else if (packedZ < zList[i].depth)
+			{
+				zList.insert(zList.begin() + i, Fragment(packedZ, newColor, primitiveId, coverage));
+				aList.insert(aList.begin() + i, newColor);
+				rowUsage.fragmentCount++;
+				break;
+			}
+		}
+		if (i == bufferSize)
+		{
+			zList.push_back(Fragment(packedZ, newColor, primitiveId, coverage));
+			aList.push_back(newColor);
+			rowUsage.fragmentCount++;
+		}
+		return i;
+	}
+
+	/*
+	 * Merges pixel (x, y)'s farthest fragments into its background while its row holds more
+	 * than its share of the budget. The background takes the farthest fragment's blended color,
+	 * which is what everything in front of it was blended with, so the pixel looks the same, but
+	 * the merged fragments can't be moved or removed on their own any more. The background keeps
+	 * the primitiveId of the last fragment merged into it, so that removing that primitive
+	 * clears the background rather than leaving a trail.
+	 */
+	void MergeFarthestFragments(int x, int y)
+	{
+		RowUsage &rowUsage = rowUsageVec[y];
+		FragmentList &zList = storage.GetFragmentList(x + y * width);
+		BlendedList &aList = storage.GetBlendedList(x + y * width);
+		while (rowUsage.fragmentCount > rowFragmentBudget && zList.size() > 1)
+		{
+			aList[0].Set(aList[1].GetColor4V().GetOpaque());
+			zList[0].color = aList[0];
+			zList[0].primitiveId = zList[1].primitiveId;
+			zList.erase(zList.begin() + 1);
+			aList.erase(aList.begin() + 1);
+			rowUsage.fragmentCount--;
+			rowUsage.mergedCount++;
+		}
+	}
+
+	/*
+	 * Recomputes the blended aBuffer colors of pixel (x, y) from the unmodified zBuffer colors,
+	 * starting at firstChangedIndex. Fragments behind firstChangedIndex are unaffected by a
+	 * change at that index, so they keep their blended colors. Since nothing is blended with
+	 * an already-blended color, re-blending a pixel that hasn't changed is a no-op, which lets
+	 * static primitives stay resident across frames.
+	 */
+	void BlendABuffer(int x, int y, unsigned int firstChangedIndex = 1)
+	{
+		int bufferIndex = x + y * width;
+		const FragmentList &zList = storage.GetFragmentList(bufferIndex);
+		BlendedList &aList = storage.GetBlendedList(bufferIndex);
+
+		//Partially covered fragments have to be composited subpixel by subpixel, from the background up.
+		if (antiAliasing)
+		{
+			for (unsigned int i = 1; i < zList.size(); i++)
+			{
+				if (zList[i].coverage != FULL_COVERAGE)
+				{
+					BlendABufferSubpixels(bufferIndex);
+					return;
+				}
+			}
+		}
+
+		//Assume the background color is always completely opaque.
+		firstChangedIndex = (firstChangedIndex < 1) ? 1 : firstChangedIndex;
+		unsigned int endIndex = aList.size();
+		if (!BlendPolicy::DEPENDS_ON_BEHIND)
+			endIndex = (firstChangedIndex + 1 < endIndex) ? firstChangedIndex + 1 : endIndex; //Only the changed fragment's color changes
+		Color4V prevColor = aList[firstChangedIndex - 1].GetColor4V();
+
+		for (unsigned int i = firstChangedIndex; i < endIndex; i++)
+		{
+			const PackedColor &color = zList[i].color;
+
+			//If the current pixel hides the color behind it, then move onto the next color.
+			if (BlendPolicy::HidesBehind(color))
+			{
+				aList[i] = color;
+				prevColor = color.GetColor4V();
+				continue;
+			}
+
+			//Blend the current pixel color with the pixel color behind it. The next one is blended
+			//with the stored (packed) result, the same as when re-blending starts from here.
+			prevColor = aList[i].Set(BlendPolicy::Blend(color, prevColor));
+		}
+	}
+
+	/*
+	 * Carpenter's A-buffer resolve: every subpixel keeps its own color, which each fragment
+	 * covering that subpixel is blended onto (with the same rule as BlendABuffer()). A
+	 * fragment's blended aBuffer color is the average of all the subpixels once it's applied.
+	 * With full coverage everywhere this gives exactly the same colors as BlendABuffer().
+	 */
+	void BlendABufferSubpixels(int bufferIndex)
+	{
+		const FragmentList &zList = storage.GetFragmentList(bufferIndex);
+		BlendedList &aList = storage.GetBlendedList(bufferIndex);
+		Color4V subpixelColorArr[COVERAGE_SUBPIXELS];
+		for (int subpixel = 0; subpixel < COVERAGE_SUBPIXELS; subpixel++)
+			subpixelColorArr[subpixel] = aList[0].GetColor4V();
+
+		for (unsigned int i = 1; i < zList.size(); i++)
+		{
+			const PackedColor &color = zList[i].color;
+			unsigned short coverage = zList[i].coverage;
+			bool hidesBehind = BlendPolicy::HidesBehind(color);
+			Color4V colorV = color.GetColor4V();
+			Color4V sum(0.0f, 0.0f, 0.0f, 0.0f);
+			PackedColor roundedColor;
+			for (int subpixel = 0; subpixel < COVERAGE_SUBPIXELS; subpixel++)
+			{
+				//Each blend is rounded like BlendABuffer()'s are, so fully covered pixels come out the same either way.
+				Color4V &subpixelColor = subpixelColorArr[subpixel];
+				if (coverage & (1 << subpixel))
+					subpixelColor = hidesBehind ? colorV : roundedColor.Set(BlendPolicy::Blend(color, subpixelColor));
+				sum = sum + subpixelColor;
+			}
+			aList[i].Set((sum * (1.0f / COVERAGE_SUBPIXELS)).GetOpaque());
+		}
+	}
+
+	void AddFragmentUsage(FragmentUsage &usage, std::map<unsigned int, size_t> &primitiveBytesMap) const
+	{
+		usage.currentBytes = GetFragmentCount() * FRAGMENT_BYTES;
+		usage.peakBytes = std::max(peakFragmentCount * FRAGMENT_BYTES, usage.currentBytes);
+		for (unsigned int y = 0; y < height; y++)
+		{
+			usage.mergedCount += rowUsageVec[y].mergedCount;
+			for (unsigned int x = 0; x < width; x++)
+			{
+				const FragmentList &zList = storage.GetFragmentList(x + y * width);
+				for (unsigned int i = 1; i < zList.size(); i++)
+				{
+					usage.regionBytesVec[GetRegion(x, y)] += FRAGMENT_BYTES;
+					primitiveBytesMap[zList[i].primitiveId] += FRAGMENT_BYTES;
+				}
+			}
+		}
+	}
+
+private:
+	static const unsigned int FRAGMENT_BYTES = sizeof(Fragment) + sizeof(PackedColor); //In both lists
+	static const unsigned int MIN_TRIMMED_CAPACITY = 16; //Lists with less capacity aren't worth trimming
+
+	class RowUsage
+	{
+	public:
+		unsigned int fragmentCount; //In front of the background
+		unsigned long long mergedCount; //Since the buffer was created
+	};
+
+	StoragePolicy<DepthType> storage;
+	std::vector<RowUsage> rowUsageVec; //Only touched by the worker that owns the row, like the row's pixels
+	unsigned int rowFragmentBudget; //The fragments each row can hold in front of the background
+	mutable size_t peakFragmentCount;
+};
+
+
+/*
+ * A uniform grid of GRID_CELL_SIZE*GRID_CELL_SIZE cells over the window, indexing primitives
+ * (by primitiveId) by their world-space bounding boxes. Overlap and pick queries only look at
+ * the cells the query touches, instead of at every primitive in the scene. Moving a primitive
+ * within the same cells only updates its bounding box. Bounding boxes that are partly or
+ * entirely offscreen are kept in the border cells.
+ */
+class SpatialGrid
+{
+public:
+	/*
+	 * Constructor
+	 */
+	SpatialGrid()
+	{
+		columnCount = (WINDOW_WIDTH + GRID_CELL_SIZE - 1) / GRID_CELL_SIZE;
+		rowCount = (WINDOW_HEIGHT + GRID_CELL_SIZE - 1) / GRID_CELL_SIZE;
+		cellVec.resize(columnCount * rowCount);
+		queryStamp = 0;
+	}
+
+	/*
+	 * Accessors
+	 */
+	unsigned int GetSize() const
+	{
+		return entryMap.size();
+	}
+
+	//Appends the id of every primitive whose bounding box overlaps [minCorner, maxCorner] to idVec.
+	void QueryOverlaps(const Vector2F &minCorner, const Vector2F &maxCorner, std::vector<unsigned int> &idVec)
+	{
+		int firstColumn, firstRow, lastColumn, lastRow;
+		GetCellRange(minCorner, maxCorner, firstColumn, firstRow, lastColumn, lastRow);
+
+		//A primitive spanning several cells is only reported once per query.
+		queryStamp++;
+		for (int row = firstRow; row <= lastRow; row++)
+		{
+			for (int column = firstColumn; column <= lastColumn; column++)
+			{
+				const std::vector<unsigned int> &cell = cellVec[column + row * columnCount];
+				for (unsigned int i = 0; i < cell.size(); i++)
+				{
+					//Every id in a cell should have an entry, but one that doesn't is skipped rather than added.
+					std::map<unsigned int, Entry>::iterator it = entryMap.find(cell[i]);
+					if (it == entryMap.end())
+						continue;
+					Entry &entry = it->second;
+					if (entry.queryStamp == queryStamp)
+						continue;
+					entry.queryStamp = queryStamp;
+					if (entry.minCorner.GetX() <= maxCorner.GetX() && minCorner.GetX() <= entry.maxCorner.GetX() &&
+						entry.minCorner.GetY() <= maxCorner.GetY() && minCorner.GetY() <= entry.maxCorner.GetY())
+						idVec.push_back(cell[i]);
+				}
+			}
+		}
+	}
+
+	//Appends the id of every primitive whose bounding box contains (x, y) to idVec.
+	void Pick(float x, float y, std::vector<unsigned int> &idVec)
+	{
+		QueryOverlaps(Vector2F(x, y), Vector2F(x, y), idVec);
+	}
+
+	/*
+	 * Mutators
+	 */
+	//Inserts the primitive with the given id, or moves it if it's already in the grid.
+	void Update(unsigned int id, const Vector2F &minCorner, const Vector2F &maxCorner)
+	{
+		int firstColumn, firstRow, lastColumn, lastRow;
+		GetCellRange(minCorner, maxCorner, firstColumn, firstRow, lastColumn, lastRow);
+
+		std::map<unsigned int, Entry>::iterator it = entryMap.find(id);
+		if (it == entryMap.end())
+		{
+			it = entryMap.insert(std::make_pair(id, Entry())).first;
+			AddToCells(id, firstColumn, firstRow, lastColumn, lastRow);
+		}
+		else if (it->second.firstColumn != firstColumn || it->second.firstRow != firstRow ||
+			it->second.lastColumn != lastColumn || it->second.lastRow != lastRow)
+		{
+			RemoveFromCells(id, it->second.firstColumn, it->second.firstRow, it->second.lastColumn, it->second.lastRow);
+			AddToCells(id, firstColumn, firstRow, lastColumn, lastRow);
+		}
+
+		Entry &entry = it->second;
+		entry.minCorner = minCorner;
+		entry.maxCorner = maxCorner;
+		entry.firstColumn = firstColumn;
+		entry.firstRow = firstRow;
+		entry.lastColumn = lastColumn;
+		entry.lastRow = lastRow;
+	}
+
+	void Remove(unsigned int id)
+	{
+		std::map<unsigned int, Entry>::iterator it = entryMap.find(id);
+		if (it == entryMap.end())
+			return;
+		RemoveFromCells(id, it->second.firstColumn, it->second.firstRow, it->second.lastColumn, it->second.lastRow);
+		entryMap.erase(it);
+	}
+
+private:
+	void GetCellRange(const Vector2F &minCorner, const Vector2F &maxCorner,
+		int &firstColumn, int &firstRow, int &lastColumn, int &lastRow) const
+	{
+		firstColumn = ClampCell((int)floor(minCorner.GetX()) / (int)GRID_CELL_SIZE, columnCount);
+		firstRow = ClampCell((int)floor(minCorner.GetY()) / (int)GRID_CELL_SIZE, rowCount);
+		lastColumn = ClampCell((int)floor(maxCorner.GetX()) / (int)GRID_CELL_SIZE, columnCount);
+		lastRow = ClampCell((int)floor(maxCorner.GetY()) / (int)GRID_CELL_SIZE, rowCount);
+	}
+
+	static int ClampCell(int cell, int cellCount)
+	{
+		cell = (cell < 0) ? 0 : cell;
+		return (cell >= cellCount) ? cellCount - 1 : cell;
+	}
+
+	void AddToCells(unsigned int id, int firstColumn, int firstRow, int lastColumn, int lastRow)
+	{
+		for (int row = firstRow; row <= lastRow; row++)
+			for (int column = firstColumn; column <= lastColumn; column++)
+				cellVec[column + row * columnCount].push_back(id);
+	}
+
+	void RemoveFromCells(unsigned int id, int firstColumn, int firstRow, int lastColumn, int lastRow)
+	{
+		for (int row = firstRow; row <= lastRow; row++)
+		{
+			for (int column = firstColumn; column <= lastColumn; column++)
+			{
+				//Order within a cell doesn't matter, so swap the id with the last one and pop it.
+				std::vector<unsigned int> &cell = cellVec[column + row * columnCount];
+				for (unsigned int i = 0; i < cell.size(); i++)
+				{
+					if (cell[i] == id)
+					{
+						cell[i] = cell[cell.size() - 1];
+						cell.pop_back();
+						break;
+					}
+				}
+			}
+		}
+	}
+
+private:
+	class Entry
+	{
+	public:
+		Entry()
+		{
+			firstColumn = firstRow = lastColumn = lastRow = 0;
+			queryStamp = 0;
+		}
+	public:
+		Vector2F minCorner;
+		Vector2F maxCorner;
+		int firstColumn;
+		int firstRow;
+		int lastColumn;
+		int lastRow;
+		unsigned int queryStamp; //The last query that visited this entry
+	};
+	int columnCount;
+	int rowCount;
+	std::vector<std::vector<unsigned int> > cellVec; //The ids of the primitives overlapping each cell
+	std::map<unsigned int, Entry> entryMap;
+	unsigned int queryStamp;
+};
+
+
+/*
+ * A fixed set of worker threads that run the same job together. The thread calling Run() takes
+ * part as worker 0, and Run() returns once every worker has finished the job, so anything the
+ * job wrote is visible to the caller afterwards. Jobs split their work among the workers
+ * themselves, by workerIndex or through an atomic counter.
+ */
+class WorkerPool
+{
+public:
+	/*
+	 * Constructors
+	 */
+	WorkerPool()
+	{
+		job = NULL;
+		generation = 0;
+		busyWorkers = 0;
+		stopping = false;
+	}
+	~WorkerPool()
+	{
+		Stop();
+	}
+
+	/*
+	 * Accessors
+	 */
+	unsigned int GetWorkerCount() const
+	{
+		return threadVec.size() + 1;
+	}
+
+	/*
+	 * Mutators
+	 */
+	/*
+	 * Starts newWorkerCount - 1 threads, replacing any that were already running, and waits
+	 * until each has seeded its random stream (from randomSeed, as it is now).
+	 */
+	void Start(unsigned int newWorkerCount)
+	{
+		newWorkerCount = (newWorkerCount < 1) ? 1 : newWorkerCount;
+		if (newWorkerCount == GetWorkerCount())
+			return;
+		Stop();
+		stopping = false;
+		busyWorkers = newWorkerCount - 1;
+		for (unsigned int workerIndex = 1; workerIndex < newWorkerCount; workerIndex++)
+			threadVec.push_back(std::thread(&WorkerPool::WorkerLoop, this, workerIndex, generation));
+
+		std::unique_lock<std::mutex> lock(mutex);
+		doneCondition.wait(lock, [this] { return busyWorkers == 0; });
+	}
+
+	void Stop()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = true;
+		}
+		wakeCondition.notify_all();
+		for (unsigned int thread = 0; thread < threadVec.size(); thread++)
+			threadVec[thread].join();
+		threadVec.clear();
+	}
+
+	/*
+	 * Runs newJob(workerIndex) on every worker, and waits for all of them to finish. A job that
+	 * runs another (a scene of RunScenes(), rasterizing) runs it alone, as worker 0, since the
+	 * rest of the pool is busy with the outer job.
+	 */
+	void Run(const std::function<void(unsigned int)> &newJob)
+	{
+		if (threadVec.empty() || runningJob)
+		{
+			newJob(0);
+			return;
+		}
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			job = &newJob;
+			busyWorkers = threadVec.size();
+			generation++;
+		}
+		wakeCondition.notify_all();
+		runningJob = true;
+		newJob(0);
+		runningJob = false;
+
+		std::unique_lock<std::mutex> lock(mutex);
+		doneCondition.wait(lock, [this] { return busyWorkers == 0; });
+		job = NULL;
+	}
+
+private:
+	void WorkerLoop(unsigned int workerIndex, unsigned long long seenGeneration)
+	{
+		runningJob = true; //A worker only ever runs jobs
+		SeedThreadRandomStream(workerIndex);
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if (--busyWorkers == 0)
+				doneCondition.notify_one();
+		}
+
+		while (true)
+		{
+			const std::function<void(unsigned int)> *currentJob;
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				wakeCondition.wait(lock, [&] { return stopping || generation != seenGeneration; });
+				if (stopping)
+					return;
+				seenGeneration = generation;
+				currentJob = job;
+			}
+
+			(*currentJob)(workerIndex);
+
+			std::lock_guard<std::mutex> lock(mutex);
+			if (--busyWorkers == 0)
+				doneCondition.notify_one();
+		}
+	}
+
+private:
+	std::vector<std::thread> threadVec;
+	std::mutex mutex;
+	std::condition_variable wakeCondition;
+	std::condition_variable doneCondition;
+	const std::function<void(unsigned int)> *job;
+	unsigned long long generation; //Bumped for every job, so each worker runs it exactly once
+	unsigned int busyWorkers;
+	bool stopping;
+	static thread_local bool runningJob; //Whether the calling thread is in the middle of a job
+};
+
+thread_local bool WorkerPool::runningJob = false;
+
+
+/*
+ * A concurrent fragment store for sort-last rasterization. Every pixel has an atomic head
+ * index into a shared pool of fragments, and each pixel's fragments form a singly-linked list
+ * through that pool. Any number of threads can append fragments at once without locking:
+ * a slot in the pool is claimed with one atomic increment, then pushed onto the front of its
+ * pixel's list with a compare-and-swap. Nothing is sorted until the lists are resolved into
+ * the depth buffer, see DepthBuffer::ResolveFragmentSpan() and ResolveSortLastSpans().
+ */
+class FragmentStore
+{
+public:
+	static const unsigned int NO_FRAGMENT = 0xFFFFFFFF;
+
+	class Fragment
+	{
+	public:
+		int depth;
+		PackedColor color;
+		unsigned int primitiveId;
+		unsigned short coverage;
+		unsigned int next; //The index of the next fragment on the same pixel, or NO_FRAGMENT
+	};
+
+	/*
+	 * Constructor
+	 */
+	FragmentStore()
+	{
+		headArr = NULL;
+		fragmentArr = NULL;
+		fragmentCapacity = 0;
+		fragmentCount.store(0, std::memory_order_relaxed);
+	}
+	~FragmentStore()
+	{
+		FreeLargeBuffer(headArr, WINDOW_WIDTH * WINDOW_HEIGHT * sizeof(std::atomic<unsigned int>));
+		FreeLargeBuffer(fragmentArr, fragmentCapacity * sizeof(Fragment));
+	}
+
+	/*
+	 * Accessors
+	 */
+	const Fragment &GetFragment(unsigned int fragment) const
+	{
+		return fragmentArr[fragment];
+	}
+
+	//Reports how the list heads and the pool are backed and placed (see ReportLargeBuffer()).
+	void ReportMemory() const
+	{
+		if (headArr != NULL)
+			ReportLargeBuffer("fragment list heads", headArr, WINDOW_WIDTH * WINDOW_HEIGHT * sizeof(std::atomic<unsigned int>), WINDOW_HEIGHT);
+		if (fragmentArr != NULL)
+			ReportLargeBuffer("fragment pool", fragmentArr, fragmentCapacity * sizeof(Fragment), 0);
+	}
+
+	/*
+	 * Mutators
+	 */
+	/*
+	 * Empties the pool, and makes room for at least capacity fragments. Must not be called while
+	 * fragments are being appended, and every list must have been taken beforehand. The list
+	 * heads are allocated the first time, band by band by the workers that own the rows, and the
+	 * pool at least doubles whenever it grows.
+	 */
+	void Reset(unsigned int capacity)
+	{
+		if (headArr == NULL)
+		{
+			headArr = (std::atomic<unsigned int> *)AllocateLargeBuffer(WINDOW_WIDTH * WINDOW_HEIGHT * sizeof(std::atomic<unsigned int>));
+			ForEachRowBand([this](int firstRow, int lastRow)
+			{
+				for (unsigned int bufferIndex = firstRow * WINDOW_WIDTH; bufferIndex < lastRow * WINDOW_WIDTH; bufferIndex++)
+					new (&headArr[bufferIndex]) std::atomic<unsigned int>(NO_FRAGMENT);
+			});
+		}
+		if (fragmentCapacity < capacity)
+		{
+			FreeLargeBuffer(fragmentArr, fragmentCapacity * sizeof(Fragment));
+			fragmentCapacity = (capacity > fragmentCapacity * 2) ? capacity : fragmentCapacity * 2;
+			fragmentArr = (Fragment *)AllocateLargeBuffer(fragmentCapacity * sizeof(Fragment));
+		}
+		fragmentCount.store(0, std::memory_order_relaxed);
+	}
+
+	//Safe to call from any number of threads at once. Returns false if the pool is full.
+	bool Append(int worldX, int worldY, int worldZ, const Color4 &color, unsigned int primitiveId, unsigned short coverage)
+	{
+		unsigned int fragment = fragmentCount.fetch_add(1, std::memory_order_relaxed);
+		if (fragment >= fragmentCapacity)
+			return false;
+		fragmentArr[fragment].depth = worldZ;
+		fragmentArr[fragment].color = color;
+		fragmentArr[fragment].primitiveId = primitiveId;
+		fragmentArr[fragment].coverage = coverage;
+
+		std::atomic<unsigned int> &head = headArr[worldX + worldY * WINDOW_WIDTH];
+		unsigned int next = head.load(std::memory_order_relaxed);
+		do
+			fragmentArr[fragment].next = next;
+		while (!head.compare_exchange_weak(next, fragment, std::memory_order_release, std::memory_order_relaxed));
+		return true;
+	}
+
+	//Detaches and returns the head of pixel (worldX, worldY)'s list, leaving the pixel empty.
+	unsigned int TakeList(int worldX, int worldY)
+	{
+		return headArr[worldX + worldY * WINDOW_WIDTH].exchange(NO_FRAGMENT, std::memory_order_acquire);
+	}
+
+private:
+	std::atomic<unsigned int> *headArr; //One list head per pixel
+	Fragment *fragmentArr; //The pool, a large buffer with room for fragmentCapacity fragments
+	unsigned int fragmentCapacity;
+	std::atomic<unsigned int> fragmentCount;
+};
+
+
+//See the declaration in class DepthBuffer.
+template <template <class> class StoragePolicy, class BlendPolicy, class DepthType>
+void SpecializedDepthBuffer<StoragePolicy, BlendPolicy, DepthType>::ResolveFragmentSpan(FragmentStore &fragmentStore,
+	int worldY, int startX, int endX)
+{
+	std::vector<const FragmentStore::Fragment *> fragmentVec;
+	for (int worldX = startX; worldX < endX; worldX++)
+	{
+		unsigned int fragment = fragmentStore.TakeList(worldX, worldY);
+		if (fragment == FragmentStore::NO_FRAGMENT)
+			continue;
+
+		fragmentVec.clear();
+		for (; fragment != FragmentStore::NO_FRAGMENT; fragment = fragmentStore.GetFragment(fragment).next)
+			fragmentVec.push_back(&fragmentStore.GetFragment(fragment));
+		std::sort(fragmentVec.begin(), fragmentVec.end(), [](const FragmentStore::Fragment *a, const FragmentStore::Fragment *b)
+		{
+			return (a->depth != b->depth) ? a->depth < b->depth : a->primitiveId < b->primitiveId;
+		});
+
+		unsigned int bufferIndex = worldX + worldY * width;
+		unsigned int firstChangedIndex = storage.GetFragmentList(bufferIndex).size();
+		for (unsigned int i = 0; i < fragmentVec.size(); i++)
+		{
+			unsigned int changedIndex = InsertFragment(bufferIndex, fragmentVec[i]->depth, fragmentVec[i]->color,
+				fragmentVec[i]->primitiveId, fragmentVec[i]->coverage);
+			firstChangedIndex = (changedIndex < firstChangedIndex) ? changedIndex : firstChangedIndex;
+		}
+
+		BlendABuffer(worldX, worldY, firstChangedIndex);
+		MergeFarthestFragments(worldX, worldY);
+		SetPixel(worldX, worldY, GetVisibleColor3(worldX, worldY));
+	}
+}
+
+/*
+ * The configurations that are built. 16-bit depths cover the scene's whole depth range, so 32-bit
+ * depths are only built for the default blend, for scenes that need more precision.
+ */
+template class SpecializedDepthBuffer<VectorStorage, OpaqueBlend, short>;
+template class SpecializedDepthBuffer<VectorStorage, AlphaBlend, short>;
+template class SpecializedDepthBuffer<VectorStorage, AdditiveBlend, short>;
+template class SpecializedDepthBuffer<VectorStorage, AlphaBlend, int>;
+
+
+/*
+ * A DepthBuffer that stores each row's fragments as runs of pixels [startX, endX), instead of
+ * a list per pixel. A run holds the pixels of one primitive at one depth that have the same
+ * color and coverage, so a large flat primitive like the sun takes one run per row (and one
+ * per edge pixel with --aa), and memory grows with the number of edges rather than the area.
+ * Inserting, removing or changing part of a run splits it, and runs that are left next to
+ * identical ones are merged back together.
+ *
+ * Nothing is blended until Resolve(), which sweeps each row from left to right and composites
+ * each stretch of pixels covered by the same runs once. Runs keep the sequence number they
+ * were inserted with, so that runs at the same depth are composited in the order that
+ * SpecializedDepthBuffer's lists would hold them, and the two give exactly the same colors.
+ * Rows are only touched by the worker that owns them, the same as pixels are.
+ *
+ * Runs are accounted for like fragments are (see GetFragmentUsage()), but a fragment budget is
+ * only reported against, not enforced, since merging runs into the background would split the
+ * background run up pixel by pixel.
+ */
+template <class BlendPolicy, class DepthType>
+class IntervalDepthBuffer : public DepthBuffer
+{
+public:
+	class Run
+	{
+	public:
+		unsigned short startX;
+		unsigned short endX;
+		unsigned short coverage;
+		DepthType depth;
+		PackedColor color;
+		unsigned int primitiveId;
+		unsigned int sequence; //Orders the runs at the same depth, from the first inserted to the last
+	};
+	typedef std::vector<Run> RunList; //Sorted by primitiveId, then depth, then startX
+
+	/*
+	 * Constructor
+	 */
+	IntervalDepthBuffer(unsigned int newWidth = WINDOW_WIDTH, unsigned int newHeight = WINDOW_HEIGHT) :
+		DepthBuffer(newWidth, newHeight), rowVec(newHeight)
+	{
+		peakRunCount = 0;
+		//Each row's runs are allocated by the worker that owns the row.
+		ForEachRowBand([this](int firstRow, int lastRow)
+		{
+			for (int y = firstRow; y < lastRow; y++)
+				ClearRow(rowVec[y]);
+		}, height);
+	}
+
+	/*
+	 * Accessors
+	 */
+	const char *GetName() const
+	{
+		return BlendPolicy::GetName();
+	}
+	int GetDepthBits() const
+	{
+		return sizeof(DepthType) * 8;
+	}
+
+	const char *GetStorageName() const
+	{
+		return "intervals";
+	}
+
+	//Reports how the rows are placed. The runs are on the heap.
+	void ReportMemory() const
+	{
+		ReportLargeBuffer("interval rows", &rowVec[0], height * sizeof(Row), height);
+	}
+	size_t GetFragmentBytes() const
+	{
+		size_t bytes = height * sizeof(Row);
+		for (unsigned int y = 0; y < height; y++)
+			bytes += rowVec[y].runVec.capacity() * sizeof(Run);
+		return bytes;
+	}
+
+	//The section is where each row's runs start, then each row's next sequence number, then every row's runs, in row order.
+	void AppendCheckpoint(std::vector<char> &data) const
+	{
+		std::vector<unsigned int> runStartVec(1, 0), nextSequenceVec;
+		std::vector<CheckpointRun> runVec;
+		for (unsigned int y = 0; y < height; y++)
+		{
+			runStartVec.push_back(runStartVec.back() + rowVec[y].runVec.size());
+			nextSequenceVec.push_back(rowVec[y].nextSequence);
+			for (unsigned int run = 0; run < rowVec[y].runVec.size(); run++)
+				runVec.push_back(GetCheckpointRun(rowVec[y].runVec[run]));
+		}
+		AppendCheckpointArray(data, &runStartVec[0], runStartVec.size());
+		AppendCheckpointArray(data, &nextSequenceVec[0], nextSequenceVec.size());
+		AppendCheckpointArray(data, &runVec[0], runVec.size());
+	}
+
+	//The runs in front of the background
+	size_t GetRunCount() const
+	{
+		size_t runCount = 0;
+		for (unsigned int y = 0; y < height; y++)
+			runCount += rowVec[y].runVec.size() - 1;
+		return runCount;
+	}
+
+	/*
+	 * Composites every row and writes it to pixelBuffer. The rows are shared out among the
+	 * worker pool in bands. Rows that aren't rendered repeat the row above them, the same as
+	 * SpecializedDepthBuffer::Resolve(). The peak usage is sampled here, once a frame.
+	 */
+	void Resolve() const
+	{
+		ForEachRowBand([this](int firstRow, int lastRow)
+		{
+			for (int y = firstRow; y < lastRow; y++)
+			{
+				if (y != firstRow && !IsRenderedRow(y))
+					CopyPixelRow(y - 1, y);
+				else
+					ResolveRow(GetRenderedRow(y), y);
+			}
+		}, height);
+		peakRunCount = std::max(peakRunCount, GetRunCount());
+	}
+
+	/*
+	 * Mutators
+	 */
+	/*
+	 * Every row has to start with its background run, as ClearRow() leaves it, and the rest of
+	 * its runs have to be in the order FindRun() searches them, without overlapping.
+	 */
+	bool RestoreCheckpoint(const char *data, size_t bytes)
+	{
+		const unsigned int *runStartArr, *nextSequenceArr;
+		const CheckpointRun *runArr;
+		if (!ReadCheckpointArray(data, bytes, runStartArr, height + 1) || !ReadCheckpointArray(data, bytes, nextSequenceArr, height))
+			return false;
+		unsigned int runCount = runStartArr[height];
+		if (runStartArr[0] != 0 || !ReadCheckpointArray(data, bytes, runArr, runCount))
+			return false;
+		for (unsigned int y = 0; y < height; y++)
+			if (runStartArr[y + 1] <= runStartArr[y] || runStartArr[y + 1] > runCount)
+				return false; //Every row has at least the background
+		for (unsigned int y = 0; y < height; y++)
+		{
+			const CheckpointRun &background = runArr[runStartArr[y]];
+			if (background.primitiveId != BACKGROUND_PRIMITIVE_ID || background.depth != DepthInfo<DepthType>::PackDepth(Z_FAR) ||
+				background.startX != 0 || background.endX != width)
+				return false;
+			for (unsigned int run = runStartArr[y]; run < runStartArr[y + 1]; run++)
+			{
+				const CheckpointRun &record = runArr[run];
+				if (record.startX >= record.endX || record.endX > width || record.coverage > FULL_COVERAGE ||
+					record.depth != DepthInfo<DepthType>::PackDepth(record.depth) || record.sequence >= nextSequenceArr[y])
+					return false;
+				if (run == runStartArr[y])
+					continue;
+				const CheckpointRun &previous = runArr[run - 1];
+				if (previous.primitiveId != record.primitiveId ? previous.primitiveId > record.primitiveId :
+					previous.depth != record.depth ? previous.depth > record.depth : previous.endX > record.startX)
+					return false;
+			}
+		}
+
+		ForEachRowBand([this, runStartArr, nextSequenceArr, runArr](int firstRow, int lastRow)
+		{
+			for (int y = firstRow; y < lastRow; y++)
+			{
+				rowVec[y].runVec.clear();
+				for (unsigned int run = runStartArr[y]; run < runStartArr[y + 1]; run++)
+					rowVec[y].runVec.push_back(GetRun(runArr[run]));
+				rowVec[y].nextSequence = nextSequenceArr[y];
+			}
+		}, height);
+		return true;
+	}
+
+	void Clear()
+	{
+		ForEachRowBand([this](int firstRow, int lastRow)
+		{
+			for (int y = firstRow; y < lastRow; y++)
+			{
+				ClearRow(rowVec[y]);
+				for (int x = 0; x < (int)width; x++)
+					SetPixel(x, y, rowVec[y].runVec[0].color.GetColor3());
+			}
+		}, height);
+	}
+
+	void InsertSpan(int worldY, int startX, int endX, const int *worldZArr, const unsigned short *coverageArr,
+		const Color4 &color, unsigned int primitiveId)
+	{
+		Row &row = rowVec[worldY];
+		PackedColor packedColor(color);
+		ForEachRun(startX, endX, worldZArr, coverageArr, [&](int runStartX, int runEndX, DepthType depth, unsigned short coverage)
+		{
+			InsertRun(row, runStartX, runEndX, depth, packedColor, coverage, primitiveId);
+		});
+	}
+
+	void RemoveSpan(int worldY, int startX, int endX, const int *worldZArr, unsigned int primitiveId)
+	{
+		Row &row = rowVec[worldY];
+		ForEachRun(startX, endX, worldZArr, NULL, [&](int runStartX, int runEndX, DepthType depth, unsigned short /*coverage*/)
+		{
+			RemoveRun(row, runStartX, runEndX, depth, primitiveId);
+		});
+	}
+
+	//The same as SpecializedDepthBuffer::MoveFragment() for each pixel: every removal on the span is done before the insertions.
+	void MoveSpan(int worldY, int startX, int endX, const int *oldWorldZArr, const int *newWorldZArr,
+		const unsigned short *oldCoverageArr, const unsigned short *newCoverageArr, const Color4 &color, unsigned int primitiveId)
+	{
+		static thread_local std::vector<unsigned short> removedVec, insertedVec; //The coverage each pixel is removed or inserted with, or 0
+		removedVec.resize(endX - startX);
+		insertedVec.resize(endX - startX);
+		for (int pixel = 0; pixel < endX - startX; pixel++)
+		{
+			bool moved = oldWorldZArr[pixel] != newWorldZArr[pixel] || oldCoverageArr[pixel] != newCoverageArr[pixel];
+			removedVec[pixel] = (moved && (oldWorldZArr[pixel] != newWorldZArr[pixel] || newCoverageArr[pixel] == 0)) ? FULL_COVERAGE : 0;
+			insertedVec[pixel] = moved ? newCoverageArr[pixel] : 0;
+		}
+
+		Row &row = rowVec[worldY];
+		PackedColor packedColor(color);
+		ForEachRun(startX, endX, oldWorldZArr, &removedVec[0], [&](int runStartX, int runEndX, DepthType depth, unsigned short /*coverage*/)
+		{
+			RemoveRun(row, runStartX, runEndX, depth, primitiveId);
+		});
+		ForEachRun(startX, endX, newWorldZArr, &insertedVec[0], [&](int runStartX, int runEndX, DepthType depth, unsigned short coverage)
+		{
+			InsertRun(row, runStartX, runEndX, depth, packedColor, coverage, primitiveId);
+		});
+	}
+
+	/*
+	 * The fragments of the span are inserted in the same order as SpecializedDepthBuffer's, by
+	 * depth then by primitive, with neighboring pixels of the same primitive, depth, color and
+	 * coverage inserted together as one run.
+	 */
+	void ResolveFragmentSpan(FragmentStore &fragmentStore, int worldY, int startX, int endX)
+	{
+		static thread_local std::vector<std::pair<int, const FragmentStore::Fragment *> > fragmentVec; //(worldX, fragment)
+		fragmentVec.clear();
+		for (int worldX = startX; worldX < endX; worldX++)
+			for (unsigned int fragment = fragmentStore.TakeList(worldX, worldY); fragment != FragmentStore::NO_FRAGMENT;
+				fragment = fragmentStore.GetFragment(fragment).next)
+				fragmentVec.push_back(std::make_pair(worldX, &fragmentStore.GetFragment(fragment)));
+		std::sort(fragmentVec.begin(), fragmentVec.end(), [](const std::pair<int, const FragmentStore::Fragment *> &a,
+			const std::pair<int, const FragmentStore::Fragment *> &b)
+		{
+			if (a.second->depth != b.second->depth)
+				return a.second->depth < b.second->depth;
+			return (a.second->primitiveId != b.second->primitiveId) ? a.second->primitiveId < b.second->primitiveId : a.first < b.first;
+		});
+
+		Row &row = rowVec[worldY];
+		for (unsigned int first = 0, last; first < fragmentVec.size(); first = last)
+		{
+			const FragmentStore::Fragment &fragment = *fragmentVec[first].second;
+			for (last = first + 1; last < fragmentVec.size(); last++)
+			{
+				const FragmentStore::Fragment &next = *fragmentVec[last].second;
+				if (fragmentVec[last].first != fragmentVec[last - 1].first + 1 || next.depth != fragment.depth ||
+					next.primitiveId != fragment.primitiveId || next.color != fragment.color || next.coverage != fragment.coverage)
+					break;
+			}
+			InsertRun(row, fragmentVec[first].first, fragmentVec[last - 1].first + 1, DepthInfo<DepthType>::PackDepth(fragment.depth),
+				fragment.color, fragment.coverage, fragment.primitiveId);
+		}
+	}
+
+private:
+	class Row
+	{
+	public:
+		RunList runVec;
+		unsigned int nextSequence;
+	};
+
+	void ClearRow(Row &row) const
+	{
+		Run background;
+		background.startX = 0;
+		background.endX = width;
+		background.coverage = FULL_COVERAGE;
+		background.depth = DepthInfo<DepthType>::PackDepth(Z_FAR);
+		background.color = Color4(0.0f, 0.0f, 0.0f, 1.0f);
+		background.primitiveId = BACKGROUND_PRIMITIVE_ID;
+		background.sequence = 0;
+		row.runVec.assign(1, background);
+		row.nextSequence = 1;
+	}
+
+	/*
+	 * Calls runFunction(runStartX, runEndX, depth, coverage) for each run of neighboring pixels
+	 * in [startX, endX) with the same packed depth and coverage, skipping pixels whose coverage
+	 * is 0. Every pixel has full coverage if coverageArr is NULL.
+	 */
+	template <class RunFunction>
+	static void ForEachRun(int startX, int endX, const int *worldZArr, const unsigned short *coverageArr, RunFunction runFunction)
+	{
+		for (int runStartX = startX, runEndX; runStartX < endX; runStartX = runEndX)
+		{
+			DepthType depth = DepthInfo<DepthType>::PackDepth(worldZArr[runStartX - startX]);
+			unsigned short coverage = (coverageArr == NULL) ? FULL_COVERAGE : coverageArr[runStartX - startX];
+			for (runEndX = runStartX + 1; runEndX < endX; runEndX++)
+				if (DepthInfo<DepthType>::PackDepth(worldZArr[runEndX - startX]) != depth ||
+					(coverageArr != NULL && coverageArr[runEndX - startX] != coverage))
+					break;
+			if (coverage != 0)
+				runFunction(runStartX, runEndX, depth, coverage);
+		}
+	}
+
+	//The index of the first of primitiveId's runs at depth that ends after x, or of where it would be inserted.
+	static unsigned int FindRun(const RunList &runVec, unsigned int primitiveId, DepthType depth, int x)
+	{
+		return std::lower_bound(runVec.begin(), runVec.end(), x, [primitiveId, depth](const Run &run, int x)
+		{
+			if (run.primitiveId != primitiveId)
+				return run.primitiveId < primitiveId;
+			return (run.depth != depth) ? run.depth < depth : run.endX <= x;
+		}) - runVec.begin();
+	}
+
+	static bool IsRunOf(const RunList &runVec, unsigned int run, unsigned int primitiveId, DepthType depth)
+	{
+		return run < runVec.size() && runVec[run].primitiveId == primitiveId && runVec[run].depth == depth;
+	}
+
+	static CheckpointRun GetCheckpointRun(const Run &run)
+	{
+		CheckpointRun record = CheckpointRun();
+		record.startX = run.startX;
+		record.endX = run.endX;
+		record.coverage = run.coverage;
+		record.depth = run.depth;
+		record.color = run.color;
+		record.primitiveId = run.primitiveId;
+		record.sequence = run.sequence;
+		return record;
+	}
+	static Run GetRun(const CheckpointRun &record)
+	{
+		Run run;
+		run.startX = (unsigned short)record.startX;
+		run.endX = (unsigned short)record.endX;
+		run.coverage = (unsigned short)record.coverage;
+		run.depth = (DepthType)record.depth;
+		run.color = record.color;
+		run.primitiveId = record.primitiveId;
+		run.sequence = record.sequence;
+		return run;
+	}
+
+	/*
+	 * Inserts primitiveId's fragments on [startX, endX) of the row. Pixels it already has a
+	 * fragment on at this depth are updated in place, keeping their sequence number, the way
+	 * SpecializedDepthBuffer::InsertFragment() replaces them, and the rest get a new one.
+	 */
+	void InsertRun(Row &row, int startX, int endX, DepthType depth, const PackedColor &color, unsigned short coverage,
+		unsigned int primitiveId)
+	{
+		RunList &runVec = row.runVec;
+		unsigned int run = FindRun(runVec, primitiveId, depth, startX);
+		unsigned int sequence = row.nextSequence;
+		for (int x = startX; x < endX;)
+		{
+			if (IsRunOf(runVec, run, primitiveId, depth) && runVec[run].startX <= x)
+			{
+				Run overlap = runVec[run];
+				int overlapEndX = (overlap.endX < endX) ? overlap.endX : endX;
+				if (overlap.color != color || overlap.coverage != coverage)
+				{
+					//Split off the parts outside [x, overlapEndX), which keep their color and coverage.
+					if (overlap.endX > overlapEndX)
+					{
+						Run right = overlap;
+						right.startX = overlapEndX;
+						runVec.insert(runVec.begin() + run + 1, right);
+					}
+					Run changed = overlap;
+					changed.startX = x;
+					changed.endX = overlapEndX;
+					changed.color = color;
+					changed.coverage = coverage;
+					if (overlap.startX < x)
+					{
+						runVec[run].endX = x;
+						runVec.insert(runVec.begin() + ++run, changed);
+					}
+					else
+						runVec[run] = changed;
+				}
+				x = overlapEndX;
+				run++;
+			}
+			else
+			{
+				//Fill the gap up to the primitive's next run at this depth.
+				Run gap;
+				gap.startX = x;
+				gap.endX = (IsRunOf(runVec, run, primitiveId, depth) && runVec[run].startX < endX) ? runVec[run].startX : endX;
+				gap.coverage = coverage;
+				gap.depth = depth;
+				gap.color = color;
+				gap.primitiveId = primitiveId;
+				gap.sequence = sequence;
+				row.nextSequence = sequence + 1;
+				runVec.insert(runVec.begin() + run, gap);
+				x = gap.endX;
+				run++;
+			}
+		}
+		MergeRuns(runVec, startX, endX, depth, primitiveId);
+	}
+
+	//Removes primitiveId's fragments on [startX, endX) of the row, at depth.
+	void RemoveRun(Row &row, int startX, int endX, DepthType depth, unsigned int primitiveId)
+	{
+		RunList &runVec = row.runVec;
+		unsigned int run = FindRun(runVec, primitiveId, depth, startX);
+		while (IsRunOf(runVec, run, primitiveId, depth) && runVec[run].startX < endX)
+		{
+			Run &current = runVec[run];
+			if (current.startX < startX && current.endX > endX)
+			{
+				Run right = current;
+				right.startX = endX;
+				current.endX = startX;
+				runVec.insert(runVec.begin() + run + 1, right);
+				return;
+			}
+			if (current.startX < startX)
+			{
+				current.endX = startX;
+				run++;
+			}
+			else if (current.endX > endX)
+			{
+				current.startX = endX;
+				return;
+			}
+			else
+				runVec.erase(runVec.begin() + run);
+		}
+	}
+
+	/*
+	 * Merges primitiveId's runs at depth that touch [startX, endX) with their neighbors, where
+	 * they're the same but for where they are. Two runs with different sequence numbers are
+	 * only merged if no other run at the same depth was inserted between them on those pixels,
+	 * so that the order they're composited in doesn't change.
+	 */
+	void MergeRuns(RunList &runVec, int startX, int endX, DepthType depth, unsigned int primitiveId)
+	{
+		unsigned int run = FindRun(runVec, primitiveId, depth, startX - 1);
+		while (IsRunOf(runVec, run, primitiveId, depth) && IsRunOf(runVec, run + 1, primitiveId, depth) && runVec[run + 1].startX <= endX)
+		{
+			Run &current = runVec[run], &next = runVec[run + 1];
+			if (current.endX == next.startX && current.color == next.color && current.coverage == next.coverage &&
+				CanShareSequence(runVec, current, next))
+			{
+				current.endX = next.endX;
+				current.sequence = (current.sequence < next.sequence) ? current.sequence : next.sequence;
+				runVec.erase(runVec.begin() + run + 1);
+			}
+			else
+				run++;
+		}
+	}
+
+	static bool CanShareSequence(const RunList &runVec, const Run &first, const Run &second)
+	{
+		if (first.sequence == second.sequence)
+			return true;
+		unsigned int minSequence = (first.sequence < second.sequence) ? first.sequence : second.sequence;
+		unsigned int maxSequence = (first.sequence < second.sequence) ? second.sequence : first.sequence;
+		for (unsigned int run = 0; run < runVec.size(); run++)
+		{
+			const Run &other = runVec[run];
+			if (other.depth == first.depth && other.sequence > minSequence && other.sequence < maxSequence &&
+				other.startX < second.endX && other.endX > first.startX)
+				return false;
+		}
+		return true;
+	}
+
+	/*
+	 * Sweeps row y from left to right, keeping the runs that cover the current stretch sorted
+	 * from back to front, and draws each stretch between two run edges in one color.
+	 */
+	//Composites row y and writes it to row pixelY of pixelBuffer.
+	void ResolveRow(int y, int pixelY) const
+	{
+		static thread_local std::vector<std::pair<int, unsigned int> > edgeVec; //(x, run) for both ends of every run
+		static thread_local std::vector<unsigned int> activeVec;
+		const RunList &runVec = rowVec[y].runVec;
+		edgeVec.clear();
+		for (unsigned int run = 0; run < runVec.size(); run++)
+		{
+			edgeVec.push_back(std::make_pair((int)runVec[run].startX, run));
+			edgeVec.push_back(std::make_pair((int)runVec[run].endX, run));
+		}
+		std::sort(edgeVec.begin(), edgeVec.end());
+
+		activeVec.clear();
+		for (unsigned int edge = 0; edge < edgeVec.size();)
+		{
+			int startX = edgeVec[edge].first;
+			for (; edge < edgeVec.size() && edgeVec[edge].first == startX; edge++)
+			{
+				const Run &run = runVec[edgeVec[edge].second];
+				std::vector<unsigned int>::iterator position = std::lower_bound(activeVec.begin(), activeVec.end(), edgeVec[edge].second,
+					[&runVec](unsigned int a, unsigned int b)
+				{
+					return (runVec[a].depth != runVec[b].depth) ? runVec[a].depth < runVec[b].depth : runVec[a].sequence < runVec[b].sequence;
+				});
+				if (run.startX == startX)
+					activeVec.insert(position, edgeVec[edge].second);
+				else
+					activeVec.erase(position);
+			}
+			if (edge == edgeVec.size() || activeVec.empty())
+				continue;
+
+			Color3 color = Composite(runVec, activeVec);
+			for (int x = startX; x < edgeVec[edge].first; x++)
+				SetPixel(x, pixelY, color);
+		}
+	}
+
+	//Blends the runs of activeVec from back to front, the same way SpecializedDepthBuffer::BlendABuffer() blends a list.
+	static Color3 Composite(const RunList &runVec, const std::vector<unsigned int> &activeVec)
+	{
+		if (antiAliasing)
+			for (unsigned int i = 1; i < activeVec.size(); i++)
+				if (runVec[activeVec[i]].coverage != FULL_COVERAGE)
+					return CompositeSubpixels(runVec, activeVec);
+
+		PackedColor blendedColor = runVec[activeVec[0]].color;
+		Color4V prevColor = blendedColor.GetColor4V();
+		for (unsigned int i = 1; i < activeVec.size(); i++)
+		{
+			const PackedColor &color = runVec[activeVec[i]].color;
+			if (BlendPolicy::HidesBehind(color))
+			{
+				blendedColor = color;
+				prevColor = color.GetColor4V();
+				continue;
+			}
+			prevColor = blendedColor.Set(BlendPolicy::Blend(color, prevColor));
+		}
+		return blendedColor.GetColor3();
+	}
+
+	//See SpecializedDepthBuffer::BlendABufferSubpixels().
+	static Color3 CompositeSubpixels(const RunList &runVec, const std::vector<unsigned int> &activeVec)
+	{
+		PackedColor blendedColor = runVec[activeVec[0]].color;
+		Color4V subpixelColorArr[COVERAGE_SUBPIXELS];
+		for (int subpixel = 0; subpixel < COVERAGE_SUBPIXELS; subpixel++)
+			subpixelColorArr[subpixel] = blendedColor.GetColor4V();
+
+		for (unsigned int i = 1; i < activeVec.size(); i++)
+		{
+			const PackedColor &color = runVec[activeVec[i]].color;
+			unsigned short coverage = runVec[activeVec[i]].coverage;
+			bool hidesBehind = BlendPolicy::HidesBehind(color);
+			Color4V colorV = color.GetColor4V();
+			Color4V sum(0.0f, 0.0f, 0.0f, 0.0f);
+			PackedColor roundedColor;
+			for (int subpixel = 0; subpixel < COVERAGE_SUBPIXELS; subpixel++)
+			{
+				Color4V &subpixelColor = subpixelColorArr[subpixel];
+				if (coverage & (1 << subpixel))
+					subpixelColor = hidesBehind ? colorV : roundedColor.Set(BlendPolicy::Blend(color, subpixelColor));
+				sum = sum + subpixelColor;
+			}
+			blendedColor.Set((sum * (1.0f / COVERAGE_SUBPIXELS)).GetOpaque());
+		}
+		return blendedColor.GetColor3();
+	}
+
+	//A run's bytes count towards the region its first pixel is in.
+	void AddFragmentUsage(FragmentUsage &usage, std::map<unsigned int, size_t> &primitiveBytesMap) const
+	{
+		usage.currentBytes = GetRunCount() * sizeof(Run);
+		usage.peakBytes = std::max(peakRunCount * sizeof(Run), usage.currentBytes);
+		for (unsigned int y = 0; y < height; y++)
+		{
+			const RunList &runVec = rowVec[y].runVec;
+			for (unsigned int run = 0; run < runVec.size(); run++)
+			{
+				if (runVec[run].primitiveId == BACKGROUND_PRIMITIVE_ID)
+					continue;
+				usage.regionBytesVec[GetRegion(runVec[run].startX, y)] += sizeof(Run);
+				primitiveBytesMap[runVec[run].primitiveId] += sizeof(Run);
+			}
+		}
+	}
+
+private:
+	std::vector<Row> rowVec;
+	mutable size_t peakRunCount;
+};
+
+template class IntervalDepthBuffer<OpaqueBlend, short>;
+template class IntervalDepthBuffer<AlphaBlend, short>;
+template class IntervalDepthBuffer<AdditiveBlend, short>;
+template class IntervalDepthBuffer<AlphaBlend, int>;
+
+//Returns a new depth buffer for --storage, --blend and --depth-bits, or NULL if there's no such configuration.
+DepthBuffer *NewDepthBuffer(const std::string &storageName, const std::string &blendName, int depthBits, unsigned int width, unsigned int height)
+{
+	if (storageName == "intervals")
+	{
+		if (depthBits == 16 && blendName == OpaqueBlend::GetName())
+			return new IntervalDepthBuffer<OpaqueBlend, short>(width, height);
+		if (depthBits == 16 && blendName == AlphaBlend::GetName())
+			return new IntervalDepthBuffer<AlphaBlend, short>(width, height);
+		if (depthBits == 16 && blendName == AdditiveBlend::GetName())
+			return new IntervalDepthBuffer<AdditiveBlend, short>(width, height);
+		if (depthBits == 32 && blendName == AlphaBlend::GetName())
+			return new IntervalDepthBuffer<AlphaBlend, int>(width, height);
+		return NULL;
+	}
+	if (storageName != "pixels")
+		return NULL;
+	if (depthBits == 16 && blendName == OpaqueBlend::GetName())
+		return new SpecializedDepthBuffer<VectorStorage, OpaqueBlend, short>(width, height);
+	if (depthBits == 16 && blendName == AlphaBlend::GetName())
+		return new SpecializedDepthBuffer<VectorStorage, AlphaBlend, short>(width, height);
+	if (depthBits == 16 && blendName == AdditiveBlend::GetName())
+		return new SpecializedDepthBuffer<VectorStorage, AdditiveBlend, short>(width, height);
+	if (depthBits == 32 && blendName == AlphaBlend::GetName())
+		return new SpecializedDepthBuffer<VectorStorage, AlphaBlend, int>(width, height);
+	return NULL;
+}
+
+
+/*
+ * A ring of finished frames in POSIX shared memory (shm_open()), that other processes, such as
+ * a viewer, an encoder or a monitor, map and read in place, with no GL context and no copies
+ * (see RunFrameViewer()). Frames are 8-bit RGB, top row first, the same as the goldens.
+ *
+ * Each slot is guarded by a sequence lock: its sequence is odd while the slot is being
+ * written, and twice the number of the frame in it once it's finished. A reader checks the
+ * sequence before and after reading a frame, and throws the frame away if it changed, since
+ * the renderer never waits for readers. Frames are numbered from 1.
+ */
+#if ATOMIC_LLONG_LOCK_FREE != 2
+#error The sequences in SharedFrameRing have to be lock-free to be shared between processes.
+#endif
+class SharedFrameRing
+{
+public:
+	static const unsigned int MAGIC = 0x474E4952; //"RING"
+	static const unsigned int VERSION = 1;
+	static const unsigned int SLOT_COUNT = 3; //So that a reader has two frames' time to read one
+
+	class Header
+	{
+	public:
+		unsigned int magic;
+		unsigned int version;
+		unsigned int width;
+		unsigned int height;
+		unsigned int slotCount;
+		unsigned int slotBytes; //Each slot is a page-aligned offset from the header
+		std::atomic<unsigned long long> latestFrame; //0 until the first frame is published
+		std::atomic<unsigned long long> slotSequenceArr[SLOT_COUNT];
+	};
+
+	/*
+	 * Constructor
+	 */
+	SharedFrameRing()
+	{
+		header = NULL;
+		mappedBytes = 0;
+		owner = false;
+	}
+	~SharedFrameRing()
+	{
+		Close();
+	}
+
+	/*
+	 * Accessors
+	 */
+	bool IsOpen() const
+	{
+		return header != NULL;
+	}
+	const Header &GetHeader() const
+	{
+		return *header;
+	}
+	unsigned long long GetLatestFrame() const
+	{
+		return header->latestFrame.load(std::memory_order_acquire);
+	}
+
+	//The pixels of frame, in place, or NULL if it has been overwritten (or hasn't been published).
+	const unsigned char *GetFrame(unsigned long long frame) const
+	{
+		if (header->slotSequenceArr[frame % SLOT_COUNT].load(std::memory_order_acquire) != frame * 2)
+			return NULL;
+		return GetSlot(frame % SLOT_COUNT);
+	}
+
+	//Whether frame was still intact after its pixels were read. If not, whatever was read is garbage.
+	bool IsFrameIntact(unsigned long long frame) const
+	{
+		std::atomic_thread_fence(std::memory_order_acquire);
+		return header->slotSequenceArr[frame % SLOT_COUNT].load(std::memory_order_relaxed) == frame * 2;
+	}
+
+	/*
+	 * Mutators
+	 */
+	//Creates the ring called name (replacing any old one), for frames of width*height. Returns false if shared memory isn't available.
+	bool Create(const char *name, unsigned int width, unsigned int height)
+	{
+		Close();
+#ifdef __linux__
+		size_t slotBytes = (width * height * 3 + PAGE_SIZE - 1) / PAGE_SIZE * PAGE_SIZE;
+		size_t bytes = GetFirstSlotOffset() + slotBytes * SLOT_COUNT;
+		shm_unlink(name); //Readers of an old ring keep theirs, rather than having it shrink under them
+		int file = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0644);
+		if (file < 0)
+			return false;
+		void *memory = (ftruncate(file, bytes) == 0) ? mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, file, 0) : MAP_FAILED;
+		close(file);
+		if (memory == MAP_FAILED)
+		{
+			shm_unlink(name);
+			return false;
+		}
+
+		header = new (memory) Header();
+		header->width = width;
+		header->height = height;
+		header->slotCount = SLOT_COUNT;
+		header->slotBytes = slotBytes;
+		header->latestFrame.store(0, std::memory_order_relaxed);
+		for (unsigned int slot = 0; slot < SLOT_COUNT; slot++)
+			header->slotSequenceArr[slot].store(0, std::memory_order_relaxed);
+		header->version = VERSION;
+		std::atomic_thread_fence(std::memory_order_release);
+		header->magic = MAGIC; //Last, so that a reader never sees a half-made header as valid
+		mappedBytes = bytes;
+		owner = true;
+		ringName = name;
+		return true;
+#else
+		return false;
+#endif
+	}
+
+	//Maps the ring called name, read-only. Returns false if there's no such ring, or it was made by another version.
+	bool Open(const char *name)
+	{
+		Close();
+#ifdef __linux__
+		int file = shm_open(name, O_RDONLY, 0);
+		if (file < 0)
+			return false;
+		struct stat fileStat;
+		void *memory = MAP_FAILED;
+		if (fstat(file, &fileStat) == 0 && (size_t)fileStat.st_size >= GetFirstSlotOffset())
+			memory = mmap(NULL, fileStat.st_size, PROT_READ, MAP_SHARED, file, 0);
+		close(file);
+		if (memory == MAP_FAILED)
+			return false;
+
+		header = (Header *)memory;
+		mappedBytes = fileStat.st_size;
+		//Readers read width*height RGB pixels out of each slot, so a frame must fit in one.
+		if (header->magic != MAGIC || header->version != VERSION || header->slotCount != SLOT_COUNT ||
+			mappedBytes < GetFirstSlotOffset() + (size_t)header->slotBytes * SLOT_COUNT ||
+			(unsigned long long)header->width * header->height * 3 > header->slotBytes)
+		{
+			Close();
+			return false;
+		}
+		return true;
+#else
+		return false;
+#endif
+	}
+
+	//Unmaps the ring, and removes it if this process created it. Readers that still have it mapped keep it until they close it.
+	void Close()
+	{
+#ifdef __linux__
+		if (header != NULL)
+			munmap(header, mappedBytes);
+		if (owner)
+			shm_unlink(ringName.c_str());
+#endif
+		header = NULL;
+		mappedBytes = 0;
+		owner = false;
+	}
+
+	//Converts pixelBuffer into the next slot, in bands of rows across the worker pool, and publishes it.
+	void Publish(const float *pixelBuffer)
+	{
+		unsigned long long frame = header->latestFrame.load(std::memory_order_relaxed) + 1;
+		std::atomic<unsigned long long> &sequence = header->slotSequenceArr[frame % SLOT_COUNT];
+		sequence.store(frame * 2 - 1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+
+		unsigned char *slot = GetSlot(frame % SLOT_COUNT);
+		unsigned int width = header->width, height = header->height;
+		ForEachRowBand([slot, width, height, pixelBuffer](int firstRow, int lastRow)
+		{
+			for (int y = firstRow; y < lastRow; y++)
+			{
+				const float *source = &pixelBuffer[y * width * 3];
+				unsigned char *destination = &slot[(height - 1 - y) * width * 3];
+				for (unsigned int channel = 0; channel < width * 3; channel++)
+					destination[channel] = (unsigned char)(source[channel] * 255.0f + 0.5f);
+			}
+		}, height);
+
+		sequence.store(frame * 2, std::memory_order_release);
+		header->latestFrame.store(frame, std::memory_order_release);
+	}
+
+private:
+	static const size_t PAGE_SIZE = 4096; //In bytes
+
+	//The slots start on the page after the header.
+	static size_t GetFirstSlotOffset()
+	{
+		return (sizeof(Header) + PAGE_SIZE - 1) / PAGE_SIZE * PAGE_SIZE;
+	}
+	unsigned char *GetSlot(unsigned int slot) const
+	{
+		return (unsigned char *)header + GetFirstSlotOffset() + (size_t)slot * header->slotBytes;
+	}
+
+private:
+	Header *header; //The start of the mapping
+	size_t mappedBytes;
+	bool owner; //Whether this process created the ring, and removes it on Close()
+	std::string ringName;
+};
+
+
+/*
+ * Holds frames to a target time (--frame-target) by rendering fewer rows when they run long.
+ * Only every rowStep-th row is rasterized and blended (see DepthBuffer::SetRowStep()), and
+ * Resolve() repeats it on the rows below, so a frame costs about 1/rowStep of what it does at
+ * full resolution.
+ * Frames are measured WINDOW_FRAMES at a time: a window that averages over the target
+ * coarsens the step by one, and one that would fit within HEADROOM of the target at the next
+ * finer step refines it by one. Changing the step rasterizes the whole scene again (see
+ * SetRenderRowStep()), so the frame after a change isn't measured.
+ */
+class ResolutionController
+{
+public:
+	static const int WINDOW_FRAMES = 8;
+
+	/*
+	 * Constructor
+	 */
+	ResolutionController()
+	{
+		targetNanoseconds = 0.0;
+		windowNanoseconds = 0.0;
+		windowFrameCount = 0;
+		changeCount = 0;
+		skipNextFrame = false;
+	}
+
+	/*
+	 * Accessors
+	 */
+	bool IsEnabled() const
+	{
+		return targetNanoseconds > 0.0;
+	}
+	double GetTargetMilliseconds() const
+	{
+		return targetNanoseconds / 1000000.0;
+	}
+	unsigned int GetChangeCount() const
+	{
+		return changeCount;
+	}
+
+	/*
+	 * Mutators
+	 */
+	//0 turns the controller off.
+	void SetTarget(double milliseconds)
+	{
+		targetNanoseconds = milliseconds * 1000000.0;
+	}
+
+	//Adds a frame that took frameNanoseconds at currentRowStep, and returns the row step the next frame should be rendered with.
+	unsigned int AddFrame(double frameNanoseconds, unsigned int currentRowStep)
+	{
+		const double HEADROOM = 0.8;
+		if (!IsEnabled())
+			return currentRowStep;
+		if (skipNextFrame)
+		{
+			skipNextFrame = false;
+			return currentRowStep;
+		}
+		windowNanoseconds += frameNanoseconds;
+		if (++windowFrameCount < WINDOW_FRAMES)
+			return currentRowStep;
+
+		double meanNanoseconds = windowNanoseconds / windowFrameCount;
+		windowNanoseconds = 0.0;
+		windowFrameCount = 0;
+		unsigned int rowStep = currentRowStep;
+		if (meanNanoseconds > targetNanoseconds && rowStep < MAX_RENDER_ROW_STEP)
+			rowStep++;
+		else if (rowStep > 1 && meanNanoseconds * rowStep / (rowStep - 1) < targetNanoseconds * HEADROOM)
+			rowStep--;
+		if (rowStep != currentRowStep)
+		{
+			changeCount++;
+			skipNextFrame = true;
+		}
+		return rowStep;
+	}
+
+private:
+	double targetNanoseconds;
+	double windowNanoseconds;
+	int windowFrameCount;
+	unsigned int changeCount;
+	bool skipNextFrame;
+};
+
+
+
+/*
+ * What a scene is rendered into: a depth buffer, which resolves into its own pixel buffer at its
+ * own row step, and the fragment store its sort-last batches are gathered in. Everything that
+ * rasterizes is given one, so scenes that are rendered at once on different workers, each into
+ * a context of its own, never write to the same buffers (see RunScenes()).
+ */
+class RenderContext
+{
+public:
+	/*
+	 * Constructor
+	 */
+	RenderContext(DepthBuffer *newDepthBuffer = NULL, FragmentStore *newFragmentStore = NULL)
+	{
+		depthBuffer = newDepthBuffer;
+		fragmentStore = newFragmentStore;
+	}
+
+	//Make this private later
+	DepthBuffer *depthBuffer;
+	FragmentStore *fragmentStore;
+};
+
+//Out-of-class definition of the Triangle function that draws through RenderContext.
+void Triangle::Draw(const RenderContext &context, const Color3 &color) const
+{
+	int worldY, startX, endX;
+	const std::vector<Vector2I> &relativeXPairVec = shape->relativeXPairVec;
+	for (unsigned int relativeY = 0; relativeY < relativeXPairVec.size(); relativeY++)
+	{
+		worldY = relativeY + (int)vertexArr[0].GetY() + (int)relativePosition.GetY();
+		startX = relativeXPairVec[relativeY].GetX() + GetBaseX(relativeY + (int)vertexArr[0].GetY()) + (int)relativePosition.GetX();
+		endX = relativeXPairVec[relativeY].GetY() + GetBaseX(relativeY + (int)vertexArr[0].GetY()) + (int)relativePosition.GetX();
+		if (!ClipScanLineToViewport(context, worldY, startX, endX))
+			continue;
+		for (int x = startX; x < endX; x++)
+			SetPixel(context.depthBuffer->GetPixelBuffer(), x, worldY, color);
+	}
+
+	/*
+	* Both of these functions update the pixels onscreen, so that each time a new pixel
+	* is "added to" pixelBuffer, it immediately draws onscreen. This way, the lines
+	* animate as they're drawn to the screen.
+	*/
+	//Draws pixel on screen, width and height must match pixel buffer dimension
+	glDrawPixels(WINDOW_WIDTH, WINDOW_HEIGHT, GL_RGB, GL_FLOAT, context.depthBuffer->GetPixelBuffer());
+	//Window refresh
+	glFlush();
+}
+
+
+/*
+ * Everything the solar system's animation reads and writes besides the RenderContext it's
+ * rendered into: its bodies, the spatial grid they're indexed in, and the state they're animated
+ * from. Asteroids are spawned from its own random stream, so its frames depend only on how that
+ * was seeded, and not on what else is being rendered.
+ */
+class SolarSystem
+{
+public:
+	/*
+	 * Constructor
+	 */
+	SolarSystem()
+	{
+		theta = 0.0f;
+		asteroidTime = 0;
+		timeOfLastCreatedAsteroid = -1;
+	}
+
+	//Make this private later
+	Triangle sun;
+	std::vector<Triangle> planetVec;
+	std::vector<Triangle> asteroidVec;
+	std::vector<Splat> asteroidSplatVec; //Asteroids too small to be drawn as triangles, see AddAsteroid()
+	Triangle alienPlanet;
+	TriangleMesh alienPlanetRings;
+	SpatialGrid spatialGrid; //Bounding boxes of every body, for overlap and pick queries
+	float theta;
+	int asteroidTime; //See GetAsteroidTime()
+	int timeOfLastCreatedAsteroid; //In GetAsteroidTime()'s time
+	RandomStream random; //Asteroids are spawned from it
+};
+
+
+
+/*
+* Global variables
+*/
+unsigned long long randomSeed = 0; //Set with --seed, so that runs can be replayed exactly
+bool randomSeedGiven = false; //If false, randomSeed is taken from the time
+thread_local RandomStream threadRandomStream; //Each thread seeds its own with SeedThreadRandomStream()
+WorkerPool workerPool; //Started with --threads, or with every hardware thread for --sort-last and --scenes
+FragmentStore fragmentStore; //renderContext's
+RenderContext renderContext(NULL, &fragmentStore); //The window's, --headless's, --bench's and the golden harness's. Its depth buffer is created in main() for --storage, --blend and --depth-bits.
+SolarSystem solarSystem; //The one the window and --headless render
+SharedFrameRing presentRing; //Every finished frame is published to it, if it was created with --present-shm
+const char *checkpointPath = NULL; //Set with --checkpoint: the solar system is checkpointed to it as it's rendered
+const char *restorePath = NULL; //Set with --restore: the solar system is restored from it rather than created
+ResolutionController resolutionController; //Given a target with --frame-target
+unsigned int debrisPerAsteroid = 0; //Set with --debris: --headless trails every asteroid with this many splats
+//Triangle testTriangle(Vector2F(0, 0), Vector2F(100, 0), Vector2F(50, 50)); //works
+//Triangle testTriangle(Vector2F(0, 100), Vector2F(100, 100), Vector2F(50, 150)); //works
+//Triangle testTriangle(Vector2F(0, 80), Vector2F(100, 100), Vector2F(50, 150)); //work
+//Triangle testTriangle(Vector2F(0, 0), Vector2F(10, 20), Vector2F(60, 300)); //works
+//Triangle testTriangle(Vector2F(0, 300), Vector2F(100, 100), Vector2F(50, 400)); //works
+//Triangle testTriangle(Vector2F(0, 100), Vector2F(100, 50), Vector2F(50, 150)); //works
+
+
+/*
+* Function prototypes
+*/
+void Display();
+Color4 GetRandomColor(RandomStream &random = threadRandomStream);
+void SeedThreadRandomStream(unsigned int streamIndex);
+void CreateSolarSystem(SolarSystem &system, RenderContext &context);
+void UpdatePlanets(SolarSystem &system, RenderContext &context);
+void UpdateSolarSystem(SolarSystem &system, RenderContext &context);
+void UpdateAsteroids(SolarSystem &system, RenderContext &context);
+void UpdateAsteroidSplats(SolarSystem &system, RenderContext &context);
+void UpdateSpatialGrid(SpatialGrid &spatialGrid, const Triangle &triangle);
+void UpdateSpatialGrid(SpatialGrid &spatialGrid, const TriangleMesh &mesh);
+void UpdateSpatialGrid(SpatialGrid &spatialGrid, const Splat &splat);
+AffineTransform GetAlienPlanetRingsTransform(const SolarSystem &system);
+void TranslateTrianglesInDepthBuffer(RenderContext &context, const std::vector<Triangle *> &triangleVec, const std::vector<Vector3F> &newRelativePositionVec);
+void TranslateMeshInDepthBuffer(RenderContext &context, TriangleMesh &mesh, const Vector3F &newRelativePosition);
+void TransformMeshesInDepthBuffer(RenderContext &context, const std::vector<TriangleMesh *> &meshVec, const std::vector<AffineTransform> &transformVec);
+void TranslateSplatsInDepthBuffer(RenderContext &context, const std::vector<Splat *> &splatVec, const std::vector<Vector3F> &newRelativePositionVec);
+float *NewPixelBuffer();
+unsigned int GetRowsPerBand();
+unsigned int GetRowBandOwner(int row, unsigned int rowCount = WINDOW_HEIGHT);
+int RunKernelBenchmarks();
+int RunGoldenHarness(const char *directory, bool writeGoldens, int tolerance);
+bool WritePPM(const std::string &path, const unsigned char *frame, unsigned int width, unsigned int height);
+int RunHeadless(int frameCount);
+void ReportFragmentUsage();
+bool WriteCheckpoint(const std::string &path, const SolarSystem &system, const RenderContext &context);
+bool ReadCheckpoint(const std::string &path, SolarSystem &system, RenderContext &context);
+void StartSolarSystem();
+void SetRenderRowStep(SolarSystem &system, RenderContext &context, unsigned int rowStep);
+int RunScenes(int sceneCount, int liveSceneCount, int frameCount);
+int RunFrameViewer(const char *name, int frameCount, const char *dumpDirectory);
+//void UpdateTriangleAndDepthBuffer(Triangle &trianlge, const Vector3F &newRelativePosition);
+
+
+/*
+* Functions
+*/
+int main(int argc, char *argv[])
+{
+	//Parse command-line options
+	unsigned int workerCount = 0;
+	const char *storageName = "pixels";
+	const char *presentName = NULL;
+	const char *viewName = NULL, *viewDumpDirectory = NULL;
+	int viewFrameCount = 100;
+	const char *blendName = "alpha";
+	int depthBits = 16;
+	double fragmentBudgetMB = 0.0;
+	int sceneCount = 0;
+	int sceneFrameCount = 100;
+	int liveSceneCount = 4;
+	for (int arg = 1; arg < argc; arg++)
+	{
+		if (strcmp(argv[arg], "--aa") == 0)
+			antiAliasing = true; //Anti-alias edges with per-fragment coverage masks
+		else if (strcmp(argv[arg], "--seed") == 0 && arg + 1 < argc)
+		{
+			randomSeed = strtoull(argv[++arg], NULL, 10);
+			randomSeedGiven = true;
+		}
+		else if (strcmp(argv[arg], "--full-updates") == 0)
+			incrementalUpdates = false; //Always fully mask and re-rasterize moved or static primitives
+		else if (strcmp(argv[arg], "--sort-last") == 0)
+			sortLastRasterization = true; //Rasterize moved primitives in parallel
+		else if (strcmp(argv[arg], "--threads") == 0 && arg + 1 < argc)
+		{
+			int threadCount = atoi(argv[++arg]);
+			if (threadCount < 0)
+			{
+				printf("--threads can't be negative.\n");
+				return 1;
+			}
+			workerCount = threadCount;
+		}
+		else if (strcmp(argv[arg], "--storage") == 0 && arg + 1 < argc)
+			storageName = argv[++arg]; //How fragments are held: a list per pixel, or runs of pixels per row
+		else if (strcmp(argv[arg], "--blend") == 0 && arg + 1 < argc)
+			blendName = argv[++arg]; //How translucent fragments are combined: opaque, alpha or additive
+		else if (strcmp(argv[arg], "--depth-bits") == 0 && arg + 1 < argc)
+			depthBits = atoi(argv[++arg]);
+		else if (strcmp(argv[arg], "--frame-target") == 0 && arg + 1 < argc)
+			resolutionController.SetTarget(atof(argv[++arg])); //In ms, rendering fewer rows to keep frames within it
+		else if (strcmp(argv[arg], "--scenes") == 0 && arg + 1 < argc)
+		{
+			sceneCount = atoi(argv[++arg]); //How many solar systems are rendered, see RunScenes()
+			if (sceneCount < 1)
+			{
+				printf("--scenes needs at least one scene.\n");
+				return 1;
+			}
+		}
+		else if (strcmp(argv[arg], "--scene-frames") == 0 && arg + 1 < argc)
+			sceneFrameCount = atoi(argv[++arg]); //How many frames of each --scenes scene are rendered
+		else if (strcmp(argv[arg], "--live-scenes") == 0 && arg + 1 < argc)
+			liveSceneCount = atoi(argv[++arg]); //How many --scenes scenes are rendered at once, each with its own depth buffer
+		else if (strcmp(argv[arg], "--fragment-budget") == 0 && arg + 1 < argc)
+			fragmentBudgetMB = atof(argv[++arg]); //Merge the farthest fragments rather than let them take more memory than this
+		else if (strcmp(argv[arg], "--present-shm") == 0 && arg + 1 < argc)
+			presentName = argv[++arg]; //Publish every frame to a shared-memory ring, see class SharedFrameRing
+		else if (strcmp(argv[arg], "--view-shm") == 0 && arg + 1 < argc)
+			viewName = argv[++arg]; //Read another process's frames instead of rendering any
+		else if (strcmp(argv[arg], "--view-frames") == 0 && arg + 1 < argc)
+			viewFrameCount = atoi(argv[++arg]);
+		else if (strcmp(argv[arg], "--view-dump") == 0 && arg + 1 < argc)
+			viewDumpDirectory = argv[++arg];
+		else if (strcmp(argv[arg], "--checkpoint") == 0 && arg + 1 < argc)
+			checkpointPath = argv[++arg];
+		else if (strcmp(argv[arg], "--debris") == 0 && arg + 1 < argc)
+		{
+			int debrisCount = atoi(argv[++arg]);
+			if (debrisCount < 0)
+			{
+				printf("--debris can't be negative.\n");
+				return 1;
+			}
+			debrisPerAsteroid = debrisCount;
+		}
+		else if (strcmp(argv[arg], "--restore") == 0 && arg + 1 < argc)
+			restorePath = argv[++arg];
+	}
+
+	if (sceneFrameCount < 1 || liveSceneCount < 1)
+	{
+		printf("--scene-frames and --live-scenes need to be at least 1.\n");
+		return 1;
+	}
+
+	//The viewer only maps the renderer's frames, so it needs none of the renderer's buffers.
+	if (viewName != NULL)
+		return RunFrameViewer(viewName, viewFrameCount, viewDumpDirectory);
+
+	//Seed the random number generator, with the time unless a seed was given
+	if (!randomSeedGiven)
+		randomSeed = (unsigned long long)time(0);
+	SeedThreadRandomStream(0);
+
+	//Each worker seeds its own random stream as it starts, so this comes after the seed.
+	if (workerCount == 0 && (sortLastRasterization || sceneCount != 0))
+		workerCount = std::thread::hardware_concurrency();
+	workerPool.Start(workerCount);
+
+	//Allocate new pixel buffer, once the pool is started so that its bands are first touched by their workers
+	float *pixelBuffer = NewPixelBuffer();
+
+	renderContext.depthBuffer = NewDepthBuffer(storageName, blendName, depthBits, WINDOW_WIDTH, WINDOW_HEIGHT);
+	if (renderContext.depthBuffer == NULL)
+	{
+		printf("There's no %d-bit depth buffer of %s with %s blending.\n", depthBits, storageName, blendName);
+		return 1;
+	}
+	renderContext.depthBuffer->SetPixelBuffer(pixelBuffer);
+	renderContext.depthBuffer->SetFragmentBudget((size_t)(fragmentBudgetMB * 1024.0 * 1024.0));
+	if (presentName != NULL && !presentRing.Create(presentName, WINDOW_WIDTH, WINDOW_HEIGHT))
+	{
+		printf("Couldn't create the shared-memory frame ring %s.\n", presentName);
+		return 1;
+	}
+
+	/*
+	* --bench times each rendering kernel on its own, --golden-write/--golden-check render the
+	* regression scenes, --headless renders the solar system for a number of frames and --scenes
+	* renders a number of solar systems side by side, then they exit without opening a window.
+	*/
+	int goldenTolerance = 2;
+	for (int arg = 1; arg < argc; arg++)
+		if (strcmp(argv[arg], "--golden-tolerance") == 0 && arg + 1 < argc)
+			goldenTolerance = atoi(argv[arg + 1]);
+	for (int arg = 1; arg < argc; arg++)
+	{
+		if (strcmp(argv[arg], "--bench") == 0)
+			return RunKernelBenchmarks();
+		else if (strcmp(argv[arg], "--headless") == 0 && arg + 1 < argc)
+			return RunHeadless(atoi(argv[arg + 1]));
+		else if (strcmp(argv[arg], "--scenes") == 0 && arg + 1 < argc)
+			return RunScenes(sceneCount, liveSceneCount, sceneFrameCount);
+		else if ((strcmp(argv[arg], "--golden-write") == 0 || strcmp(argv[arg], "--golden-check") == 0) && arg + 1 < argc)
+			return RunGoldenHarness(argv[arg + 1], strcmp(argv[arg], "--golden-write") == 0, goldenTolerance);
+	}
+
+	glutInit(&argc, argv);
+	glutInitDisplayMode(GLUT_SINGLE | GLUT_RGB);
+	//Set window size to WINDOW_WIDTH*WINDOW_HEIGHT
+	glutInitWindowSize(WINDOW_WIDTH, WINDOW_HEIGHT);
+	//Set window position
+	glutInitWindowPosition(0, 0);
+
+	//Create and set main window title
+	int mainWindow = glutCreateWindow("Alpha Triangles in a 3D Coordinate System");
+	glClearColor(0, 0, 0, 0); //Clears the buffer of OpenGL; sets the background color to black.
+
+	//Init solar system, from --restore's checkpoint if there is one
+	StartSolarSystem();
+
+	//Sets display function
+	glutDisplayFunc(Display);
+
+	glutMainLoop();//Main display loop, will display until terminate
+	return 0;
+}
+
+
+
+//Main display loop, this function will be called again and again by OpenGL
+void Display()
+{
+	//Misc.
+	glClear(GL_COLOR_BUFFER_BIT);
+	glLoadIdentity();
+
+
+	const int CHECKPOINT_INTERVAL = 300; //Frames between --checkpoint writes
+	for (int frame = 1; ; frame++)
+	{
+		std::chrono::steady_clock::time_point frameStart = std::chrono::steady_clock::now();
+
+		//Display triangles here...
+		//testTriangle.Draw(GetRandomColor());
+		UpdateSolarSystem(solarSystem, renderContext);
+
+		//Resolves the pixel buffer, then draws it and refreshes the window
+		renderContext.depthBuffer->Draw();
+		SetRenderRowStep(solarSystem, renderContext, resolutionController.AddFrame(std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - frameStart).count(), renderContext.depthBuffer->GetRowStep()));
+		if (presentRing.IsOpen())
+			presentRing.Publish(renderContext.depthBuffer->GetPixelBuffer());
+		if (checkpointPath != NULL && frame % CHECKPOINT_INTERVAL == 0 && !WriteCheckpoint(checkpointPath, solarSystem, renderContext))
+			printf("Couldn't write the checkpoint %s.\n", checkpointPath);
+
+		//Sleep(SLEEP_DURATION);
+	}
+}
+
+Color4 GetRandomColor(RandomStream &random)
+{
+	/*
+	* Set R, G, and B to a random number between 0.5 and 1.0, inclusive,
+	* and then return that color.
+	*/
+	float newR = 0.5f + (random.NextInt(501) / 1000.0f);
+	float newG = 0.5f + (random.NextInt(501) / 1000.0f);
+	float newB = 0.5f + (random.NextInt(501) / 1000.0f);
+	float newA = 0.8f + (random.NextInt(201) / 1000.0f);
+	return Color4(newR, newG, newB, newA);
+}
+
+/*
+ * Seeds the calling thread's threadRandomStream from randomSeed. Every thread that draws
+ * random numbers should be given its own streamIndex (the main thread uses 0), so that its
+ * sequence doesn't depend on how threads happen to be scheduled.
+ */
+void SeedThreadRandomStream(unsigned int streamIndex)
+{
+	threadRandomStream.Seed(randomSeed, streamIndex);
+}
+
+//Allocates a window-sized RGB frame with AllocateLargeBuffer(), which its owner frees with FreeLargeBuffer().
+//The frame is zeroed band by band, so each band's pages are first touched by the worker that owns it.
+float *NewPixelBuffer()
+{
+	float *newPixelBuffer = (float *)AllocateLargeBuffer(WINDOW_WIDTH * WINDOW_HEIGHT * 3 * sizeof(float));
+	ForEachRowBand([newPixelBuffer](int firstRow, int lastRow)
+	{
+		memset(newPixelBuffer + firstRow * WINDOW_WIDTH * 3, 0, (lastRow - firstRow) * WINDOW_WIDTH * 3 * sizeof(float));
+	});
+	return newPixelBuffer;
+}
+
+/*
+ * Allocates a large, zeroed buffer that starts on a cache line. It isn't touched here: buffers
+ * that are split into row bands should first be written with ForEachRowBand(), so that each
+ * band's pages are placed on the NUMA node of the worker that owns the band. On Linux the buffer
+ * is mapped straight from the kernel and backed with huge pages where possible, with explicit
+ * (MAP_HUGETLB) pages if the system has any reserved and transparent (MADV_HUGEPAGE) ones
+ * otherwise, since walking a frame through 4 KB pages misses the TLB every few rows.
+ */
+void *AllocateLargeBuffer(size_t bytes)
+{
+#ifdef __linux__
+	size_t mappedBytes = (bytes + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+	void *buffer = mmap(NULL, mappedBytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+	if (buffer != MAP_FAILED)
+		return buffer;
+
+	//Transparent huge pages only back whole, aligned huge pages, so map one extra and unmap the slack around it.
+	char *memory = (char *)mmap(NULL, mappedBytes + HUGE_PAGE_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (memory == (char *)MAP_FAILED)
+		throw std::bad_alloc();
+	size_t headBytes = (HUGE_PAGE_SIZE - (size_t)memory % HUGE_PAGE_SIZE) % HUGE_PAGE_SIZE;
+	if (headBytes != 0)
+		munmap(memory, headBytes);
+	munmap(memory + headBytes + mappedBytes, HUGE_PAGE_SIZE - headBytes);
+	madvise(memory + headBytes, mappedBytes, MADV_HUGEPAGE); //Only a hint; the kernel may not have THP enabled
+	return memory + headBytes;
+#else
+	char *memory = new char[bytes + CACHE_LINE_SIZE]();
+	unsigned char offset = (unsigned char)(CACHE_LINE_SIZE - (size_t)memory % CACHE_LINE_SIZE);
+	memory[offset - 1] = offset; //So that FreeLargeBuffer() can find the start again
+	return memory + offset;
+#endif
+}
+
+//bytes must be the size the buffer was allocated with.
+void FreeLargeBuffer(void *buffer, size_t bytes)
+{
+	if (buffer == NULL)
+		return;
+#ifdef __linux__
+	munmap(buffer, (bytes + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE);
+#else
+	unsigned char *memory = (unsigned char *)buffer;
+	delete[] (char *)(memory - memory[-1]);
+#endif
+}
+
+//The height of each band of rows, which is a multiple of the rows that end on a pixelBuffer cache line boundary.
+unsigned int GetRowsPerBand()
+{
+	const unsigned int MIN_ROWS_PER_BAND = 8;
+	unsigned int rowBytes = WINDOW_WIDTH * 3 * sizeof(float);
+	unsigned int rowsPerLine = 1; //The fewest rows that end on a cache line boundary
+	while ((rowsPerLine * rowBytes) % CACHE_LINE_SIZE != 0)
+		rowsPerLine++;
+	return ((MIN_ROWS_PER_BAND + rowsPerLine - 1) / rowsPerLine) * rowsPerLine;
+}
+
+//Returns the worker that owns row (its home worker, see ForEachRowBand()) with the current pool.
+unsigned int GetRowBandOwner(int row, unsigned int rowCount)
+{
+	unsigned int workerCount = workerPool.GetWorkerCount();
+	unsigned int rowsPerBand = GetRowsPerBand();
+	unsigned int bandCount = (rowCount + rowsPerBand - 1) / rowsPerBand;
+	unsigned int band = row / rowsPerBand;
+	unsigned int owner = 0;
+	while (owner + 1 < workerCount && (owner + 1) * bandCount / workerCount <= band)
+		owner++;
+	return owner;
+}
+
+/*
+ * Runs job on bands of rows covering [0, rowCount), spread across the worker pool. Each worker
+ * owns a contiguous run of bands, which it works through first, so the same rows are touched
+ * by the same worker every time (and stay on its NUMA node, if they were first touched this
+ * way). A worker that runs out of its own bands takes the rest of the other workers' bands.
+ */
+void ForEachRowBand(const std::function<void(int firstRow, int lastRow)> &job, unsigned int rowCount)
+{
+	unsigned int rowsPerBand = GetRowsPerBand();
+	unsigned int workerCount = workerPool.GetWorkerCount();
+	if (workerCount == 1)
+	{
+		job(0, rowCount);
+		return;
+	}
+
+	unsigned int bandCount = (rowCount + rowsPerBand - 1) / rowsPerBand;
+	std::vector<std::atomic<unsigned int> > nextBandVec(workerCount); //The next unclaimed band of each worker's own
+	for (unsigned int worker = 0; worker < workerCount; worker++)
+		nextBandVec[worker].store(worker * bandCount / workerCount, std::memory_order_relaxed);
+	workerPool.Run([&](unsigned int workerIndex)
+	{
+		for (unsigned int offset = 0; offset < workerCount; offset++)
+		{
+			unsigned int owner = (workerIndex + offset) % workerCount;
+			unsigned int endBand = (owner + 1) * bandCount / workerCount;
+			for (unsigned int band = nextBandVec[owner]++; band < endBand; band = nextBandVec[owner]++)
+			{
+				unsigned int firstRow = band * rowsPerBand;
+				job(firstRow, (firstRow + rowsPerBand < rowCount) ? firstRow + rowsPerBand : rowCount);
+			}
+		}
+	});
+}
+
+/*
+ * SetPixel doesn't bounds-check (x, y). Every primitive is clipped against the viewport
+ * once, before rasterization (see ClipScanLineToViewport()), so the pixel loops that
+ * call this function never produce off-screen coordinates.
+ */
+void SetPixel(float *pixelBuffer, int x, int y, const Color3 &color)
+{
+	//Update the pixelBuffer
+	float *pixel = &pixelBuffer[(x + y * WINDOW_WIDTH) * (int)Color3::Num__RGBParameters]; //See pgs. 146-147 to optimize this.
+	pixel[(int)Color3::Red] = color.GetR();
+	pixel[(int)Color3::Green] = color.GetG();
+	pixel[(int)Color3::Blue] = color.GetB();
+
+	//Sleep(SLEEP_DURATION);
+}
+
+//Copies row fromY of pixelBuffer to row toY.
+void CopyPixelRow(float *pixelBuffer, int fromY, int toY)
+{
+	const size_t ROW_FLOATS = WINDOW_WIDTH * (int)Color3::Num__RGBParameters;
+	memcpy(&pixelBuffer[toY * ROW_FLOATS], &pixelBuffer[fromY * ROW_FLOATS], ROW_FLOATS * sizeof(float));
+}
+
+/*
+ * Scissors the scan line [startX, endX) at worldY against the viewport. Returns false if
+ * nothing of the scan line is left onscreen, or the row isn't rendered at context's row step,
+ * in which case it should be skipped entirely.
+ */
+bool ClipScanLineToViewport(const RenderContext &context, int worldY, int &startX, int &endX)
+{
+	if (worldY < 0 || worldY >= (int)WINDOW_HEIGHT || !context.depthBuffer->IsRenderedRow(worldY))
+		return false;
+	startX = (startX < 0) ? 0 : startX;
+	endX = (endX > (int)WINDOW_WIDTH) ? (int)WINDOW_WIDTH : endX;
+	return startX < endX;
+}
+
+/*
+ * For anti-aliasing: sets spanVec to every onscreen pixel that the (convex) polygon given by
+ * vertexArr, translated to position, touches at all, rather than only the pixels whose
+ * sample point it covers. The x-extent of each row of pixels is found by clipping every edge
+ * to the row.
+ */
+void SetConservativeSpans(const RenderContext &context, const Vector3F *vertexArr, unsigned int vertexCount, const Vector3F &position, std::vector<ScanSpan> &spanVec)
+{
+	spanVec.clear();
+	float offsetX = (float)(int)position.GetX();
+	float offsetY = (float)(int)position.GetY();
+
+	float minY = vertexArr[0].GetY(), maxY = vertexArr[0].GetY();
+	for (unsigned int i = 1; i < vertexCount; i++)
+	{
+		minY = (vertexArr[i].GetY() < minY) ? vertexArr[i].GetY() : minY;
+		maxY = (vertexArr[i].GetY() > maxY) ? vertexArr[i].GetY() : maxY;
+	}
+	int firstRow = (int)floor(minY + offsetY);
+	int endRow = (int)ceil(maxY + offsetY);
+	firstRow = (firstRow < 0) ? 0 : firstRow;
+	endRow = (endRow > (int)WINDOW_HEIGHT) ? (int)WINDOW_HEIGHT : endRow;
+
+	for (int worldY = firstRow; worldY < endRow; worldY++)
+	{
+		float rowMinX = (float)WINDOW_WIDTH, rowMaxX = -1.0f;
+		bool touched = false;
+		for (unsigned int i = 0; i < vertexCount; i++)
+		{
+			const Vector3F &current = vertexArr[i];
+			const Vector3F &next = vertexArr[(i + 1) % vertexCount];
+			const Vector3F &lower = (current.GetY() < next.GetY()) ? current : next;
+			const Vector3F &upper = (&lower == &current) ? next : current;
+			float bottomY = (lower.GetY() + offsetY > worldY) ? lower.GetY() + offsetY : (float)worldY;
+			float topY = (upper.GetY() + offsetY < worldY + 1) ? upper.GetY() + offsetY : (float)(worldY + 1);
+			if (bottomY > topY)
+				continue;
+
+			float bottomX, topX;
+			if (upper.GetY() == lower.GetY())
+			{
+				bottomX = lower.GetX() + offsetX;
+				topX = upper.GetX() + offsetX;
+			}
+			else
+			{
+				float inverseSlope = (upper.GetX() - lower.GetX()) / (upper.GetY() - lower.GetY());
+				bottomX = lower.GetX() + offsetX + (bottomY - (lower.GetY() + offsetY)) * inverseSlope;
+				topX = lower.GetX() + offsetX + (topY - (lower.GetY() + offsetY)) * inverseSlope;
+			}
+			rowMinX = (bottomX < rowMinX) ? bottomX : rowMinX;
+			rowMinX = (topX < rowMinX) ? topX : rowMinX;
+			rowMaxX = (bottomX > rowMaxX) ? bottomX : rowMaxX;
+			rowMaxX = (topX > rowMaxX) ? topX : rowMaxX;
+			touched = true;
+		}
+		if (!touched)
+			continue;
+
+		int startX = (int)floor(rowMinX);
+		int endX = (int)ceil(rowMaxX);
+		endX = (endX == startX) ? endX + 1 : endX;
+		if (ClipScanLineToViewport(context, worldY, startX, endX))
+			spanVec.push_back(ScanSpan(worldY, startX, endX));
+	}
+}
+
+/*
+ * Returns which of the COVERAGE_GRID_SIZE*COVERAGE_GRID_SIZE subpixels of pixel (worldX, worldY)
+ * the convex polygon given by vertexArr, translated to position, covers. Bit
+ * (subpixelY * COVERAGE_GRID_SIZE + subpixelX) is set if the subpixel's center is inside
+ * every edge. Pixels whose four corners are all inside are fully covered without testing
+ * each subpixel.
+ */
+unsigned short GetCoverageMask(const Vector3F *vertexArr, unsigned int vertexCount, const Vector3F &position, int worldX, int worldY)
+{
+	//Which side of an edge is "inside" depends on the winding of the vertices.
+	float signedArea = 0.0f;
+	for (unsigned int i = 0; i < vertexCount; i++)
+		signedArea += vertexArr[i].GetX() * vertexArr[(i + 1) % vertexCount].GetY() - vertexArr[(i + 1) % vertexCount].GetX() * vertexArr[i].GetY();
+	float winding = (signedArea < 0.0f) ? -1.0f : 1.0f;
+
+	//Pixel origin relative to the untranslated vertices
+	float pixelX = (float)(worldX - (int)position.GetX());
+	float pixelY = (float)(worldY - (int)position.GetY());
+
+	bool allCornersInside = true;
+	for (unsigned int i = 0; i < vertexCount && allCornersInside; i++)
+	{
+		const Vector3F &current = vertexArr[i];
+		const Vector3F &next = vertexArr[(i + 1) % vertexCount];
+		float edgeX = (next.GetX() - current.GetX()) * winding;
+		float edgeY = (next.GetY() - current.GetY()) * winding;
+		for (int corner = 0; corner < 4; corner++)
+		{
+			float cornerX = pixelX + (corner & 1) - current.GetX();
+			float cornerY = pixelY + (corner >> 1) - current.GetY();
+			if (edgeX * cornerY - edgeY * cornerX < 0.0f)
+			{
+				allCornersInside = false;
+				break;
+			}
+		}
+	}
+	if (allCornersInside)
+		return FULL_COVERAGE;
+
+	unsigned short coverage = 0;
+	for (int subpixelY = 0; subpixelY < COVERAGE_GRID_SIZE; subpixelY++)
+	{
+		for (int subpixelX = 0; subpixelX < COVERAGE_GRID_SIZE; subpixelX++)
+		{
+			float sampleX = pixelX + (subpixelX + 0.5f) / COVERAGE_GRID_SIZE;
+			float sampleY = pixelY + (subpixelY + 0.5f) / COVERAGE_GRID_SIZE;
+			bool inside = true;
+			for (unsigned int i = 0; i < vertexCount && inside; i++)
+			{
+				const Vector3F &current = vertexArr[i];
+				const Vector3F &next = vertexArr[(i + 1) % vertexCount];
+				inside = ((next.GetX() - current.GetX()) * (sampleY - current.GetY()) -
+					(next.GetY() - current.GetY()) * (sampleX - current.GetX())) * winding >= 0.0f;
+			}
+			if (inside)
+				coverage |= 1 << (subpixelY * COVERAGE_GRID_SIZE + subpixelX);
+		}
+	}
+	return coverage;
+}
+
+/*
+ * Sets triangle.coveredSpanVec to the spans it covers at its current relativePosition.
+ *
+ * The triangle is trivially rejected if its bounding box is entirely offscreen. Otherwise
+ * only the range of scan lines is clipped here, along with each scan line's x-pair, so that
+ * the per-pixel loops over coveredSpanVec never have to check bounds.
+ */
+void SetCoveredSpans(const RenderContext &context, Triangle &triangle)
+{
+	triangle.coveredSpanVec.clear();
+	if (antiAliasing)
+	{
+		SetConservativeSpans(context, triangle.vertexArr, 3, triangle.relativePosition, triangle.coveredSpanVec);
+		return;
+	}
+
+	float minX = triangle.vertexArr[0].GetX(), maxX = triangle.vertexArr[0].GetX();
+	for (int i = 1; i < 3; i++)
+	{
+		minX = (triangle.vertexArr[i].GetX() < minX) ? triangle.vertexArr[i].GetX() : minX;
+		maxX = (triangle.vertexArr[i].GetX() > maxX) ? triangle.vertexArr[i].GetX() : maxX;
+	}
+	if (maxX + (int)triangle.relativePosition.GetX() < 0.0f ||
+		minX + (int)triangle.relativePosition.GetX() >= (float)WINDOW_WIDTH)
+		return;
+
+	int baseY = (int)triangle.vertexArr[0].GetY() + (int)triangle.relativePosition.GetY();
+	int firstScanLine = (baseY < 0) ? -baseY : 0;
+	int lastScanLine = (int)WINDOW_HEIGHT - baseY;
+	const std::vector<Vector2I> &relativeXPairVec = triangle.shape->relativeXPairVec;
+	lastScanLine = (lastScanLine > (int)relativeXPairVec.size()) ? (int)relativeXPairVec.size() : lastScanLine;
+
+	int worldY, startX, endX, offsetX;
+	for (int scanLine = firstScanLine; scanLine < lastScanLine; scanLine++)
+	{
+		worldY = baseY + scanLine;
+		offsetX = triangle.GetBaseX(scanLine + (int)triangle.vertexArr[0].GetY()) + (int)triangle.relativePosition.GetX();
+		startX = relativeXPairVec[scanLine].GetX() + offsetX;
+		endX = relativeXPairVec[scanLine].GetY() + offsetX;
+		if (ClipScanLineToViewport(context, worldY, startX, endX))
+			triangle.coveredSpanVec.push_back(ScanSpan(worldY, startX, endX));
+	}
+}
+
+void SetCoveredSpans(const RenderContext &context, Polygon &polygon)
+{
+	polygon.coveredSpanVec.clear();
+	if (antiAliasing)
+	{
+		SetConservativeSpans(context, &polygon.vertexVec[0], polygon.vertexVec.size(), polygon.relativePosition, polygon.coveredSpanVec);
+		return;
+	}
+
+	int worldY, startX, endX;
+	for (unsigned int span = 0; span < polygon.spanVec.size(); span++)
+	{
+		worldY = polygon.spanVec[span].y + (int)polygon.relativePosition.GetY();
+		startX = polygon.spanVec[span].startX + (int)polygon.relativePosition.GetX();
+		endX = polygon.spanVec[span].endX + (int)polygon.relativePosition.GetX();
+		if (ClipScanLineToViewport(context, worldY, startX, endX))
+			polygon.coveredSpanVec.push_back(ScanSpan(worldY, startX, endX));
+	}
+}
+
+//See SetCoveredSpans(Triangle &)
+void SetCoveredSpans(const RenderContext &context, MeshFace &meshFace)
+{
+	meshFace.coveredSpanVec.clear();
+	const Vector3F &position = meshFace.mesh->relativePosition;
+	Vector3F vertexArr[3];
+	meshFace.GetVertices(vertexArr);
+	if (antiAliasing)
+	{
+		SetConservativeSpans(context, vertexArr, 3, position, meshFace.coveredSpanVec);
+		return;
+	}
+
+	float minX = vertexArr[0].GetX(), maxX = vertexArr[0].GetX();
+	for (int i = 1; i < 3; i++)
+	{
+		minX = (vertexArr[i].GetX() < minX) ? vertexArr[i].GetX() : minX;
+		maxX = (vertexArr[i].GetX() > maxX) ? vertexArr[i].GetX() : maxX;
+	}
+	if (maxX + (int)position.GetX() < 0.0f || minX + (int)position.GetX() >= (float)WINDOW_WIDTH)
+		return;
+
+	static thread_local std::vector<Vector2I> xPairVec; //Reused, since faces don't keep their x-pairs
+	int firstY;
+	meshFace.ScanConvert(xPairVec, firstY);
+	int baseY = firstY + (int)position.GetY();
+	int firstScanLine = (baseY < 0) ? -baseY : 0;
+	int lastScanLine = (int)WINDOW_HEIGHT - baseY;
+	lastScanLine = (lastScanLine > (int)xPairVec.size()) ? (int)xPairVec.size() : lastScanLine;
+
+	int worldY, startX, endX;
+	for (int scanLine = firstScanLine; scanLine < lastScanLine; scanLine++)
+	{
+		worldY = baseY + scanLine;
+		startX = xPairVec[scanLine].GetX() + (int)position.GetX();
+		endX = xPairVec[scanLine].GetY() + (int)position.GetX();
+		if (ClipScanLineToViewport(context, worldY, startX, endX))
+			meshFace.coveredSpanVec.push_back(ScanSpan(worldY, startX, endX));
+	}
+}
+
+template <class Primitive>
+void InsertPixels(RenderContext &context, const Primitive &primitive, int worldY, int startX, int endX)
+{
+	int worldZArr[SPAN_CHUNK_SIZE];
+	unsigned short coverageArr[SPAN_CHUNK_SIZE];
+	for (int chunkStartX = startX; chunkStartX < endX; chunkStartX += SPAN_CHUNK_SIZE)
+	{
+		int chunkEndX = (chunkStartX + SPAN_CHUNK_SIZE < endX) ? chunkStartX + SPAN_CHUNK_SIZE : endX;
+		for (int worldX = chunkStartX; worldX < chunkEndX; worldX++)
+		{
+			worldZArr[worldX - chunkStartX] = primitive.GetWorldZ(worldX, worldY);
+			coverageArr[worldX - chunkStartX] = primitive.GetCoverage(worldX, worldY);
+		}
+		context.depthBuffer->InsertSpan(worldY, chunkStartX, chunkEndX, worldZArr, coverageArr, primitive.color, primitive.primitiveId);
+	}
+}
+
+template <class Primitive>
+void RemovePixels(RenderContext &context, const Primitive &primitive, const Vector3F &oldRelativePosition, int worldY, int startX, int endX)
+{
+	int worldZArr[SPAN_CHUNK_SIZE];
+	for (int chunkStartX = startX; chunkStartX < endX; chunkStartX += SPAN_CHUNK_SIZE)
+	{
+		int chunkEndX = (chunkStartX + SPAN_CHUNK_SIZE < endX) ? chunkStartX + SPAN_CHUNK_SIZE : endX;
+		for (int worldX = chunkStartX; worldX < chunkEndX; worldX++)
+			worldZArr[worldX - chunkStartX] = primitive.GetWorldZ(worldX, worldY, oldRelativePosition);
+		context.depthBuffer->RemoveSpan(worldY, chunkStartX, chunkEndX, worldZArr, primitive.primitiveId);
+	}
+}
+
+//Moves the fragments of pixels [startX, endX) of row worldY, which the primitive covers at both positions.
+template <class Primitive>
+void MovePixels(RenderContext &context, const Primitive &primitive, const Vector3F &oldRelativePosition, int worldY, int startX, int endX)
+{
+	int oldWorldZArr[SPAN_CHUNK_SIZE], newWorldZArr[SPAN_CHUNK_SIZE];
+	unsigned short oldCoverageArr[SPAN_CHUNK_SIZE], newCoverageArr[SPAN_CHUNK_SIZE];
+	for (int chunkStartX = startX; chunkStartX < endX; chunkStartX += SPAN_CHUNK_SIZE)
+	{
+		int chunkEndX = (chunkStartX + SPAN_CHUNK_SIZE < endX) ? chunkStartX + SPAN_CHUNK_SIZE : endX;
+		for (int worldX = chunkStartX; worldX < chunkEndX; worldX++)
+		{
+			oldWorldZArr[worldX - chunkStartX] = primitive.GetWorldZ(worldX, worldY, oldRelativePosition);
+			newWorldZArr[worldX - chunkStartX] = primitive.GetWorldZ(worldX, worldY);
+			oldCoverageArr[worldX - chunkStartX] = primitive.GetCoverage(worldX, worldY, oldRelativePosition);
+			newCoverageArr[worldX - chunkStartX] = primitive.GetCoverage(worldX, worldY);
+		}
+		context.depthBuffer->MoveSpan(worldY, chunkStartX, chunkEndX, oldWorldZArr, newWorldZArr, oldCoverageArr, newCoverageArr,
+			primitive.color, primitive.primitiveId);
+	}
+}
+
+/*
+ * Moves a primitive that is resident in the depth buffer from oldSpanVec (rasterized at
+ * oldRelativePosition) to its current coveredSpanVec, touching only the pixels that changed.
+ * Scan line by scan line, pixels only the old coverage has are removed, pixels only the new
+ * coverage has are inserted, and pixels both have are only touched if their depth changed.
+ */
+template <class Primitive>
+void UpdateCoverageDelta(RenderContext &context, const Primitive &primitive, const std::vector<ScanSpan> &oldSpanVec, const Vector3F &oldRelativePosition)
+{
+	const std::vector<ScanSpan> &newSpanVec = primitive.coveredSpanVec;
+	unsigned int oldSpan = 0, newSpan = 0;
+	while (oldSpan < oldSpanVec.size() || newSpan < newSpanVec.size())
+	{
+		//Gather the old and new spans on the lowest scan line left.
+		int worldY;
+		if (oldSpan == oldSpanVec.size())
+			worldY = newSpanVec[newSpan].y;
+		else if (newSpan == newSpanVec.size())
+			worldY = oldSpanVec[oldSpan].y;
+		else
+			worldY = (oldSpanVec[oldSpan].y < newSpanVec[newSpan].y) ? oldSpanVec[oldSpan].y : newSpanVec[newSpan].y;
+
+		unsigned int oldRowEnd = oldSpan, newRowEnd = newSpan;
+		while (oldRowEnd < oldSpanVec.size() && oldSpanVec[oldRowEnd].y == worldY)
+			oldRowEnd++;
+		while (newRowEnd < newSpanVec.size() && newSpanVec[newRowEnd].y == worldY)
+			newRowEnd++;
+
+		if (oldRowEnd - oldSpan == 1 && newRowEnd - newSpan == 1)
+		{
+			int oldStartX = oldSpanVec[oldSpan].startX, oldEndX = oldSpanVec[oldSpan].endX;
+			int newStartX = newSpanVec[newSpan].startX, newEndX = newSpanVec[newSpan].endX;
+
+			//Only covered before: [oldStartX, newStartX) and [newEndX, oldEndX)
+			RemovePixels(context, primitive, oldRelativePosition, worldY, oldStartX, (oldEndX < newStartX) ? oldEndX : newStartX);
+			RemovePixels(context, primitive, oldRelativePosition, worldY, (oldStartX > newEndX) ? oldStartX : newEndX, oldEndX);
+
+			//Only covered now: [newStartX, oldStartX) and [oldEndX, newEndX)
+			InsertPixels(context, primitive, worldY, newStartX, (newEndX < oldStartX) ? newEndX : oldStartX);
+			InsertPixels(context, primitive, worldY, (newStartX > oldEndX) ? newStartX : oldEndX, newEndX);
+
+			//Covered by both
+			MovePixels(context, primitive, oldRelativePosition, worldY, (oldStartX > newStartX) ? oldStartX : newStartX,
+				(oldEndX < newEndX) ? oldEndX : newEndX);
+		}
+		else
+		{
+			//A scan line that's empty on one side, or has several spans (non-convex polygons), is simply redone.
+			for (unsigned int span = oldSpan; span < oldRowEnd; span++)
+				RemovePixels(context, primitive, oldRelativePosition, worldY, oldSpanVec[span].startX, oldSpanVec[span].endX);
+			for (unsigned int span = newSpan; span < newRowEnd; span++)
+				InsertPixels(context, primitive, worldY, newSpanVec[span].startX, newSpanVec[span].endX);
+		}
+
+		oldSpan = oldRowEnd;
+		newSpan = newRowEnd;
+	}
+}
+
+/*
+ * Sort-last rasterization of a batch of primitives whose relativePositions are already set,
+ * and none of which are resident. The workers first find every primitive's covered spans,
+ * then share out the spans of the whole batch, so a few huge primitives are split up as well
+ * as many small ones. Their fragments are appended to fragmentStore without locking, and are
+ * only sorted into the depth buffer once every worker is done.
+ */
+void ResolveSortLastSpans(RenderContext &context, std::vector<ScanSpan> &batchSpanVec);
+
+template <class Primitive>
+void RasterizeSortLast(RenderContext &context, const std::vector<Primitive *> &primitiveVec)
+{
+	const unsigned int SPANS_PER_CLAIM = 8;
+	std::atomic<unsigned int> nextPrimitive(0);
+	workerPool.Run([&](unsigned int /*workerIndex*/)
+	{
+		for (unsigned int primitive = nextPrimitive++; primitive < primitiveVec.size(); primitive = nextPrimitive++)
+		{
+			primitiveVec[primitive]->dirty = false;
+			SetCoveredSpans(context, *primitiveVec[primitive]);
+		}
+	});
+
+	//List every span in the batch, and size the pool for the worst case so appending never fails.
+	std::vector<std::pair<unsigned int, unsigned int> > spanRefVec; //(primitive, span)
+	unsigned int pixelCount = 0;
+	for (unsigned int primitive = 0; primitive < primitiveVec.size(); primitive++)
+	{
+		const std::vector<ScanSpan> &spanVec = primitiveVec[primitive]->coveredSpanVec;
+		for (unsigned int span = 0; span < spanVec.size(); span++)
+		{
+			spanRefVec.push_back(std::make_pair(primitive, span));
+			pixelCount += spanVec[span].endX - spanVec[span].startX;
+		}
+	}
+	context.fragmentStore->Reset(pixelCount);
+
+	std::atomic<unsigned int> nextSpan(0);
+	workerPool.Run([&](unsigned int /*workerIndex*/)
+	{
+		for (unsigned int firstSpan = nextSpan.fetch_add(SPANS_PER_CLAIM); firstSpan < spanRefVec.size();
+			firstSpan = nextSpan.fetch_add(SPANS_PER_CLAIM))
+		{
+			unsigned int lastSpan = (firstSpan + SPANS_PER_CLAIM < spanRefVec.size()) ? firstSpan + SPANS_PER_CLAIM : spanRefVec.size();
+			for (unsigned int spanRef = firstSpan; spanRef < lastSpan; spanRef++)
+			{
+				const Primitive &primitive = *primitiveVec[spanRefVec[spanRef].first];
+				const ScanSpan &span = primitive.coveredSpanVec[spanRefVec[spanRef].second];
+				for (int worldX = span.startX; worldX < span.endX; worldX++)
+				{
+					unsigned short coverage = primitive.GetCoverage(worldX, span.y);
+					if (coverage != 0)
+						context.fragmentStore->Append(worldX, span.y, primitive.GetWorldZ(worldX, span.y), primitive.color, primitive.primitiveId, coverage);
+				}
+			}
+		}
+	});
+
+	std::vector<ScanSpan> batchSpanVec;
+	for (unsigned int spanRef = 0; spanRef < spanRefVec.size(); spanRef++)
+		batchSpanVec.push_back(primitiveVec[spanRefVec[spanRef].first]->coveredSpanVec[spanRefVec[spanRef].second]);
+	ResolveSortLastSpans(context, batchSpanVec);
+}
+
+/*
+ * Sorts the fragments of a sort-last batch, covering batchSpanVec, into the depth buffer. Each
+ * band of rows resolves the spans on its own rows, so no two workers ever touch the same pixel.
+ * Pixels covered by several primitives are resolved the first time they're visited.
+ */
+void ResolveSortLastSpans(RenderContext &context, std::vector<ScanSpan> &batchSpanVec)
+{
+	std::sort(batchSpanVec.begin(), batchSpanVec.end(), [](const ScanSpan &a, const ScanSpan &b) { return a.y < b.y; });
+	ForEachRowBand([&](int firstRow, int lastRow)
+	{
+		std::vector<ScanSpan>::const_iterator span = std::lower_bound(batchSpanVec.begin(), batchSpanVec.end(), firstRow,
+			[](const ScanSpan &a, int y) { return a.y < y; });
+		for (; span != batchSpanVec.end() && span->y < lastRow; ++span)
+			context.depthBuffer->ResolveFragmentSpan(*context.fragmentStore, span->y, span->startX, span->endX);
+	});
+}
+
+/*
+ * Rasterizes a batch of splats whose relativePositions are already set, and none of which are
+ * resident. With sortLastRasterization, the workers append their pixels straight to
+ * fragmentStore, with no spans to set up first, and only the rows they produced are resolved.
+ */
+void RasterizeSplats(RenderContext &context, const std::vector<Splat *> &splatVec)
+{
+	const unsigned int SPLATS_PER_CLAIM = 64;
+	if (!sortLastRasterization)
+	{
+		int startX, startY, endX, endY;
+		for (unsigned int splat = 0; splat < splatVec.size(); splat++)
+		{
+			splatVec[splat]->dirty = false;
+			if (splatVec[splat]->GetFootprint(splatVec[splat]->relativePosition, startX, startY, endX, endY))
+				for (int worldY = startY; worldY < endY; worldY++)
+					if (context.depthBuffer->IsRenderedRow(worldY))
+						InsertPixels(context, *splatVec[splat], worldY, startX, endX);
+		}
+		return;
+	}
+
+	//One span per row of each splat, which also sizes the pool so appending never fails
+	std::vector<ScanSpan> batchSpanVec;
+	unsigned int pixelCount = 0;
+	int startX, startY, endX, endY;
+	for (unsigned int splat = 0; splat < splatVec.size(); splat++)
+	{
+		splatVec[splat]->dirty = false;
+		if (!splatVec[splat]->GetFootprint(splatVec[splat]->relativePosition, startX, startY, endX, endY))
+			continue;
+		for (int worldY = startY; worldY < endY; worldY++)
+			if (context.depthBuffer->IsRenderedRow(worldY))
+				batchSpanVec.push_back(ScanSpan(worldY, startX, endX));
+		pixelCount += (endX - startX) * (endY - startY);
+	}
+	context.fragmentStore->Reset(pixelCount);
+
+	std::atomic<unsigned int> nextSplat(0);
+	workerPool.Run([&](unsigned int /*workerIndex*/)
+	{
+		for (unsigned int firstSplat = nextSplat.fetch_add(SPLATS_PER_CLAIM); firstSplat < splatVec.size();
+			firstSplat = nextSplat.fetch_add(SPLATS_PER_CLAIM))
+		{
+			unsigned int lastSplat = (firstSplat + SPLATS_PER_CLAIM < splatVec.size()) ? firstSplat + SPLATS_PER_CLAIM : splatVec.size();
+			for (unsigned int splat = firstSplat; splat < lastSplat; splat++)
+			{
+				const Splat &current = *splatVec[splat];
+				int startX, startY, endX, endY;
+				if (!current.GetFootprint(current.relativePosition, startX, startY, endX, endY))
+					continue;
+				for (int worldY = startY; worldY < endY; worldY++)
+				{
+					if (!context.depthBuffer->IsRenderedRow(worldY))
+						continue;
+					for (int worldX = startX; worldX < endX; worldX++)
+						context.fragmentStore->Append(worldX, worldY, current.GetWorldZ(worldX, worldY), current.color, current.primitiveId, FULL_COVERAGE);
+				}
+			}
+		}
+	});
+	ResolveSortLastSpans(context, batchSpanVec);
+}
+
+void UpdateTriangleAndDepthBuffer(RenderContext &context, Triangle &triangle, const Vector3F &newRelativePosition)
+{
+	//A triangle that is still resident at the same position doesn't need to be touched.
+	if (incrementalUpdates && !triangle.dirty && newRelativePosition == triangle.relativePosition)
+		return;
+	triangle.dirty = false;
+
+	triangle.relativePosition = newRelativePosition;
+	SetCoveredSpans(context, triangle);
+	for (unsigned int span = 0; span < triangle.coveredSpanVec.size(); span++)
+		InsertPixels(context, triangle, triangle.coveredSpanVec[span].y, triangle.coveredSpanVec[span].startX, triangle.coveredSpanVec[span].endX);
+}
+
+void UpdatePolygonAndDepthBuffer(RenderContext &context, Polygon &polygon, const Vector3F &newRelativePosition)
+{
+	if (incrementalUpdates && !polygon.dirty && newRelativePosition == polygon.relativePosition)
+		return;
+	polygon.dirty = false;
+
+	polygon.relativePosition = newRelativePosition;
+	SetCoveredSpans(context, polygon);
+	for (unsigned int span = 0; span < polygon.coveredSpanVec.size(); span++)
+		InsertPixels(context, polygon, polygon.coveredSpanVec[span].y, polygon.coveredSpanVec[span].startX, polygon.coveredSpanVec[span].endX);
+}
+
+//Rasterizes a batch of mesh faces, none of which are resident: with sortLastRasterization, in parallel.
+void RasterizeMeshFaces(RenderContext &context, const std::vector<MeshFace *> &faceVec)
+{
+	if (sortLastRasterization)
+	{
+		RasterizeSortLast(context, faceVec);
+		return;
+	}
+	for (unsigned int face = 0; face < faceVec.size(); face++)
+	{
+		faceVec[face]->dirty = false;
+		SetCoveredSpans(context, *faceVec[face]);
+		for (unsigned int span = 0; span < faceVec[face]->coveredSpanVec.size(); span++)
+			InsertPixels(context, *faceVec[face], faceVec[face]->coveredSpanVec[span].y, faceVec[face]->coveredSpanVec[span].startX, faceVec[face]->coveredSpanVec[span].endX);
+	}
+}
+
+/*
+ * Rasterizes a mesh at newRelativePosition, skipping faces that are still resident there. The
+ * faces are rasterized as one batch.
+ */
+void UpdateMeshAndDepthBuffer(RenderContext &context, TriangleMesh &mesh, const Vector3F &newRelativePosition)
+{
+	bool moved = !(newRelativePosition == mesh.relativePosition);
+	mesh.relativePosition = newRelativePosition;
+	std::vector<MeshFace *> faceVec;
+	for (unsigned int face = 0; face < mesh.faceVec.size(); face++)
+		if (!incrementalUpdates || mesh.faceVec[face].dirty || moved)
+			faceVec.push_back(&mesh.faceVec[face]);
+	RasterizeMeshFaces(context, faceVec);
+}
+
+
+/*
+ * Moves a triangle to newRelativePosition. If the triangle is resident in the depth buffer,
+ * only the difference between its old and new coverage is updated, so the cost scales with
+ * how far it moved rather than with its area.
+ */
+void TranslateTriangleInDepthBuffer(RenderContext &context, Triangle &triangle, const Vector3F &newRelativePosition)
+{
+	if (triangle.dirty || !incrementalUpdates)
+	{
+		context.depthBuffer->MaskBuffers(triangle);
+		UpdateTriangleAndDepthBuffer(context, triangle, newRelativePosition);
+		return;
+	}
+
+	Vector3F oldRelativePosition = triangle.relativePosition;
+	std::vector<ScanSpan> oldSpanVec;
+	oldSpanVec.swap(triangle.coveredSpanVec);
+
+	triangle.relativePosition = newRelativePosition;
+	SetCoveredSpans(context, triangle);
+	UpdateCoverageDelta(context, triangle, oldSpanVec, oldRelativePosition);
+}
+
+/*
+ * Moves a batch of triangles at once. With sortLastRasterization, every triangle that moved is
+ * masked, then the whole batch is re-rasterized in parallel. Otherwise each one is translated
+ * in turn.
+ */
+void TranslateTrianglesInDepthBuffer(RenderContext &context, const std::vector<Triangle *> &triangleVec, const std::vector<Vector3F> &newRelativePositionVec)
+{
+	if (!sortLastRasterization)
+	{
+		for (unsigned int triangle = 0; triangle < triangleVec.size(); triangle++)
+			TranslateTriangleInDepthBuffer(context, *triangleVec[triangle], newRelativePositionVec[triangle]);
+		return;
+	}
+
+	std::vector<Triangle *> movedTriangleVec;
+	for (unsigned int triangle = 0; triangle < triangleVec.size(); triangle++)
+	{
+		if (incrementalUpdates && !triangleVec[triangle]->dirty && newRelativePositionVec[triangle] == triangleVec[triangle]->relativePosition)
+			continue;
+		context.depthBuffer->MaskBuffers(*triangleVec[triangle]);
+		triangleVec[triangle]->relativePosition = newRelativePositionVec[triangle];
+		movedTriangleVec.push_back(triangleVec[triangle]);
+	}
+	RasterizeSortLast(context, movedTriangleVec);
+}
+
+void TranslatePolygonInDepthBuffer(RenderContext &context, Polygon &polygon, const Vector3F &newRelativePosition)
+{
+	if (polygon.dirty || !incrementalUpdates)
+	{
+		context.depthBuffer->MaskBuffers(polygon);
+		UpdatePolygonAndDepthBuffer(context, polygon, newRelativePosition);
+		return;
+	}
+
+	Vector3F oldRelativePosition = polygon.relativePosition;
+	std::vector<ScanSpan> oldSpanVec;
+	oldSpanVec.swap(polygon.coveredSpanVec);
+
+	polygon.relativePosition = newRelativePosition;
+	SetCoveredSpans(context, polygon);
+	UpdateCoverageDelta(context, polygon, oldSpanVec, oldRelativePosition);
+}
+
+/*
+ * Moves a mesh to newRelativePosition. Like TranslateTriangleInDepthBuffer(), each resident face
+ * only has the difference between its old and new coverage updated. With sortLastRasterization
+ * the whole mesh is masked and re-rasterized as one batch instead.
+ */
+void TranslateMeshInDepthBuffer(RenderContext &context, TriangleMesh &mesh, const Vector3F &newRelativePosition)
+{
+	if (sortLastRasterization || !incrementalUpdates)
+	{
+		if (!incrementalUpdates || !(newRelativePosition == mesh.relativePosition))
+			context.depthBuffer->MaskBuffers(mesh);
+		UpdateMeshAndDepthBuffer(context, mesh, newRelativePosition);
+		return;
+	}
+
+	//Faces that aren't resident are masked at the old position, and inserted at the new one.
+	for (unsigned int face = 0; face < mesh.faceVec.size(); face++)
+		if (mesh.faceVec[face].dirty)
+			context.depthBuffer->MaskBuffers(mesh.faceVec[face]);
+
+	Vector3F oldRelativePosition = mesh.relativePosition;
+	mesh.relativePosition = newRelativePosition;
+	std::vector<ScanSpan> oldSpanVec;
+	for (unsigned int face = 0; face < mesh.faceVec.size(); face++)
+	{
+		MeshFace &meshFace = mesh.faceVec[face];
+		if (meshFace.dirty)
+		{
+			meshFace.dirty = false;
+			SetCoveredSpans(context, meshFace);
+			for (unsigned int span = 0; span < meshFace.coveredSpanVec.size(); span++)
+				InsertPixels(context, meshFace, meshFace.coveredSpanVec[span].y, meshFace.coveredSpanVec[span].startX, meshFace.coveredSpanVec[span].endX);
+			continue;
+		}
+		if (newRelativePosition == oldRelativePosition)
+			continue;
+
+		oldSpanVec.clear();
+		oldSpanVec.swap(meshFace.coveredSpanVec);
+		SetCoveredSpans(context, meshFace);
+		UpdateCoverageDelta(context, meshFace, oldSpanVec, oldRelativePosition);
+	}
+}
+
+/*
+ * The transform stage: moves each mesh in meshVec to its transform in transformVec, which can
+ * rotate, scale and shear it as well as move it. Meshes whose transform changed are masked
+ * out, then the workers share them out to transform their vertices in SIMD batches and set up
+ * their faces again, and finally every face that isn't resident, from every mesh, is rasterized
+ * as one batch.
+ */
+void TransformMeshesInDepthBuffer(RenderContext &context, const std::vector<TriangleMesh *> &meshVec, const std::vector<AffineTransform> &transformVec)
+{
+	std::vector<unsigned int> changedVec;
+	for (unsigned int mesh = 0; mesh < meshVec.size(); mesh++)
+	{
+		if (incrementalUpdates && transformVec[mesh] == meshVec[mesh]->transform)
+			continue;
+		context.depthBuffer->MaskBuffers(*meshVec[mesh]);
+		changedVec.push_back(mesh);
+	}
+
+	std::atomic<unsigned int> nextChanged(0);
+	workerPool.Run([&](unsigned int /*workerIndex*/)
+	{
+		for (unsigned int changed = nextChanged++; changed < changedVec.size(); changed = nextChanged++)
+			meshVec[changedVec[changed]]->SetTransform(transformVec[changedVec[changed]]);
+	});
+
+	std::vector<MeshFace *> faceVec;
+	for (unsigned int mesh = 0; mesh < meshVec.size(); mesh++)
+		for (unsigned int face = 0; face < meshVec[mesh]->faceVec.size(); face++)
+			if (meshVec[mesh]->faceVec[face].dirty)
+				faceVec.push_back(&meshVec[mesh]->faceVec[face]);
+	RasterizeMeshFaces(context, faceVec);
+}
+
+/*
+ * Moves each splat in splatVec to its position in newRelativePositionVec. Splats are too small
+ * for a delta update to pay off, so the ones that moved (or aren't resident) are simply masked
+ * out and rasterized again, as one batch.
+ */
+void TranslateSplatsInDepthBuffer(RenderContext &context, const std::vector<Splat *> &splatVec, const std::vector<Vector3F> &newRelativePositionVec)
+{
+	std::vector<Splat *> movedSplatVec;
+	for (unsigned int splat = 0; splat < splatVec.size(); splat++)
+	{
+		if (incrementalUpdates && !splatVec[splat]->dirty && newRelativePositionVec[splat] == splatVec[splat]->relativePosition)
+			continue;
+		context.depthBuffer->MaskBuffers(*splatVec[splat]);
+		splatVec[splat]->relativePosition = newRelativePositionVec[splat];
+		movedSplatVec.push_back(splatVec[splat]);
+	}
+	RasterizeSplats(context, movedSplatVec);
+}
+
+
+
+
+
+
+void CreateSolarSystem(SolarSystem &system, RenderContext &context)
+{
+	system.sun = Triangle(context, Color4(1.0f, 1.0f, 0.0f, 0.95f),
+		Vector3F(WINDOW_WIDTH / 2 - 50, WINDOW_HEIGHT / 2 - 50, -1.0f),
+		Vector3F(WINDOW_WIDTH / 2 + 50, WINDOW_HEIGHT / 2 - 30, -1.0f),
+		Vector3F(WINDOW_WIDTH / 2, WINDOW_HEIGHT / 2 + 20, -1.0f));
+
+	//Mercury
+	system.planetVec.push_back(Triangle(context, Color4(8.0f, 0.1f, 0.3f, 0.95f),
+		Vector3F(WINDOW_WIDTH / 2 - 20, WINDOW_HEIGHT / 2, -2.0f),
+		Vector3F(WINDOW_WIDTH / 2 + 10, WINDOW_HEIGHT / 2 - 20, -2.0f),
+		Vector3F(WINDOW_WIDTH / 2 + 35, WINDOW_HEIGHT / 2 + 30, -2.0f)));
+
+
+	////Venus
+	system.planetVec.push_back(Triangle(context, Color4(139 / 255.0f, 69 / 255.0f, 16 / 255.0f, 0.95f),
+		Vector3F(WINDOW_WIDTH / 2 - 15, WINDOW_HEIGHT / 2 - 10, -3.0f),
+		Vector3F(WINDOW_WIDTH / 2 + 5, WINDOW_HEIGHT / 2 - 5, -3.0f),
+		Vector3F(WINDOW_WIDTH / 2 + 25, WINDOW_HEIGHT / 2 + 40, -3.0f)));
+
+	////Earth
+	system.planetVec.push_back(Triangle(context, Color4(0.0f, 1.0f, 0.8f, 0.95f),
+		Vector3F(WINDOW_WIDTH / 2 - 20, WINDOW_HEIGHT / 2, -4.0f),
+		Vector3F(WINDOW_WIDTH / 2 + 10, WINDOW_HEIGHT / 2 - 20, -4.0f),
+		Vector3F(WINDOW_WIDTH / 2 + 35, WINDOW_HEIGHT / 2 + 30, -4.0f)));
+
+	////Mars
+	system.planetVec.push_back(Triangle(context, Color4(1.0f, 0.0f, 0.0f, 0.95f),
+		Vector3F(WINDOW_WIDTH / 2 - 10, WINDOW_HEIGHT / 2 - 10, -5.0f),
+		Vector3F(WINDOW_WIDTH / 2 + 5, WINDOW_HEIGHT / 2 + 15, -5.0f),
+		Vector3F(WINDOW_WIDTH / 2 + 15, WINDOW_HEIGHT / 2 + 10, -5.0f)));
+
+	//Jupiter
+	system.planetVec.push_back(Triangle(context, Color4(244 / 255.0f, 164 / 255.0f, 96 / 255.0f, 0.95f),
+		Vector3F(WINDOW_WIDTH / 2 - 35, WINDOW_HEIGHT / 2 - 35, -6.0f),
+		Vector3F(WINDOW_WIDTH / 2 + 35, WINDOW_HEIGHT / 2, -6.0f),
+		Vector3F(WINDOW_WIDTH / 2, WINDOW_HEIGHT / 2 + 33, -6.0f)));
+
+	//Saturn
+	system.planetVec.push_back(Triangle(context, Color4(218 / 255.0f, 165 / 255.0f, 32 / 255.0f, 0.95f),
+		Vector3F(WINDOW_WIDTH / 2 - 30, WINDOW_HEIGHT / 2 + 5, -7.0f),
+		Vector3F(WINDOW_WIDTH / 2 + 25, WINDOW_HEIGHT / 2 - 30, -7.0f),
+		Vector3F(WINDOW_WIDTH / 2 + 10, WINDOW_HEIGHT / 2 + 28, -7.0f)));
+
+	////Uranus
+	//planetVec.push_back(Triangle(Color4(0.2f, 0.7f, 1.0f, 0.95f),
+	//	Vector3F(WINDOW_WIDTH / 2 - 20, WINDOW_HEIGHT / 2, -8.0f),
+	//	Vector3F(WINDOW_WIDTH / 2 + 10, WINDOW_HEIGHT / 2 - 20, -8.0f),
+	//	Vector3F(WINDOW_WIDTH / 2 + 35, WINDOW_HEIGHT / 2 + 30, -8.0f)));
+
+	//////Neptune
+	//planetVec.push_back(Triangle(Color4(0.1f, 0.5f, 0.8f, 0.95f),
+	//	Vector3F(WINDOW_WIDTH / 2 - 15, WINDOW_HEIGHT / 2 - 10, -9.0f),
+	//	Vector3F(WINDOW_WIDTH / 2 + 5, WINDOW_HEIGHT / 2 - 5, -9.0f),
+	//	Vector3F(WINDOW_WIDTH / 2 + 25, WINDOW_HEIGHT / 2 + 40, -9.0f)));
+
+	////Pluto
+	//planetVec.push_back(Triangle(Color4(0.7f, 0.7f, 1.0f, 0.95f),
+	//	Vector3F(WINDOW_WIDTH / 2 - 10, WINDOW_HEIGHT / 2 - 5, -10.0f),
+	//	Vector3F(WINDOW_WIDTH / 2 + 5, WINDOW_HEIGHT / 2 + 5, -10.0f),
+	//	Vector3F(WINDOW_WIDTH / 2 + 15, WINDOW_HEIGHT / 2 + 10, -10.0f)));
+
+
+	//Create alien planet
+	system.alienPlanet = Triangle(context, Color4(120 / 255.0f, 81 / 255.0f, 169 / 255.0f, 1.0f),
+		Vector3F(50, 0, -30.0f),
+		Vector3F(100, 150, -30.0f),
+		Vector3F(75, WINDOW_HEIGHT - 1, 0.0f));
+
+	//Create the alien planet's rings: an annulus whose faces share their vertices, tilted by its transform
+	const float PI = 3.14159f;
+	const int RING_SEGMENTS = 24;
+	std::vector<Vector3F> ringVertexVec;
+	std::vector<unsigned int> ringIndexVec;
+	for (int segment = 0; segment < RING_SEGMENTS; segment++)
+	{
+		float angle = segment * (2 * PI / RING_SEGMENTS);
+		ringVertexVec.push_back(Vector3F(70.0f * cos(angle), 70.0f * sin(angle), 0.0f));
+		ringVertexVec.push_back(Vector3F(50.0f * cos(angle), 50.0f * sin(angle), 0.0f));
+	}
+	for (int segment = 0; segment < RING_SEGMENTS; segment++)
+	{
+		unsigned int outer = segment * 2, inner = segment * 2 + 1;
+		unsigned int nextOuter = ((segment + 1) % RING_SEGMENTS) * 2, nextInner = nextOuter + 1;
+		unsigned int quadArr[6] = { outer, nextOuter, inner, inner, nextOuter, nextInner };
+		ringIndexVec.insert(ringIndexVec.end(), quadArr, quadArr + 6);
+	}
+	system.alienPlanetRings = TriangleMesh(context, Color4(200 / 255.0f, 180 / 255.0f, 1.0f, 0.6f), ringVertexVec, ringIndexVec, GetAlienPlanetRingsTransform(system));
+
+	UpdateSpatialGrid(system.spatialGrid, system.sun);
+	for (unsigned int planet = 0; planet < system.planetVec.size(); planet++)
+		UpdateSpatialGrid(system.spatialGrid, system.planetVec[planet]);
+	UpdateSpatialGrid(system.spatialGrid, system.alienPlanet);
+	UpdateSpatialGrid(system.spatialGrid, system.alienPlanetRings);
+}
+
+//The alien planet's rings spin, and slowly wobble about their tilt, as theta advances.
+AffineTransform GetAlienPlanetRingsTransform(const SolarSystem &system)
+{
+	const float TILT = 1.1f; //Seen at a steep angle
+	return AffineTransform::Translation(Vector3F(75.0f, 300.0f, -15.0f)) * AffineTransform::Scale(1.0f, 1.0f, 0.2f) *
+		AffineTransform::RotationX(TILT + 0.08f * sin(system.theta * 5)) * AffineTransform::RotationZ(system.theta * 2);
+}
+
+void UpdateSpatialGrid(SpatialGrid &spatialGrid, const Triangle &triangle)
+{
+	Vector2F minCorner, maxCorner;
+	triangle.GetBounds(minCorner, maxCorner);
+	spatialGrid.Update(triangle.primitiveId, minCorner, maxCorner);
+}
+
+void UpdateSpatialGrid(SpatialGrid &spatialGrid, const TriangleMesh &mesh)
+{
+	Vector2F minCorner, maxCorner;
+	mesh.GetBounds(minCorner, maxCorner);
+	spatialGrid.Update(mesh.GetPrimitiveId(), minCorner, maxCorner);
+}
+
+void UpdateSpatialGrid(SpatialGrid &spatialGrid, const Splat &splat)
+{
+	Vector2F minCorner, maxCorner;
+	splat.GetBounds(minCorner, maxCorner);
+	spatialGrid.Update(splat.primitiveId, minCorner, maxCorner);
+}
+
+//Still needs a prototype above
+void UpdatePlanets(SolarSystem &system, RenderContext &context)
+{
+	const float PI = 3.14159f;
+	std::vector<Triangle *> triangleVec;
+	std::vector<Vector3F> newRelativePositionVec;
+	int radius = 0;
+	float speedFactor = 0;
+	for (unsigned int planet = 0; planet < system.planetVec.size(); planet++)
+	{
+		radius = 40 * (planet + 1);
+		speedFactor = (system.planetVec.size() - planet) * (PI / 2);
+		triangleVec.push_back(&system.planetVec[planet]);
+		newRelativePositionVec.push_back(Vector3F(radius * cos(system.theta * speedFactor),
+			radius * sin(system.theta * speedFactor),
+			0.0f));
+	}
+
+	//Update each planet triangle's relativePosition, along with only the pixel colors in
+	//depthBuffer that differ between its previous and new position
+	TranslateTrianglesInDepthBuffer(context, triangleVec, newRelativePositionVec);
+	for (unsigned int planet = 0; planet < system.planetVec.size(); planet++)
+		UpdateSpatialGrid(system.spatialGrid, system.planetVec[planet]);
+	
+	//This function is way too slow. Find ways to not have to loop through every single pixel,
+	//and only redraw the pixels that need to be redrawn. (Most of the screen is the background
+	//color and these pixels shouldn't need to be redrawn every frame).
+	//depthBuffer.Draw();
+
+	system.theta += 0.01f;
+}
+
+
+//Asteroid global variables
+const int MAX_ASTEROIDS = 10;
+const int NEEDED_ELAPSED_TIME = CLOCKS_PER_SEC / 2; //Half a second
+const int ASTEROID_X_SPEEED = 40;
+const int SEEDED_FRAME_TIME = NEEDED_ELAPSED_TIME / 16; //With --seed, how long every frame takes as far as spawning is concerned
+
+/*
+ * Adds the triangle p1, p2, p3 at position as an asteroid. This is the level-of-detail choice: one
+ * too small for its shape to show is drawn as a Splat instead of a Triangle, which skips all of
+ * its setup. Otherwise it's an instance of its shape, which is shared with every other asteroid
+ * of the same shape wherever they are (see class TriangleShape).
+ */
+void AddAsteroid(SolarSystem &system, RenderContext &context, const Color4 &color, const Vector3F &p1, const Vector3F &p2, const Vector3F &p3, const Vector3F &position = Vector3F(0, 0, 0))
+{
+	if (IsSplatSized(p1, p2, p3))
+	{
+		const Vector3F *vertexArr[3] = { &p1, &p2, &p3 };
+		Vector3F placedArr[3];
+		for (int i = 0; i < 3; i++)
+			placedArr[i] = Vector3F(vertexArr[i]->GetX() + position.GetX(), vertexArr[i]->GetY() + position.GetY(), vertexArr[i]->GetZ() + position.GetZ());
+		system.asteroidSplatVec.push_back(Splat(color, placedArr[0], placedArr[1], placedArr[2]));
+		UpdateSpatialGrid(system.spatialGrid, system.asteroidSplatVec[system.asteroidSplatVec.size() - 1]);
+		return;
+	}
+	system.asteroidVec.push_back(Triangle(context, color, p1, p2, p3, position));
+	UpdateSpatialGrid(system.spatialGrid, system.asteroidVec[system.asteroidVec.size() - 1]);
+}
+
+void CreateAsteroid(SolarSystem &system, RenderContext &context, RandomStream &random)
+{
+	/*
+	* Every random number is drawn into its own variable first, since the order function
+	* arguments are evaluated in is unspecified, and runs must replay identically.
+	*/
+	float newOpacity = 0.5f + (random.NextInt(6) / 5.0f);
+	Vector3F newVertex = Vector3F(0.0f, (float)(15 + random.NextInt(WINDOW_HEIGHT - 36)), -10.0f);
+	Color4 newColor = GetRandomColor(random);
+	float secondX = (float)random.NextInt(30);
+	float secondY = newVertex.GetY() + 5.0f + (float)random.NextInt(16);
+	float thirdX = 20.0f + (float)random.NextInt(70);
+	float thirdY = newVertex.GetY() - 15.0f + (float)random.NextInt(16);
+	//Its shape is relative to its first vertex's height, so that asteroids of the same shape share it.
+	float height = newVertex.GetY();
+	AddAsteroid(system, context, newColor, Vector3F(newVertex.GetX(), 0.0f, -10.0f), Vector3F(secondX, secondY - height, -10.0f), Vector3F(thirdX, thirdY - height, -10.0f),
+		Vector3F(0.0f, height, 0.0f));
+	/*
+	asteroidVec.push_back(Triangle(Color4((165 + (rand() % 16)) / 255.0f, (42 + (rand() % 16)) / 255.0f, (42 - (rand() % 16)) / 255.0f, newOpacity),
+		newVertex,
+		Vector3F((float)(rand() % 30), newVertex.GetY() + 5.0f + (float)(rand() % 16), -10.0f),
+		Vector3F(20.0f + (float)(rand() % 70), newVertex.GetY() - 15.0f + (float)(rand() % 16), -10.0f)));
+		*/
+}
+
+/*
+ * The time asteroids are spawned by: clock(), or with --seed, SEEDED_FRAME_TIME for every frame
+ * since the solar system was started, so that a seeded run spawns the same asteroids on the
+ * same frames however long they take and replays exactly.
+ */
+int GetAsteroidTime(const SolarSystem &system)
+{
+	return randomSeedGiven ? system.asteroidTime : (int)clock();
+}
+
+void UpdateAsteroids(SolarSystem &system, RenderContext &context)
+{
+	system.asteroidTime += SEEDED_FRAME_TIME;
+	std::vector<Triangle *> triangleVec;
+	std::vector<Vector3F> newRelativePositionVec;
+	unsigned int vecSize = system.asteroidVec.size();
+	for (unsigned int asteroid = 0; asteroid < vecSize; asteroid++)
+	{
+		//If an asteroid has gone off-screen, erase it. (The ones before it have still moved.)
+		if (system.asteroidVec[asteroid].vertexArr[0].GetX() + system.asteroidVec[asteroid].relativePosition.GetX() >= WINDOW_WIDTH ||
+			system.asteroidVec[asteroid].vertexArr[1].GetX() + system.asteroidVec[asteroid].relativePosition.GetX() >= WINDOW_WIDTH ||
+			system.asteroidVec[asteroid].vertexArr[2].GetX() + system.asteroidVec[asteroid].relativePosition.GetX() >= WINDOW_WIDTH)
+		{
+			TranslateTrianglesInDepthBuffer(context, triangleVec, newRelativePositionVec);
+			for (unsigned int moved = 0; moved < triangleVec.size(); moved++)
+				UpdateSpatialGrid(system.spatialGrid, *triangleVec[moved]);
+
+			context.depthBuffer->MaskBuffers(system.asteroidVec[asteroid]);
+			system.spatialGrid.Remove(system.asteroidVec[asteroid].primitiveId);
+			system.asteroidVec.erase(system.asteroidVec.begin() + asteroid);
+			return;
+		}
+
+		triangleVec.push_back(&system.asteroidVec[asteroid]);
+		newRelativePositionVec.push_back(Vector3F(system.asteroidVec[asteroid].relativePosition.GetX() + ASTEROID_X_SPEEED,
+			system.asteroidVec[asteroid].relativePosition.GetY(),
+			0.0f));
+	}
+	TranslateTrianglesInDepthBuffer(context, triangleVec, newRelativePositionVec);
+	for (unsigned int moved = 0; moved < triangleVec.size(); moved++)
+		UpdateSpatialGrid(system.spatialGrid, *triangleVec[moved]);
+
+	if (vecSize < MAX_ASTEROIDS && GetAsteroidTime(system) - system.timeOfLastCreatedAsteroid >= NEEDED_ELAPSED_TIME)
+	{
+		CreateAsteroid(system, context, system.random);
+		system.timeOfLastCreatedAsteroid = GetAsteroidTime(system);
+	}
+}
+
+//Moves the splat asteroids along with the others, and erases the ones that have gone off-screen.
+void UpdateAsteroidSplats(SolarSystem &system, RenderContext &context)
+{
+	unsigned int keptCount = 0;
+	for (unsigned int splat = 0; splat < system.asteroidSplatVec.size(); splat++)
+	{
+		if (system.asteroidSplatVec[splat].cornerX + system.asteroidSplatVec[splat].relativePosition.GetX() >= WINDOW_WIDTH)
+		{
+			context.depthBuffer->MaskBuffers(system.asteroidSplatVec[splat]);
+			system.spatialGrid.Remove(system.asteroidSplatVec[splat].primitiveId);
+		}
+		else
+			system.asteroidSplatVec[keptCount++] = system.asteroidSplatVec[splat];
+	}
+	system.asteroidSplatVec.resize(keptCount);
+
+	std::vector<Splat *> splatVec;
+	std::vector<Vector3F> newRelativePositionVec;
+	for (unsigned int splat = 0; splat < system.asteroidSplatVec.size(); splat++)
+	{
+		splatVec.push_back(&system.asteroidSplatVec[splat]);
+		newRelativePositionVec.push_back(Vector3F(system.asteroidSplatVec[splat].relativePosition.GetX() + ASTEROID_X_SPEEED, 0.0f, 0.0f));
+	}
+	TranslateSplatsInDepthBuffer(context, splatVec, newRelativePositionVec);
+	for (unsigned int moved = 0; moved < splatVec.size(); moved++)
+		UpdateSpatialGrid(system.spatialGrid, *splatVec[moved]);
+}
+
+void UpdateSolarSystem(SolarSystem &system, RenderContext &context)
+{
+	//The sun and alien planet don't move, so these are no-ops unless they've been marked dirty.
+	UpdateTriangleAndDepthBuffer(context, system.sun, system.sun.relativePosition);
+
+	UpdatePlanets(system, context);
+	UpdateAsteroids(system, context);
+	UpdateAsteroidSplats(system, context);
+
+	UpdateTriangleAndDepthBuffer(context, system.alienPlanet, system.alienPlanet.relativePosition);
+
+	//The alien planet's rings go through the transform stage
+	TransformMeshesInDepthBuffer(context, std::vector<TriangleMesh *>(1, &system.alienPlanetRings), std::vector<AffineTransform>(1, GetAlienPlanetRingsTransform(system)));
+	UpdateSpatialGrid(system.spatialGrid, system.alienPlanetRings);
+}
+
+/*
+ * Renders the solar system every rowStep-th row of context from the next frame on. Its depth buffer is
+ * cleared and every body is marked as not resident, so that the next UpdateSolarSystem()
+ * rasterizes all of them again on the new rows.
+ */
+void SetRenderRowStep(SolarSystem &system, RenderContext &context, unsigned int rowStep)
+{
+	if (rowStep == context.depthBuffer->GetRowStep())
+		return;
+	context.depthBuffer->SetRowStep(rowStep);
+	context.depthBuffer->Clear();
+
+	std::vector<Triangle *> triangleVec(1, &system.sun);
+	triangleVec.push_back(&system.alienPlanet);
+	for (unsigned int planet = 0; planet < system.planetVec.size(); planet++)
+		triangleVec.push_back(&system.planetVec[planet]);
+	for (unsigned int asteroid = 0; asteroid < system.asteroidVec.size(); asteroid++)
+		triangleVec.push_back(&system.asteroidVec[asteroid]);
+	for (unsigned int triangle = 0; triangle < triangleVec.size(); triangle++)
+	{
+		triangleVec[triangle]->coveredSpanVec.clear();
+		triangleVec[triangle]->dirty = true;
+	}
+	for (unsigned int splat = 0; splat < system.asteroidSplatVec.size(); splat++)
+		system.asteroidSplatVec[splat].dirty = true;
+	for (unsigned int face = 0; face < system.alienPlanetRings.faceVec.size(); face++)
+	{
+		system.alienPlanetRings.faceVec[face].coveredSpanVec.clear();
+		system.alienPlanetRings.faceVec[face].dirty = true;
+	}
+}
+
+
+
+/*
+* Kernel microbenchmarks
+*
+* Each hot kernel of the renderer is driven on its own with controlled inputs: triangle sizes
+* and orientations, per-pixel list depths, and alpha distributions. Results are reported per
+* pixel or per fragment, so that a change to one kernel can be measured without noise from
+* the rest of the frame. The benchmarks render into renderContext, and leave its depth buffer as
+* empty as they found it.
+*/
+class KernelTimer
+{
+public:
+	KernelTimer()
+	{
+		totalNanoseconds = 0.0;
+	}
+
+	void Start()
+	{
+		startTime = std::chrono::steady_clock::now();
+	}
+	void Stop()
+	{
+		totalNanoseconds += std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - startTime).count();
+	}
+
+public:
+	double totalNanoseconds;
+private:
+	std::chrono::steady_clock::time_point startTime;
+};
+
+/*
+ * Counts a hardware event on every worker thread of the current pool (with perf_event_open),
+ * from when it's constructed. The pool mustn't be restarted while it's counting. Counting isn't
+ * available off Linux, or where perf events are restricted (see
+ * /proc/sys/kernel/perf_event_paranoid), in which case IsAvailable() is false.
+ */
+class WorkerEventCounter
+{
+public:
+	enum Event
+	{
+		DTLB_LOAD_MISSES, //Loads whose page wasn't in the TLB
+		REMOTE_NODE_LOADS //Loads that missed the caches and were served by another NUMA node's memory
+	};
+
+	WorkerEventCounter(Event event)
+	{
+		fdVec.assign(workerPool.GetWorkerCount(), -1);
+		workerPool.Run([this, event](unsigned int workerIndex)
+		{
+			fdVec[workerIndex] = OpenCounter(event);
+		});
+	}
+	~WorkerEventCounter()
+	{
+#ifdef __linux__
+		for (unsigned int worker = 0; worker < fdVec.size(); worker++)
+			if (fdVec[worker] >= 0)
+				close(fdVec[worker]);
+#endif
+	}
+
+	bool IsAvailable() const
+	{
+		for (unsigned int worker = 0; worker < fdVec.size(); worker++)
+			if (fdVec[worker] < 0)
+				return false;
+		return true;
+	}
+
+	//The total count over every worker so far.
+	unsigned long long Read() const
+	{
+		unsigned long long total = 0;
+#ifdef __linux__
+		for (unsigned int worker = 0; worker < fdVec.size(); worker++)
+		{
+			unsigned long long count = 0;
+			if (fdVec[worker] >= 0 && read(fdVec[worker], &count, sizeof(count)) == sizeof(count))
+				total += count;
+		}
+#endif
+		return total;
+	}
+
+private:
+	//Opens a counter for the calling thread.
+	static int OpenCounter(Event event)
+	{
+#ifdef __linux__
+		perf_event_attr attributes;
+		memset(&attributes, 0, sizeof(attributes));
+		attributes.size = sizeof(attributes);
+		attributes.type = PERF_TYPE_HW_CACHE;
+		attributes.config = ((event == DTLB_LOAD_MISSES) ? PERF_COUNT_HW_CACHE_DTLB : PERF_COUNT_HW_CACHE_NODE) |
+			(PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+		attributes.exclude_kernel = 1;
+		attributes.exclude_hv = 1;
+		return (int)syscall(SYS_perf_event_open, &attributes, 0, -1, -1, 0);
+#else
+		return -1;
+#endif
+	}
+
+private:
+	std::vector<int> fdVec; //One counter per worker
+};
+
+const int BENCHMARK_TARGET_UNITS = 2000000; //Roughly how many pixels or fragments each measurement processes
+const int BENCHMARK_TRIANGLE_SIZES[] = { 8, 32, 128, 256 };
+const int BENCHMARK_LIST_DEPTHS[] = { 1, 4, 16 };
+
+void ReportBenchmark(const char *kernel, const char *variant, const KernelTimer &timer, unsigned long long units, const char *unitName)
+{
+	printf("%-30s %-38s %10.2f ns/%s\n", kernel, variant, (units == 0) ? 0.0 : timer.totalNanoseconds / units, unitName);
+}
+
+void ReportEventRate(const char *kernel, const char *variant, const WorkerEventCounter &counter, unsigned long long count,
+	unsigned long long units, const char *eventName, const char *unitName)
+{
+	if (!counter.IsAvailable())
+		printf("%-30s %-38s %10s %s/%s\n", kernel, variant, "n/a", eventName, unitName);
+	else
+		printf("%-30s %-38s %10.4f %s/%s\n", kernel, variant, (units == 0) ? 0.0 : (double)count / units, eventName, unitName);
+}
+
+/*
+ * Prints how a large buffer (see AllocateLargeBuffer()) is backed: how much of it is resident,
+ * how much of that is in huge pages, and how many of its pages are on each NUMA node. For a
+ * buffer of rowCount rows (0 if it isn't split into rows), it also prints how much of it is on
+ * the node that the worker that owns each row is running on now. Only available on Linux.
+ */
+void ReportLargeBuffer(const char *name, const void *buffer, size_t bytes, unsigned int rowCount)
+{
+	char report[256] = "n/a";
+#ifdef __linux__
+	//Resident and huge page sizes, summed over the mappings the buffer overlaps
+	unsigned long long residentKB = 0, hugeKB = 0, value;
+	bool overlapsBuffer = false;
+	char line[256];
+	FILE *smapsFile = fopen("/proc/self/smaps", "r");
+	while (smapsFile != NULL && fgets(line, sizeof(line), smapsFile) != NULL)
+	{
+		unsigned long long start, end;
+		if (sscanf(line, "%llx-%llx ", &start, &end) == 2)
+			overlapsBuffer = start < (unsigned long long)buffer + bytes && end > (unsigned long long)buffer;
+		else if (overlapsBuffer && sscanf(line, "Rss: %llu kB", &value) == 1)
+			residentKB += value;
+		else if (overlapsBuffer && sscanf(line, "AnonHugePages: %llu kB", &value) == 1)
+			hugeKB += value;
+		else if (overlapsBuffer && sscanf(line, "Private_Hugetlb: %llu kB", &value) == 1)
+		{
+			residentKB += value;
+			hugeKB += value;
+		}
+	}
+	if (smapsFile != NULL)
+		fclose(smapsFile);
+	size_t mappedBytes = (bytes + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE; //See AllocateLargeBuffer()
+	int length = sprintf(report, "%3.0f%% resident, %3.0f%% huge", 100.0 * residentKB * 1024 / mappedBytes,
+		(residentKB == 0) ? 0.0 : 100.0 * hugeKB / residentKB);
+
+	//The node of every page, and of every worker
+	size_t pageSize = sysconf(_SC_PAGESIZE);
+	unsigned long pageCount = (bytes + pageSize - 1) / pageSize;
+	std::vector<void *> pageVec(pageCount);
+	std::vector<int> pageNodeVec(pageCount, -1);
+	for (unsigned long page = 0; page < pageCount; page++)
+		pageVec[page] = (char *)buffer + page * pageSize;
+	std::vector<int> workerNodeVec(workerPool.GetWorkerCount(), -1);
+	workerPool.Run([&workerNodeVec](unsigned int workerIndex)
+	{
+		unsigned int cpu, node;
+		if (syscall(SYS_getcpu, &cpu, &node, NULL) == 0)
+			workerNodeVec[workerIndex] = node;
+	});
+	if (syscall(SYS_move_pages, 0, pageCount, &pageVec[0], NULL, &pageNodeVec[0], 0) != 0)
+	{
+		sprintf(report + length, ", nodes n/a");
+	}
+	else
+	{
+		std::map<int, unsigned long> nodePageCount;
+		unsigned long ownedPages = 0, localPages = 0;
+		for (unsigned long page = 0; page < pageCount; page++)
+		{
+			if (pageNodeVec[page] < 0)
+				continue; //Not resident
+			nodePageCount[pageNodeVec[page]]++;
+			if (rowCount != 0)
+			{
+				ownedPages++;
+				int row = (int)((unsigned long long)page * pageSize * rowCount / bytes);
+				localPages += (pageNodeVec[page] == workerNodeVec[GetRowBandOwner(row, rowCount)]) ? 1 : 0;
+			}
+		}
+		length += sprintf(report + length, ", nodes");
+		for (std::map<int, unsigned long>::const_iterator node = nodePageCount.begin(); node != nodePageCount.end(); ++node)
+			length += sprintf(report + length, " %d:%lu", node->first, node->second);
+		if (ownedPages != 0)
+			sprintf(report + length, ", %.0f%% on owner's node", 100.0 * localPages / ownedPages);
+	}
+#endif
+	printf("%-30s %-38s %7.2f MB, %s\n", "AllocateLargeBuffer", name, bytes / (1024.0 * 1024.0), report);
+}
+
+//A triangle of the given size and orientation centered in the window
+Triangle MakeBenchmarkTriangle(RenderContext &context, int orientation, int size, const Color4 &color)
+{
+	float centerX = WINDOW_WIDTH / 2.0f, centerY = WINDOW_HEIGHT / 2.0f, half = size / 2.0f;
+	switch (orientation)
+	{
+	case 0: //Horizontal edge along the bottom
+		return Triangle(context, color, Vector3F(centerX - half, centerY - half, -5.0f), Vector3F(centerX + half, centerY - half, -5.0f), Vector3F(centerX, centerY + half, -5.0f));
+	case 1: //Horizontal edge along the top
+		return Triangle(context, color, Vector3F(centerX - half, centerY + half, -5.0f), Vector3F(centerX + half, centerY + half, -5.0f), Vector3F(centerX, centerY - half, -5.0f));
+	case 2: //No horizontal edge, split about its mid-vertex
+		return Triangle(context, color, Vector3F(centerX - half, centerY - half, -5.0f), Vector3F(centerX + half, centerY - half / 2, -5.0f), Vector3F(centerX, centerY + half, -5.0f));
+	default: //One vertical edge
+		return Triangle(context, color, Vector3F(centerX - half, centerY - half, -5.0f), Vector3F(centerX - half, centerY + half, -5.0f), Vector3F(centerX + half, centerY, -5.0f));
+	}
+}
+
+const char *BENCHMARK_ORIENTATION_NAMES[] = { "flat-bottom", "flat-top", "split", "vertical-edge" };
+
+//A random box of up to maxSize pixels a side, which may be partly offscreen
+void GetBenchmarkBox(RandomStream &random, int maxSize, Vector2F &minCorner, Vector2F &maxCorner)
+{
+	float x = (float)random.NextInt(WINDOW_WIDTH + 2 * maxSize) - maxSize, y = (float)random.NextInt(WINDOW_HEIGHT + 2 * maxSize) - maxSize;
+	float width = (float)random.NextInt(maxSize), height = (float)random.NextInt(maxSize);
+	minCorner = Vector2F(x, y);
+	maxCorner = Vector2F(x + width, y + height);
+}
+
+//SpatialGrid::QueryOverlaps() by brute force, over every live box. The ids are appended in increasing order.
+void QueryOverlapsBruteForce(const std::vector<Vector2F> &minCornerVec, const std::vector<Vector2F> &maxCornerVec, const std::vector<bool> &liveVec,
+	const Vector2F &minCorner, const Vector2F &maxCorner, std::vector<unsigned int> &idVec)
+{
+	for (unsigned int id = 0; id < liveVec.size(); id++)
+		if (liveVec[id] && minCornerVec[id].GetX() <= maxCorner.GetX() && minCorner.GetX() <= maxCornerVec[id].GetX() &&
+			minCornerVec[id].GetY() <= maxCorner.GetY() && minCorner.GetY() <= maxCornerVec[id].GetY())
+			idVec.push_back(id);
+}
+
+unsigned long long CountCoveredPixels(const Triangle &triangle)
+{
+	unsigned long long pixels = 0;
+	for (unsigned int span = 0; span < triangle.coveredSpanVec.size(); span++)
+		pixels += triangle.coveredSpanVec[span].endX - triangle.coveredSpanVec[span].startX;
+	return pixels;
+}
+
+//The heap and object memory of a triangle (with its share of its shape's), and of a mesh, excluding the depth buffer's
+size_t GetPrimitiveBytes(const Triangle &triangle)
+{
+	size_t shapeBytes = sizeof(TriangleShape) + triangle.shape->relativeXPairVec.capacity() * sizeof(Vector2I);
+	return sizeof(Triangle) + shapeBytes / triangle.shape->referenceCount + triangle.coveredSpanVec.capacity() * sizeof(ScanSpan);
+}
+
+size_t GetPrimitiveBytes(const TriangleMesh &mesh)
+{
+	size_t bytes = sizeof(TriangleMesh) + (mesh.modelXVec.capacity() + mesh.xVec.capacity()) * 3 * sizeof(float) + mesh.indexVec.capacity() * sizeof(unsigned int) +
+		mesh.faceVec.capacity() * sizeof(MeshFace);
+	for (unsigned int face = 0; face < mesh.faceVec.size(); face++)
+		bytes += mesh.faceVec[face].coveredSpanVec.capacity() * sizeof(ScanSpan);
+	return bytes;
+}
+
+//The color of the fragment at a given layer, for each alpha distribution: 0 = opaque, 1 = translucent, 2 = mixed
+Color4 GetBenchmarkColor(int alphaDistribution, int layer)
+{
+	float alpha = (alphaDistribution == 0) ? 1.0f : (alphaDistribution == 1) ? 0.9f : ((layer % 2 == 0) ? 1.0f : 0.9f);
+	return Color4(0.25f + 0.05f * (layer % 10), 0.5f, 0.75f, alpha);
+}
+
+const char *BENCHMARK_ALPHA_NAMES[] = { "opaque", "translucent", "mixed" };
+
+/*
+ * Times sorted insertion and removal, and blending, in a block of pixels whose lists already
+ * hold a given number of fragments. kernelBuffer is used directly (rather than through class
+ * DepthBuffer), so the kernels are timed the way its configuration compiles them.
+ */
+template <class DepthBufferType>
+void BenchmarkFragmentLists(DepthBufferType &kernelBuffer)
+{
+	char variant[64];
+	const int BLOCK_SIZE = 64;
+	int blockX = WINDOW_WIDTH / 2 - BLOCK_SIZE / 2, blockY = WINDOW_HEIGHT / 2 - BLOCK_SIZE / 2;
+	for (unsigned int depthIndex = 0; depthIndex < sizeof(BENCHMARK_LIST_DEPTHS) / sizeof(int); depthIndex++)
+	{
+		for (int alphaDistribution = 0; alphaDistribution < 3; alphaDistribution++)
+		{
+			int listDepth = BENCHMARK_LIST_DEPTHS[depthIndex];
+			sprintf(variant, "%s %d-bit, depth %d, %s", kernelBuffer.GetName(), kernelBuffer.GetDepthBits(), listDepth,
+				BENCHMARK_ALPHA_NAMES[alphaDistribution]);
+
+			//Fill the block, with layers spaced out so that new fragments land in the middle of each list.
+			unsigned int firstLayerId = nextPrimitiveId;
+			nextPrimitiveId += listDepth + 1;
+			for (int layer = 0; layer < listDepth; layer++)
+				for (int y = blockY; y < blockY + BLOCK_SIZE; y++)
+					for (int x = blockX; x < blockX + BLOCK_SIZE; x++)
+						kernelBuffer.UpdateBuffers(x, y, -100 - 10 * layer, GetBenchmarkColor(alphaDistribution, layer), firstLayerId + layer);
+
+			unsigned long long blockPixels = BLOCK_SIZE * BLOCK_SIZE;
+			int iterations = BENCHMARK_TARGET_UNITS / (int)(blockPixels * (listDepth + 1)) + 1;
+			unsigned int insertedId = firstLayerId + listDepth;
+			int insertedDepth = -100 - 10 * (listDepth / 2) + 5;
+
+			KernelTimer insertTimer, removeTimer;
+			for (int i = 0; i < iterations; i++)
+			{
+				insertTimer.Start();
+				for (int y = blockY; y < blockY + BLOCK_SIZE; y++)
+					for (int x = blockX; x < blockX + BLOCK_SIZE; x++)
+						kernelBuffer.UpdateBuffers(x, y, insertedDepth, GetBenchmarkColor(alphaDistribution, listDepth), insertedId);
+				insertTimer.Stop();
+				removeTimer.Start();
+				for (int y = blockY; y < blockY + BLOCK_SIZE; y++)
+					for (int x = blockX; x < blockX + BLOCK_SIZE; x++)
+						kernelBuffer.RemoveFragment(x, y, insertedDepth, insertedId);
+				removeTimer.Stop();
+			}
+			ReportBenchmark("DepthBuffer::UpdateBuffers", variant, insertTimer, (unsigned long long)iterations * blockPixels, "fragment");
+			ReportBenchmark("DepthBuffer::RemoveFragment", variant, removeTimer, (unsigned long long)iterations * blockPixels, "fragment");
+
+			KernelTimer blendTimer;
+			blendTimer.Start();
+			for (int i = 0; i < iterations; i++)
+				for (int y = blockY; y < blockY + BLOCK_SIZE; y++)
+					for (int x = blockX; x < blockX + BLOCK_SIZE; x++)
+						kernelBuffer.BlendABuffer(x, y);
+			blendTimer.Stop();
+			ReportBenchmark("DepthBuffer::BlendABuffer", variant, blendTimer, (unsigned long long)iterations * blockPixels * (listDepth + 1), "fragment");
+
+			for (int layer = 0; layer < listDepth; layer++)
+				for (int y = blockY; y < blockY + BLOCK_SIZE; y++)
+					for (int x = blockX; x < blockX + BLOCK_SIZE; x++)
+						kernelBuffer.RemoveFragment(x, y, -100 - 10 * layer, firstLayerId + layer);
+		}
+	}
+}
+
+int RunKernelBenchmarks()
+{
+	char variant[64];
+	int failures = 0; //Kernels whose results were checked and found wrong
+	printf("%-30s %-38s %13s\n", "kernel", "variant", "cost");
+	RenderContext &context = renderContext;
+
+	//How the large buffers are backed and placed, with the pool the frame is rendered with
+	ReportLargeBuffer("pixelBuffer", context.depthBuffer->GetPixelBuffer(), WINDOW_WIDTH * WINDOW_HEIGHT * 3 * sizeof(float), WINDOW_HEIGHT);
+	context.depthBuffer->ReportMemory();
+	context.fragmentStore->ReportMemory();
+
+	/*
+	* Triangle scan conversion, rasterization into the depth buffer, delta updates and masking,
+	* for every size and orientation
+	*/
+	for (unsigned int sizeIndex = 0; sizeIndex < sizeof(BENCHMARK_TRIANGLE_SIZES) / sizeof(int); sizeIndex++)
+	{
+		for (int orientation = 0; orientation < 4; orientation++)
+		{
+			int size = BENCHMARK_TRIANGLE_SIZES[sizeIndex];
+			sprintf(variant, "%s %dpx", BENCHMARK_ORIENTATION_NAMES[orientation], size);
+
+			Triangle triangle = MakeBenchmarkTriangle(context, orientation, size, Color4(1.0f, 0.5f, 0.25f, 0.9f));
+			unsigned long long trianglePixels = CountCoveredPixels(triangle);
+			context.depthBuffer->MaskBuffers(triangle);
+			int iterations = BENCHMARK_TARGET_UNITS / (int)(trianglePixels + 1) + 1;
+
+			KernelTimer xPairTimer, shapeTimer;
+			std::vector<Vector2I> xPairVec;
+			xPairTimer.Start();
+			for (int i = 0; i < iterations; i++)
+				Triangle::ScanConvert(triangle.vertexArr, xPairVec);
+			xPairTimer.Stop();
+			ReportBenchmark("Triangle::ScanConvert", variant, xPairTimer, (unsigned long long)iterations * trianglePixels, "pixel");
+			shapeTimer.Start();
+			for (int i = 0; i < iterations; i++)
+				triangle.SetShape(); //Found in triangleShapeCache
+			shapeTimer.Stop();
+			ReportBenchmark("Triangle::SetShape", variant, shapeTimer, (unsigned long long)iterations * trianglePixels, "pixel");
+
+			KernelTimer rasterTimer, maskTimer;
+			for (int i = 0; i < iterations; i++)
+			{
+				rasterTimer.Start();
+				UpdateTriangleAndDepthBuffer(context, triangle, triangle.relativePosition);
+				rasterTimer.Stop();
+				maskTimer.Start();
+				context.depthBuffer->MaskBuffers(triangle);
+				maskTimer.Stop();
+			}
+			ReportBenchmark("UpdateTriangleAndDepthBuffer", variant, rasterTimer, (unsigned long long)iterations * trianglePixels, "pixel");
+			ReportBenchmark("DepthBuffer::MaskBuffers", variant, maskTimer, (unsigned long long)iterations * trianglePixels, "pixel");
+
+			//Moving one pixel to the right per step, back and forth
+			KernelTimer deltaTimer;
+			UpdateTriangleAndDepthBuffer(context, triangle, Vector3F(0, 0, 0));
+			for (int i = 0; i < iterations; i++)
+			{
+				deltaTimer.Start();
+				TranslateTriangleInDepthBuffer(context, triangle, Vector3F((float)(i % 2 == 0), 0, 0));
+				deltaTimer.Stop();
+			}
+			context.depthBuffer->MaskBuffers(triangle);
+			ReportBenchmark("TranslateTriangleInDepthBuffer", variant, deltaTimer, (unsigned long long)iterations * trianglePixels, "pixel");
+		}
+	}
+
+	/*
+	* A grid of quads built, moved and masked as separate triangles, and as one mesh whose faces
+	* share their vertices
+	*/
+	for (int cellSize = 8; cellSize <= 32; cellSize *= 4)
+	{
+		const int GRID_SIZE = 256;
+		int cells = GRID_SIZE / cellSize;
+		float left = WINDOW_WIDTH / 2.0f - GRID_SIZE / 2, top = WINDOW_HEIGHT / 2.0f - GRID_SIZE / 2;
+		std::vector<Vector3F> gridVertexVec;
+		std::vector<unsigned int> gridIndexVec;
+		for (int row = 0; row <= cells; row++)
+			for (int column = 0; column <= cells; column++)
+				gridVertexVec.push_back(Vector3F(left + column * cellSize, top + row * cellSize, -5.0f - 0.05f * (row + column)));
+		for (int row = 0; row < cells; row++)
+		{
+			for (int column = 0; column < cells; column++)
+			{
+				unsigned int corner = row * (cells + 1) + column;
+				unsigned int quadArr[6] = { corner, corner + 1, corner + cells + 1, corner + cells + 1, corner + 1, corner + cells + 2 };
+				gridIndexVec.insert(gridIndexVec.end(), quadArr, quadArr + 6);
+			}
+		}
+		unsigned long long faces = gridIndexVec.size() / 3;
+		int iterations = BENCHMARK_TARGET_UNITS / (GRID_SIZE * GRID_SIZE) + 1;
+		Color4 gridColor(0.5f, 0.75f, 0.25f, 0.9f);
+
+		KernelTimer triangleSetupTimer, triangleMoveTimer, meshSetupTimer, meshMoveTimer, meshRotateTimer;
+		size_t triangleBytes = 0, meshBytes = 0;
+		for (int i = 0; i < iterations; i++)
+		{
+			triangleSetupTimer.Start();
+			std::vector<Triangle> triangleVec;
+			triangleVec.reserve(faces);
+			for (unsigned int index = 0; index < gridIndexVec.size(); index += 3)
+				triangleVec.push_back(Triangle(context, gridColor, gridVertexVec[gridIndexVec[index]], gridVertexVec[gridIndexVec[index + 1]],
+					gridVertexVec[gridIndexVec[index + 2]]));
+			triangleSetupTimer.Stop();
+			std::vector<Triangle *> triangleRefVec;
+			for (unsigned int triangle = 0; triangle < triangleVec.size(); triangle++)
+				triangleRefVec.push_back(&triangleVec[triangle]);
+			triangleMoveTimer.Start();
+			TranslateTrianglesInDepthBuffer(context, triangleRefVec, std::vector<Vector3F>(triangleVec.size(), Vector3F(1, 1, 0)));
+			triangleMoveTimer.Stop();
+			triangleBytes = 0;
+			for (unsigned int triangle = 0; triangle < triangleVec.size(); triangle++)
+			{
+				triangleBytes += GetPrimitiveBytes(triangleVec[triangle]);
+				context.depthBuffer->MaskBuffers(triangleVec[triangle]);
+			}
+
+			meshSetupTimer.Start();
+			TriangleMesh mesh(context, gridColor, gridVertexVec, gridIndexVec);
+			meshSetupTimer.Stop();
+			meshMoveTimer.Start();
+			TranslateMeshInDepthBuffer(context, mesh, Vector3F(1, 1, 0));
+			meshMoveTimer.Stop();
+			meshRotateTimer.Start();
+			TransformMeshesInDepthBuffer(context, std::vector<TriangleMesh *>(1, &mesh), std::vector<AffineTransform>(1, AffineTransform::RotationZ(0.01f)));
+			meshRotateTimer.Stop();
+			meshBytes = GetPrimitiveBytes(mesh);
+			context.depthBuffer->MaskBuffers(mesh);
+		}
+		sprintf(variant, "%d faces of %dpx, triangles", (int)faces, cellSize);
+		ReportBenchmark("Build and rasterize", variant, triangleSetupTimer, iterations * faces, "face");
+		ReportBenchmark("Translate", variant, triangleMoveTimer, iterations * faces, "face");
+		printf("%-30s %-38s %10.1f bytes/face\n", "Memory", variant, (double)triangleBytes / faces);
+		sprintf(variant, "%d faces of %dpx, mesh", (int)faces, cellSize);
+		ReportBenchmark("Build and rasterize", variant, meshSetupTimer, iterations * faces, "face");
+		ReportBenchmark("Translate", variant, meshMoveTimer, iterations * faces, "face");
+		ReportBenchmark("Rotate", variant, meshRotateTimer, iterations * faces, "face");
+		printf("%-30s %-38s %10.1f bytes/face\n", "Memory", variant, (double)meshBytes / faces);
+	}
+
+	/*
+	* A field of tiny triangles, 1 to 3 pixels across, built and rasterized as triangles, and as
+	* splats (see AddAsteroid()) both serially and sort-last
+	*/
+	{
+		const int FIELD_SIZE = 20000;
+		RandomStream fieldRandom(1, 0);
+		std::vector<Vector3F> fieldVertexVec;
+		for (int tiny = 0; tiny < FIELD_SIZE; tiny++)
+		{
+			float x = (float)fieldRandom.NextInt(WINDOW_WIDTH - 4), y = (float)fieldRandom.NextInt(WINDOW_HEIGHT - 4);
+			float size = 1.0f + (float)fieldRandom.NextInt(3);
+			fieldVertexVec.push_back(Vector3F(x, y, -5.0f));
+			fieldVertexVec.push_back(Vector3F(x + size, y, -5.0f));
+			fieldVertexVec.push_back(Vector3F(x, y + size, -5.0f));
+		}
+		Color4 fieldColor(0.75f, 0.75f, 0.5f, 0.9f);
+
+		KernelTimer triangleTimer;
+		triangleTimer.Start();
+		std::vector<Triangle> triangleVec;
+		triangleVec.reserve(FIELD_SIZE);
+		for (int tiny = 0; tiny < FIELD_SIZE; tiny++)
+			triangleVec.push_back(Triangle(context, fieldColor, fieldVertexVec[tiny * 3], fieldVertexVec[tiny * 3 + 1], fieldVertexVec[tiny * 3 + 2]));
+		triangleTimer.Stop();
+		unsigned long long trianglePixels = 0;
+		for (int tiny = 0; tiny < FIELD_SIZE; tiny++)
+		{
+			trianglePixels += CountCoveredPixels(triangleVec[tiny]);
+			context.depthBuffer->MaskBuffers(triangleVec[tiny]);
+		}
+		sprintf(variant, "%d tiny, triangles", FIELD_SIZE);
+		ReportBenchmark("Build and rasterize", variant, triangleTimer, FIELD_SIZE, "object");
+		ReportBenchmark("Build and rasterize", variant, triangleTimer, trianglePixels, "pixel");
+
+		bool originalSortLast = sortLastRasterization;
+		for (int sortLast = 0; sortLast < 2; sortLast++)
+		{
+			sortLastRasterization = (sortLast == 1);
+			KernelTimer splatTimer;
+			splatTimer.Start();
+			std::vector<Splat> splatVec;
+			splatVec.reserve(FIELD_SIZE);
+			for (int tiny = 0; tiny < FIELD_SIZE; tiny++)
+				splatVec.push_back(Splat(fieldColor, fieldVertexVec[tiny * 3], fieldVertexVec[tiny * 3 + 1], fieldVertexVec[tiny * 3 + 2]));
+			std::vector<Splat *> splatRefVec;
+			for (int tiny = 0; tiny < FIELD_SIZE; tiny++)
+				splatRefVec.push_back(&splatVec[tiny]);
+			RasterizeSplats(context, splatRefVec);
+			splatTimer.Stop();
+			unsigned long long splatPixels = 0;
+			for (int tiny = 0; tiny < FIELD_SIZE; tiny++)
+			{
+				splatPixels += splatVec[tiny].size * splatVec[tiny].size;
+				context.depthBuffer->MaskBuffers(splatVec[tiny]);
+			}
+			sprintf(variant, "%d tiny, splats%s", FIELD_SIZE, (sortLast == 1) ? ", sort-last" : "");
+			ReportBenchmark("Build and rasterize", variant, splatTimer, FIELD_SIZE, "object");
+			ReportBenchmark("Build and rasterize", variant, splatTimer, splatPixels, "pixel");
+		}
+		sortLastRasterization = originalSortLast;
+	}
+
+	/*
+	* A field of asteroids of one shape, built with the shape baked into each one's vertices (so
+	* each has a shape of its own), and as instances of the shape at each position (so they all
+	* share it, see class TriangleShape)
+	*/
+	{
+		const int FIELD_SIZE = 2000;
+		RandomStream fieldRandom(2, 0);
+		std::vector<Vector3F> positionVec;
+		for (int asteroid = 0; asteroid < FIELD_SIZE; asteroid++)
+			positionVec.push_back(Vector3F((float)fieldRandom.NextInt(WINDOW_WIDTH - 40), (float)fieldRandom.NextInt(WINDOW_HEIGHT - 40), 0.0f));
+		Vector3F shapeArr[3] = { Vector3F(0, 0, -10), Vector3F(12, 25, -10), Vector3F(35, 8, -10) };
+		Color4 fieldColor(0.6f, 0.5f, 0.4f, 0.9f);
+
+		for (int instanced = 0; instanced < 2; instanced++)
+		{
+			unsigned int originalShapeCount = triangleShapeCache.GetShapeCount();
+			KernelTimer buildTimer;
+			buildTimer.Start();
+			std::vector<Triangle> triangleVec;
+			triangleVec.reserve(FIELD_SIZE);
+			for (int asteroid = 0; asteroid < FIELD_SIZE; asteroid++)
+			{
+				const Vector3F &position = positionVec[asteroid];
+				if (instanced == 1)
+					triangleVec.push_back(Triangle(context, fieldColor, shapeArr[0], shapeArr[1], shapeArr[2], position));
+				else
+				{
+					Vector3F placedArr[3];
+					for (int i = 0; i < 3; i++)
+						placedArr[i] = Vector3F(shapeArr[i].GetX() + position.GetX(), shapeArr[i].GetY() + position.GetY(), shapeArr[i].GetZ());
+					triangleVec.push_back(Triangle(context, fieldColor, placedArr[0], placedArr[1], placedArr[2]));
+				}
+			}
+			buildTimer.Stop();
+			unsigned int shapeCount = triangleShapeCache.GetShapeCount() - originalShapeCount;
+			size_t triangleBytes = 0;
+			for (int asteroid = 0; asteroid < FIELD_SIZE; asteroid++)
+			{
+				triangleBytes += GetPrimitiveBytes(triangleVec[asteroid]);
+				context.depthBuffer->MaskBuffers(triangleVec[asteroid]);
+			}
+			sprintf(variant, "%d of one shape, %s", FIELD_SIZE, (instanced == 1) ? "instanced" : "baked");
+			ReportBenchmark("Build and rasterize", variant, buildTimer, FIELD_SIZE, "object");
+			printf("%-30s %-38s %10.1f bytes/triangle, %u shapes\n", "Memory", variant, (double)triangleBytes / FIELD_SIZE, shapeCount);
+		}
+	}
+
+	/*
+	* Overlap and pick queries on a field of asteroid-sized boxes, through the spatial grid and by
+	* brute force over every box. Some boxes are moved and some removed first, so that the grid's
+	* cells have changed since it was filled. Both must find the same boxes.
+	*/
+	{
+		const int FIELD_SIZE = 5000;
+		const int QUERY_COUNT = 2000;
+		RandomStream fieldRandom(3, 0);
+		SpatialGrid grid;
+		std::vector<Vector2F> minCornerVec(FIELD_SIZE), maxCornerVec(FIELD_SIZE);
+		std::vector<bool> liveVec(FIELD_SIZE, true);
+		for (int box = 0; box < FIELD_SIZE; box++)
+		{
+			GetBenchmarkBox(fieldRandom, 60, minCornerVec[box], maxCornerVec[box]);
+			grid.Update(box, minCornerVec[box], maxCornerVec[box]);
+		}
+		for (int box = 0; box < FIELD_SIZE; box += 3)
+		{
+			GetBenchmarkBox(fieldRandom, 60, minCornerVec[box], maxCornerVec[box]);
+			grid.Update(box, minCornerVec[box], maxCornerVec[box]);
+		}
+		for (int box = 1; box < FIELD_SIZE; box += 6)
+		{
+			grid.Remove(box);
+			liveVec[box] = false;
+		}
+
+		KernelTimer gridOverlapTimer, bruteOverlapTimer, gridPickTimer, brutePickTimer;
+		unsigned int mismatches = 0;
+		std::vector<unsigned int> gridIdVec, bruteIdVec;
+		for (int query = 0; query < QUERY_COUNT; query++)
+		{
+			Vector2F minCorner, maxCorner;
+			GetBenchmarkBox(fieldRandom, 120, minCorner, maxCorner);
+			gridIdVec.clear();
+			bruteIdVec.clear();
+			gridOverlapTimer.Start();
+			grid.QueryOverlaps(minCorner, maxCorner, gridIdVec);
+			gridOverlapTimer.Stop();
+			bruteOverlapTimer.Start();
+			QueryOverlapsBruteForce(minCornerVec, maxCornerVec, liveVec, minCorner, maxCorner, bruteIdVec);
+			bruteOverlapTimer.Stop();
+			std::sort(gridIdVec.begin(), gridIdVec.end());
+			mismatches += (gridIdVec != bruteIdVec) ? 1 : 0;
+
+			gridIdVec.clear();
+			bruteIdVec.clear();
+			gridPickTimer.Start();
+			grid.Pick(minCorner.GetX(), minCorner.GetY(), gridIdVec);
+			gridPickTimer.Stop();
+			brutePickTimer.Start();
+			QueryOverlapsBruteForce(minCornerVec, maxCornerVec, liveVec, minCorner, minCorner, bruteIdVec);
+			brutePickTimer.Stop();
+			std::sort(gridIdVec.begin(), gridIdVec.end());
+			mismatches += (gridIdVec != bruteIdVec) ? 1 : 0;
+		}
+		sprintf(variant, "%d boxes, grid", FIELD_SIZE);
+		ReportBenchmark("SpatialGrid::QueryOverlaps", variant, gridOverlapTimer, QUERY_COUNT, "query");
+		ReportBenchmark("SpatialGrid::Pick", variant, gridPickTimer, QUERY_COUNT, "query");
+		sprintf(variant, "%d boxes, brute force", FIELD_SIZE);
+		ReportBenchmark("SpatialGrid::QueryOverlaps", variant, bruteOverlapTimer, QUERY_COUNT, "query");
+		ReportBenchmark("SpatialGrid::Pick", variant, brutePickTimer, QUERY_COUNT, "query");
+		if (mismatches != 0)
+			printf("FAIL %-25s %-38s %10u queries differ from brute force\n", "SpatialGrid", "", mismatches);
+		failures += mismatches;
+	}
+
+	/*
+	* A stack of large, flat, translucent triangles, rasterized and resolved with a fragment list
+	* per pixel, and with runs of pixels per row (see class IntervalDepthBuffer)
+	*/
+	{
+		const int STACK_SIZE = 8;
+		SpecializedDepthBuffer<VectorStorage, AlphaBlend, short> pixelStorageBuffer;
+		IntervalDepthBuffer<AlphaBlend, short> intervalStorageBuffer;
+		DepthBuffer *storageBufferArr[] = { &pixelStorageBuffer, &intervalStorageBuffer };
+		const char *storageNameArr[] = { "pixels", "intervals" };
+		for (int storage = 0; storage < 2; storage++)
+		{
+			RenderContext storageContext(storageBufferArr[storage], context.fragmentStore);
+			storageContext.depthBuffer->SetPixelBuffer(context.depthBuffer->GetPixelBuffer());
+			sprintf(variant, "%d large, %s", STACK_SIZE, storageNameArr[storage]);
+
+			KernelTimer rasterizeTimer;
+			rasterizeTimer.Start();
+			std::vector<Triangle> triangleVec;
+			triangleVec.reserve(STACK_SIZE);
+			for (int layer = 0; layer < STACK_SIZE; layer++)
+				triangleVec.push_back(Triangle(storageContext, Color4(0.2f + 0.1f * layer, 0.5f, 0.8f - 0.1f * layer, 0.8f), Vector3F(50.0f + 30 * layer, 50.0f, -10.0f - layer),
+					Vector3F(750.0f, 80.0f + 20 * layer, -10.0f - layer), Vector3F(300.0f - 10 * layer, 550.0f, -10.0f - layer)));
+			rasterizeTimer.Stop();
+			unsigned long long stackPixels = 0;
+			for (int layer = 0; layer < STACK_SIZE; layer++)
+				stackPixels += CountCoveredPixels(triangleVec[layer]);
+			size_t stackBytes = storageContext.depthBuffer->GetFragmentBytes();
+
+			int frames = BENCHMARK_TARGET_UNITS / (WINDOW_WIDTH * WINDOW_HEIGHT) + 1;
+			KernelTimer resolveTimer;
+			resolveTimer.Start();
+			for (int frame = 0; frame < frames; frame++)
+				storageContext.depthBuffer->Resolve();
+			resolveTimer.Stop();
+
+			for (int layer = 0; layer < STACK_SIZE; layer++)
+				storageContext.depthBuffer->MaskBuffers(triangleVec[layer]);
+			ReportBenchmark("Build and rasterize", variant, rasterizeTimer, stackPixels, "pixel");
+			ReportBenchmark("DepthBuffer::Resolve", variant, resolveTimer, (unsigned long long)frames * WINDOW_WIDTH * WINDOW_HEIGHT, "pixel");
+			printf("%-30s %-38s %10.1f bytes/pixel\n", "Memory", variant, (double)stackBytes / (WINDOW_WIDTH * WINDOW_HEIGHT));
+		}
+	}
+
+	//Transforming a batch of vertices, four at a time and one at a time
+	{
+		const unsigned int BATCH_VERTICES = 4000; //Not a power of two, so that the arrays don't alias each other in the caches
+		std::vector<float> xVec(BATCH_VERTICES), yVec(BATCH_VERTICES), zVec(BATCH_VERTICES), outXVec(BATCH_VERTICES),
+			outYVec(BATCH_VERTICES), outZVec(BATCH_VERTICES);
+		for (unsigned int vertex = 0; vertex < BATCH_VERTICES; vertex++)
+		{
+			xVec[vertex] = (float)(vertex % 64);
+			yVec[vertex] = (float)(vertex / 64);
+			zVec[vertex] = -5.0f;
+		}
+		AffineTransform transform = AffineTransform::Translation(Vector3F(400.0f, 300.0f, -10.0f)) * AffineTransform::Scale(2.0f, 2.0f, 1.0f) *
+			AffineTransform::RotationZ(0.5f);
+		int iterations = BENCHMARK_TARGET_UNITS / BATCH_VERTICES + 1;
+		KernelTimer simdTimer, scalarTimer;
+		simdTimer.Start();
+		for (int i = 0; i < iterations; i++)
+			transform.TransformVertices(&xVec[0], &yVec[0], &zVec[0], BATCH_VERTICES, &outXVec[0], &outYVec[0], &outZVec[0]);
+		simdTimer.Stop();
+		scalarTimer.Start();
+		for (int i = 0; i < iterations; i++)
+			transform.TransformVerticesScalar(&xVec[0], &yVec[0], &zVec[0], BATCH_VERTICES, &outXVec[0], &outYVec[0], &outZVec[0]);
+		scalarTimer.Stop();
+		sprintf(variant, "%u vertices", BATCH_VERTICES);
+		ReportBenchmark("TransformVertices", variant, simdTimer, (unsigned long long)iterations * BATCH_VERTICES, "vertex");
+		sprintf(variant, "%u vertices, scalar", BATCH_VERTICES);
+		ReportBenchmark("TransformVertices", variant, scalarTimer, (unsigned long long)iterations * BATCH_VERTICES, "vertex");
+	}
+
+	//Sorted insertion and removal, and blending, with every depth buffer configuration
+	float *pixelBuffer = context.depthBuffer->GetPixelBuffer();
+	SpecializedDepthBuffer<VectorStorage, OpaqueBlend, short> opaqueBuffer;
+	opaqueBuffer.SetPixelBuffer(pixelBuffer);
+	BenchmarkFragmentLists(opaqueBuffer);
+	SpecializedDepthBuffer<VectorStorage, AlphaBlend, short> alphaBuffer;
+	alphaBuffer.SetPixelBuffer(pixelBuffer);
+	BenchmarkFragmentLists(alphaBuffer);
+	SpecializedDepthBuffer<VectorStorage, AdditiveBlend, short> additiveBuffer;
+	additiveBuffer.SetPixelBuffer(pixelBuffer);
+	BenchmarkFragmentLists(additiveBuffer);
+	SpecializedDepthBuffer<VectorStorage, AlphaBlend, int> deepAlphaBuffer;
+	deepAlphaBuffer.SetPixelBuffer(pixelBuffer);
+	BenchmarkFragmentLists(deepAlphaBuffer);
+
+	//Writing every pixel of the frame
+	KernelTimer setPixelTimer;
+	Color3 color(0.25f, 0.5f, 0.75f);
+	int frames = BENCHMARK_TARGET_UNITS / (WINDOW_WIDTH * WINDOW_HEIGHT) + 1;
+	setPixelTimer.Start();
+	for (int frame = 0; frame < frames; frame++)
+		for (int y = 0; y < (int)WINDOW_HEIGHT; y++)
+			for (int x = 0; x < (int)WINDOW_WIDTH; x++)
+				SetPixel(pixelBuffer, x, y, color);
+	setPixelTimer.Stop();
+	ReportBenchmark("SetPixel", "full frame", setPixelTimer, (unsigned long long)frames * WINDOW_WIDTH * WINDOW_HEIGHT, "pixel");
+
+	//Resolving the whole frame, with every worker count up to the hardware's
+	unsigned int originalWorkerCount = workerPool.GetWorkerCount();
+	unsigned int hardwareThreads = std::thread::hardware_concurrency();
+	hardwareThreads = (hardwareThreads < 1) ? 1 : hardwareThreads;
+	for (unsigned int workers = 1; workers <= hardwareThreads; workers = (workers * 2 > hardwareThreads && workers < hardwareThreads) ? hardwareThreads : workers * 2)
+	{
+		workerPool.Start(workers);
+		WorkerEventCounter tlbCounter(WorkerEventCounter::DTLB_LOAD_MISSES), remoteCounter(WorkerEventCounter::REMOTE_NODE_LOADS);
+		unsigned long long tlbMisses = tlbCounter.Read(), remoteLoads = remoteCounter.Read();
+		KernelTimer resolveTimer;
+		resolveTimer.Start();
+		for (int frame = 0; frame < frames; frame++)
+			context.depthBuffer->Resolve();
+		resolveTimer.Stop();
+		tlbMisses = tlbCounter.Read() - tlbMisses;
+		remoteLoads = remoteCounter.Read() - remoteLoads;
+		char variant[32];
+		sprintf(variant, "full frame, %u worker(s)", workers);
+		unsigned long long framePixels = (unsigned long long)frames * WINDOW_WIDTH * WINDOW_HEIGHT;
+		ReportBenchmark("DepthBuffer::Resolve", variant, resolveTimer, framePixels, "pixel");
+		ReportEventRate("DepthBuffer::Resolve", variant, tlbCounter, tlbMisses, framePixels, "dTLB misses", "pixel");
+		ReportEventRate("DepthBuffer::Resolve", variant, remoteCounter, remoteLoads, framePixels, "remote loads", "pixel");
+	}
+	workerPool.Start(originalWorkerCount);
+	return (failures == 0) ? 0 : 1;
+}
+
+
+
+/*
+* Golden-image regression harness
+*
+* Renders a set of deterministic scenes headlessly and compares each frame against a stored
+* golden image, so that faster rendering paths can be checked against the reference output,
+* quirks included. The goldens in goldens/ were rendered by the renderer as it was before it was
+* optimized, one per scene, anti-aliasing and blend mode. --golden-check <directory> renders
+* every scene with every engine and every depth buffer (each storage, blend mode and depth
+* size there is) and compares the result to its golden, allowing each channel to be off by up to
+* --golden-tolerance (out of 255, 2 by default). A failing comparison also writes a diff image
+* next to the golden: white where the frames match, red where they don't. --golden-write
+* <directory> renders new goldens with the reference path (full re-rasterization into lists of
+* pixels with 16-bit depths), for when the output is meant to change.
+*/
+class GoldenScene
+{
+public:
+	GoldenScene(const char *newName = "", void (*newRender)(SolarSystem &, RenderContext &) = NULL)
+	{
+		name = newName;
+		render = newRender;
+	}
+public:
+	const char *name;
+	void (*render)(SolarSystem &, RenderContext &); //Renders the scene into the context, starting from an empty scene
+};
+
+class RenderEngine
+{
+public:
+	RenderEngine(const char *newName = "", bool newIncrementalUpdates = true, bool newSortLastRasterization = false, bool newCheckpointed = false)
+	{
+		name = newName;
+		incrementalUpdates = newIncrementalUpdates;
+		sortLastRasterization = newSortLastRasterization;
+		checkpointed = newCheckpointed;
+	}
+
+	//Makes this engine the one the next scene is rendered with.
+	void Select() const
+	{
+		::incrementalUpdates = incrementalUpdates;
+		::sortLastRasterization = sortLastRasterization;
+	}
+public:
+	const char *name;
+	bool incrementalUpdates;
+	bool sortLastRasterization;
+	bool checkpointed; //The scene is checkpointed once it's rendered, and restored into an empty scene before it's captured
+};
+
+void ResetSolarSystem(SolarSystem &system, RenderContext &context)
+{
+	system = SolarSystem();
+	context.depthBuffer->Clear();
+	context.depthBuffer->SetRowStep(1);
+	system.random.Seed(1, 0);
+}
+
+//Exercises the rasterizer's and blender's known quirks directly.
+void RenderQuirksScene(SolarSystem &/*system*/, RenderContext &context)
+{
+	//A triangle with one vertical edge
+	Triangle verticalEdge(context, Color4(0.9f, 0.3f, 0.3f, 1.0f), Vector3F(50, 50, -5), Vector3F(50, 150, -5), Vector3F(150, 100, -5));
+
+	//Horizontal edges along the bottom and the top, given with their x-values out of order
+	Triangle flatBottom(context, Color4(0.3f, 0.9f, 0.3f, 1.0f), Vector3F(300, 50, -5), Vector3F(200, 50, -5), Vector3F(250, 150, -5));
+	Triangle flatTop(context, Color4(0.3f, 0.3f, 0.9f, 1.0f), Vector3F(450, 150, -5), Vector3F(350, 150, -5), Vector3F(400, 50, -5));
+
+	//No horizontal edge, so it's split about its mid-vertex
+	Triangle split(context, Color4(0.9f, 0.9f, 0.3f, 1.0f), Vector3F(500, 50, -5), Vector3F(650, 90, -5), Vector3F(560, 170, -5));
+
+	//A stack of translucent triangles, for the /2 blend
+	Triangle back(context, Color4(1.0f, 0.0f, 0.0f, 0.5f), Vector3F(100, 250, -12), Vector3F(300, 260, -12), Vector3F(180, 420, -12));
+	Triangle middle(context, Color4(0.0f, 1.0f, 0.0f, 0.7f), Vector3F(150, 240, -11), Vector3F(320, 300, -11), Vector3F(200, 440, -11));
+	Triangle front(context, Color4(0.0f, 0.0f, 1.0f, 0.9f), Vector3F(130, 300, -10), Vector3F(340, 320, -10), Vector3F(240, 460, -10));
+
+	//A sloped triangle cutting through a flat, opaque one
+	Triangle flat(context, Color4(0.6f, 0.6f, 0.6f, 1.0f), Vector3F(420, 240, -25), Vector3F(620, 250, -25), Vector3F(520, 420, -25));
+	Triangle sloped(context, Color4(0.9f, 0.5f, 0.1f, 0.8f), Vector3F(400, 250, -50), Vector3F(600, 260, 0), Vector3F(500, 400, -20));
+
+	//An n-gon
+	std::vector<Vector3F> hexagonVertexVec;
+	for (int i = 0; i < 6; i++)
+		hexagonVertexVec.push_back(Vector3F(700 + 60 * cos(i * 1.0472f), 480 + 60 * sin(i * 1.0472f), -8));
+	Polygon hexagon(context, Color4(0.8f, 0.2f, 0.8f, 0.85f), hexagonVertexVec);
+
+	//A sloped 3x3 grid mesh, whose faces share their vertices
+	std::vector<Vector3F> gridVertexVec;
+	std::vector<unsigned int> gridIndexVec;
+	for (int row = 0; row < 4; row++)
+		for (int column = 0; column < 4; column++)
+			gridVertexVec.push_back(Vector3F(660 + 35.0f * column + 5.0f * row, 60 + 30.0f * row, -6 - 2.0f * column - 3.0f * row));
+	for (int row = 0; row < 3; row++)
+	{
+		for (int column = 0; column < 3; column++)
+		{
+			unsigned int corner = row * 4 + column;
+			unsigned int quadArr[6] = { corner, corner + 1, corner + 4, corner + 4, corner + 1, corner + 5 };
+			gridIndexVec.insert(gridIndexVec.end(), quadArr, quadArr + 6);
+		}
+	}
+	TriangleMesh grid(context, Color4(0.4f, 0.7f, 0.3f, 0.75f), gridVertexVec, gridIndexVec);
+
+	//Translations over the stack, partly offscreen, and a removal
+	Triangle mover(context, Color4(0.2f, 0.8f, 0.8f, 0.8f), Vector3F(60, 330, -7), Vector3F(140, 340, -7), Vector3F(90, 400, -7));
+	for (int step = 1; step <= 5; step++)
+		TranslateTriangleInDepthBuffer(context, mover, Vector3F(7.0f * step, 3.0f * step, 0));
+	TranslateTriangleInDepthBuffer(context, flatTop, Vector3F(0, -80, 0));
+	TranslateTriangleInDepthBuffer(context, verticalEdge, Vector3F(-90, 0, 0));
+	TranslatePolygonInDepthBuffer(context, hexagon, Vector3F(40, 60, 0));
+	TranslateMeshInDepthBuffer(context, grid, Vector3F(-30, 20, 0));
+	TranslateMeshInDepthBuffer(context, grid, Vector3F(-45, 25, 0));
+	context.depthBuffer->MaskBuffers(split);
+
+	//The translucent stack moved as one batch, overlapping itself
+	std::vector<Triangle *> stackVec;
+	stackVec.push_back(&back);
+	stackVec.push_back(&middle);
+	stackVec.push_back(&front);
+	std::vector<Vector3F> stackPositionVec;
+	stackPositionVec.push_back(Vector3F(25, 10, 0));
+	stackPositionVec.push_back(Vector3F(-15, 5, 0));
+	stackPositionVec.push_back(Vector3F(0, -30, 0));
+	TranslateTrianglesInDepthBuffer(context, stackVec, stackPositionVec);
+}
+
+/*
+ * Trails asteroid, which was just spawned, with debrisCount triangles small enough to be drawn
+ * as splats. The debris isn't part of the solar system; the regression scenes and --headless
+ * add it so that the splat path is exercised alongside the triangles.
+ */
+void AddAsteroidDebris(SolarSystem &system, RenderContext &context, const Triangle &asteroid, unsigned int debrisCount, RandomStream &random)
+{
+	float height = asteroid.relativePosition.GetY();
+	for (unsigned int debris = 0; debris < debrisCount; debris++)
+	{
+		float debrisX = asteroid.relativePosition.GetX() - (float)random.NextInt(60);
+		float debrisY = height - 10.0f + (float)random.NextInt(21);
+		float debrisSize = 1.0f + (float)random.NextInt(3);
+		AddAsteroid(system, context, asteroid.color, Vector3F(debrisX, debrisY, -10.0f), Vector3F(debrisX + debrisSize, debrisY, -10.0f),
+			Vector3F(debrisX, debrisY + debrisSize, -10.0f));
+	}
+}
+
+//UpdateSolarSystem(), then trails the asteroid it spawned, if any, with debrisCount pieces of debris.
+void UpdateSolarSystemWithDebris(SolarSystem &system, RenderContext &context, unsigned int debrisCount)
+{
+	unsigned int asteroidCount = system.asteroidVec.size();
+	UpdateSolarSystem(system, context);
+	if (debrisCount != 0 && system.asteroidVec.size() > asteroidCount)
+		AddAsteroidDebris(system, context, system.asteroidVec[system.asteroidVec.size() - 1], debrisCount, system.random);
+}
+
+void RenderSolarSystemScene(SolarSystem &system, RenderContext &context)
+{
+	const unsigned int DEBRIS_PER_ASTEROID = 12;
+	CreateSolarSystem(system, context);
+	for (int frame = 0; frame < 40; frame++)
+	{
+		//Spawning is timed with clock() unless seeded, so pretend enough time has passed before every frame.
+		system.timeOfLastCreatedAsteroid = GetAsteroidTime(system) - NEEDED_ELAPSED_TIME;
+		UpdateSolarSystemWithDebris(system, context, DEBRIS_PER_ASTEROID);
+	}
+}
+
+//The frame in context's pixel buffer as 8-bit RGB, top row first
+void CaptureFrame(const RenderContext &context, std::vector<unsigned char> &frame)
+{
+	const float *pixelBuffer = context.depthBuffer->GetPixelBuffer();
+	frame.resize(WINDOW_WIDTH * WINDOW_HEIGHT * 3);
+	for (int y = 0; y < (int)WINDOW_HEIGHT; y++)
+		for (int x = 0; x < (int)WINDOW_WIDTH * 3; x++)
+			frame[(WINDOW_HEIGHT - 1 - y) * WINDOW_WIDTH * 3 + x] = (unsigned char)(pixelBuffer[y * WINDOW_WIDTH * 3 + x] * 255.0f + 0.5f);
+}
+
+bool WritePPM(const std::string &path, const std::vector<unsigned char> &frame)
+{
+	return WritePPM(path, &frame[0], WINDOW_WIDTH, WINDOW_HEIGHT);
+}
+
+bool WritePPM(const std::string &path, const unsigned char *frame, unsigned int width, unsigned int height)
+{
+	FILE *file = fopen(path.c_str(), "wb");
+	if (file == NULL)
+		return false;
+	fprintf(file, "P6\n%u %u\n255\n", width, height);
+	bool written = fwrite(frame, 1, width * height * 3, file) == width * height * 3;
+	fclose(file);
+	return written;
+}
+
+bool ReadPPM(const std::string &path, std::vector<unsigned char> &frame)
+{
+	FILE *file = fopen(path.c_str(), "rb");
+	if (file == NULL)
+		return false;
+	unsigned int width = 0, height = 0, maxValue = 0;
+	bool valid = fscanf(file, "P6 %u %u %u", &width, &height, &maxValue) == 3 && fgetc(file) != EOF &&
+		width == WINDOW_WIDTH && height == WINDOW_HEIGHT && maxValue == 255;
+	frame.resize(WINDOW_WIDTH * WINDOW_HEIGHT * 3);
+	valid = valid && fread(&frame[0], 1, frame.size(), file) == frame.size();
+	fclose(file);
+	return valid;
+}
+
+int RunGoldenHarness(const char *directory, bool writeGoldens, int tolerance)
+{
+	GoldenScene sceneArr[] = {
+		GoldenScene("quirks", RenderQuirksScene),
+		GoldenScene("solar-system", RenderSolarSystemScene),
+	};
+	RenderEngine engineArr[] = {
+		RenderEngine("full", false), //The reference every other engine is checked against
+		RenderEngine("incremental", true),
+		RenderEngine("sort-last", true, true),
+		RenderEngine("checkpoint", true, false, true),
+	};
+	//Every configuration of the depth buffer is checked against the same goldens, which only differ by blend mode.
+	const char *storageNameArr[] = { "pixels", "intervals" };
+	const char *blendNameArr[] = { OpaqueBlend::GetName(), AlphaBlend::GetName(), AdditiveBlend::GetName() };
+	int depthBitsArr[] = { 16, 32 };
+	int sceneCount = sizeof(sceneArr) / sizeof(GoldenScene);
+	int engineCount = writeGoldens ? 1 : sizeof(engineArr) / sizeof(RenderEngine);
+	int storageCount = writeGoldens ? 1 : sizeof(storageNameArr) / sizeof(const char *);
+	int depthBitsCount = writeGoldens ? 1 : sizeof(depthBitsArr) / sizeof(int);
+	int blendCount = sizeof(blendNameArr) / sizeof(const char *);
+
+	int failures = 0;
+	std::vector<unsigned char> frame, golden;
+	SolarSystem system;
+	for (int configuration = 0; configuration < storageCount * blendCount * depthBitsCount; configuration++)
+	{
+		const char *storageName = storageNameArr[configuration / (blendCount * depthBitsCount)];
+		const char *blendName = blendNameArr[configuration / depthBitsCount % blendCount];
+		int depthBits = depthBitsArr[configuration % depthBitsCount];
+		RenderContext context(NewDepthBuffer(storageName, blendName, depthBits, WINDOW_WIDTH, WINDOW_HEIGHT), &fragmentStore);
+		if (context.depthBuffer == NULL)
+			continue; //Not every blend mode has a 32-bit depth buffer
+		context.depthBuffer->SetPixelBuffer(renderContext.depthBuffer->GetPixelBuffer());
+		char configurationName[64];
+		sprintf(configurationName, "%s-%d", storageName, depthBits);
+
+		for (int aa = 0; aa < 2; aa++)
+		{
+			antiAliasing = (aa == 1);
+			for (int scene = 0; scene < sceneCount; scene++)
+			{
+				std::string goldenName = std::string(sceneArr[scene].name) + (antiAliasing ? "-aa" : "") + "-" + blendName;
+				std::string goldenPath = std::string(directory) + "/" + goldenName + ".ppm";
+				if (!writeGoldens && !ReadPPM(goldenPath, golden))
+				{
+					printf("FAIL  %-44s could not read %s\n", "", goldenPath.c_str());
+					failures++;
+					continue;
+				}
+
+				for (int engine = 0; engine < engineCount; engine++)
+				{
+					engineArr[engine].Select();
+					ResetSolarSystem(system, context);
+					sceneArr[scene].render(system, context);
+					if (engineArr[engine].checkpointed)
+					{
+						std::string checkpointPath = std::string(directory) + "/checkpoint.tmp";
+						bool restored = WriteCheckpoint(checkpointPath, system, context);
+						ResetSolarSystem(system, context);
+						restored = restored && ReadCheckpoint(checkpointPath, system, context);
+						remove(checkpointPath.c_str());
+						if (!restored)
+							printf("FAIL  %-44s could not checkpoint to %s\n", "", checkpointPath.c_str());
+						failures += restored ? 0 : 1;
+					}
+					context.depthBuffer->ResolveFrame(); //As Display() draws it
+					CaptureFrame(context, frame);
+
+					std::string label = goldenName + " " + configurationName + " [" + engineArr[engine].name + "]";
+					if (writeGoldens)
+					{
+						bool written = WritePPM(goldenPath, frame);
+						printf("%s %-44s %s\n", written ? "WROTE" : "FAIL ", label.c_str(), goldenPath.c_str());
+						failures += written ? 0 : 1;
+						continue;
+					}
+
+					//Compare channel by channel, marking every pixel that's off by more than the tolerance.
+					std::vector<unsigned char> diff(frame.size(), 255);
+					int mismatchedPixels = 0, maxError = 0;
+					for (unsigned int pixel = 0; pixel < frame.size() / 3; pixel++)
+					{
+						int pixelError = 0;
+						for (int channel = 0; channel < 3; channel++)
+						{
+							int error = abs((int)frame[pixel * 3 + channel] - (int)golden[pixel * 3 + channel]);
+							pixelError = (error > pixelError) ? error : pixelError;
+						}
+						maxError = (pixelError > maxError) ? pixelError : maxError;
+						if (pixelError > tolerance)
+						{
+							mismatchedPixels++;
+							diff[pixel * 3 + 1] = diff[pixel * 3 + 2] = 0;
+						}
+					}
+
+					if (mismatchedPixels == 0)
+						printf("PASS  %-44s max error %d\n", label.c_str(), maxError);
+					else
+					{
+						std::string diffPath = std::string(directory) + "/" + goldenName + "." + configurationName + "." + engineArr[engine].name + ".diff.ppm";
+						WritePPM(diffPath, diff);
+						printf("FAIL  %-44s %d pixels off by more than %d (max %d), see %s\n", label.c_str(), mismatchedPixels, tolerance, maxError, diffPath.c_str());
+						failures++;
+					}
+				}
+			}
+		}
+		system = SolarSystem(); //Its bodies are numbered in this depth buffer
+		delete context.depthBuffer;
+	}
+	antiAliasing = false;
+	incrementalUpdates = true;
+	sortLastRasterization = false;
+	return (failures == 0) ? 0 : 1;
+}
+
+/*
+ * Checkpoints. A checkpoint file holds the solar system as it was after a frame: every body in
+ * it, the state it's animated from (theta, its random stream) and the depth
+ * buffer's fragments, already blended. Restoring one (--restore) maps the file and copies the
+ * fragments straight into the depth buffer, so the scene picks up where it left off without
+ * rasterizing or blending anything again. Only a depth buffer of the same configuration (storage,
+ * blend, depth bits, anti-aliasing and size) can restore it.
+ *
+ * The file is a CheckpointHeader followed by sections, each at a byte offset from the start of
+ * the file given in the header and each 8-byte aligned. Nothing in it is a pointer, so it reads
+ * the same wherever it's mapped.
+ */
+class CheckpointHeader
+{
+public:
+	static const unsigned int MAGIC = 0x54504B43; //"CKPT"
+	static const unsigned int VERSION = 4;
+	static const unsigned int NAME_LENGTH = 16;
+
+	unsigned int magic;
+	unsigned int version;
+	unsigned int width;
+	unsigned int height;
+	char storageName[NAME_LENGTH];
+	char blendName[NAME_LENGTH];
+	int depthBits;
+	int antiAliasing;
+	unsigned int renderRowStep; //The rows that have fragments, see DepthBuffer::IsRenderedRow()
+	float theta;
+	unsigned int nextPrimitiveId;
+	RandomStream random; //The solar system's
+	unsigned int planetCount;
+	unsigned int asteroidCount;
+	unsigned int splatCount;
+	unsigned long long triangleOffset; //The sun, the alien planet, the planets then the asteroids, as CheckpointTriangles
+	unsigned long long splatOffset; //The splat asteroids, as CheckpointSplats
+	unsigned long long meshOffset; //The alien planet's rings, see CheckpointMesh
+	unsigned long long depthBufferOffset; //See DepthBuffer::AppendCheckpoint()
+	unsigned long long depthBufferBytes;
+	unsigned long long fileBytes;
+};
+
+class CheckpointTriangle
+{
+public:
+	Color4 color;
+	Vector3F vertexArr[3]; //Already sorted
+	Vector3F relativePosition;
+	unsigned int primitiveId;
+	unsigned int dirty;
+};
+
+//A Splat's members, without its padding, so that the same scene always writes the same bytes
+class CheckpointSplat
+{
+public:
+	Color4 color;
+	int cornerX;
+	int cornerY;
+	int depth;
+	int size;
+	Vector3F relativePosition;
+	unsigned int primitiveId;
+	unsigned int dirty;
+};
+
+//Followed by the model's x, y and z arrays, the index buffer and a CheckpointMeshFace per face.
+class CheckpointMesh
+{
+public:
+	AffineTransform transform;
+	Vector3F relativePosition;
+	unsigned int vertexCount;
+	unsigned int faceCount;
+};
+
+class CheckpointMeshFace
+{
+public:
+	Color4 color;
+	unsigned int primitiveId;
+	unsigned int dirty;
+};
+
+template <class Element>
+void AppendCheckpointArray(std::vector<char> &data, const Element *arr, size_t count)
+{
+	size_t offset = data.size();
+	data.resize(offset + (count * sizeof(Element) + 7) / 8 * 8);
+	if (count != 0)
+		memcpy(&data[offset], arr, count * sizeof(Element));
+}
+
+//Points arr at the next count elements of the section [data, data + bytes), and moves past them. Returns false if there aren't that many.
+template <class Element>
+bool ReadCheckpointArray(const char *&data, size_t &bytes, const Element *&arr, size_t count)
+{
+	if (count > bytes / sizeof(Element))
+		return false;
+	size_t paddedBytes = (count * sizeof(Element) + 7) / 8 * 8;
+	paddedBytes = (paddedBytes > bytes) ? bytes : paddedBytes;
+	arr = (const Element *)data;
+	data += paddedBytes;
+	bytes -= paddedBytes;
+	return true;
+}
+
+CheckpointTriangle GetCheckpointTriangle(const Triangle &triangle)
+{
+	CheckpointTriangle record = CheckpointTriangle();
+	record.color = triangle.color;
+	for (int i = 0; i < 3; i++)
+		record.vertexArr[i] = triangle.vertexArr[i];
+	record.relativePosition = triangle.relativePosition;
+	record.primitiveId = triangle.primitiveId;
+	record.dirty = triangle.dirty ? 1 : 0;
+	return record;
+}
+
+CheckpointSplat GetCheckpointSplat(const Splat &splat)
+{
+	CheckpointSplat record = CheckpointSplat();
+	record.color = splat.color;
+	record.cornerX = splat.cornerX;
+	record.cornerY = splat.cornerY;
+	record.depth = splat.depth;
+	record.size = splat.size;
+	record.relativePosition = splat.relativePosition;
+	record.primitiveId = splat.primitiveId;
+	record.dirty = splat.dirty ? 1 : 0;
+	return record;
+}
+
+Splat GetSplat(const CheckpointSplat &record)
+{
+	Splat splat;
+	splat.color = record.color;
+	splat.cornerX = record.cornerX;
+	splat.cornerY = record.cornerY;
+	splat.depth = record.depth;
+	splat.size = record.size;
+	splat.relativePosition = record.relativePosition;
+	splat.primitiveId = record.primitiveId;
+	splat.dirty = (record.dirty != 0);
+	return splat;
+}
+
+//Sets triangle up as it was when record was written. If its fragments were resident, they're already in the depth buffer.
+void RestoreTriangle(SolarSystem &system, const RenderContext &context, Triangle &triangle, const CheckpointTriangle &record)
+{
+	if (record.primitiveId == BACKGROUND_PRIMITIVE_ID)
+	{
+		triangle = Triangle(); //Never created
+		return;
+	}
+	triangle.SetUp(record.color, record.vertexArr, record.relativePosition, record.primitiveId);
+	triangle.dirty = (record.dirty != 0);
+	if (!triangle.dirty)
+		SetCoveredSpans(context, triangle);
+	UpdateSpatialGrid(system.spatialGrid, triangle);
+}
+
+//Writes system and context's depth buffer to path, through a temporary file so that a crash never leaves half a checkpoint.
+bool WriteCheckpoint(const std::string &path, const SolarSystem &system, const RenderContext &context)
+{
+	CheckpointHeader header = CheckpointHeader();
+	header.magic = CheckpointHeader::MAGIC;
+	header.version = CheckpointHeader::VERSION;
+	header.width = context.depthBuffer->GetWidth();
+	header.height = context.depthBuffer->GetHeight();
+	strncpy(header.storageName, context.depthBuffer->GetStorageName(), CheckpointHeader::NAME_LENGTH - 1);
+	strncpy(header.blendName, context.depthBuffer->GetName(), CheckpointHeader::NAME_LENGTH - 1);
+	header.depthBits = context.depthBuffer->GetDepthBits();
+	header.antiAliasing = antiAliasing ? 1 : 0;
+	header.renderRowStep = context.depthBuffer->GetRowStep();
+	header.theta = system.theta;
+	header.nextPrimitiveId = nextPrimitiveId;
+	header.random = system.random;
+	header.planetCount = system.planetVec.size();
+	header.asteroidCount = system.asteroidVec.size();
+	header.splatCount = system.asteroidSplatVec.size();
+
+	std::vector<char> data;
+	AppendCheckpointArray(data, &header, 1); //Filled in again once the offsets are known
+
+	std::vector<CheckpointTriangle> triangleVec;
+	triangleVec.push_back(GetCheckpointTriangle(system.sun));
+	triangleVec.push_back(GetCheckpointTriangle(system.alienPlanet));
+	for (unsigned int planet = 0; planet < system.planetVec.size(); planet++)
+		triangleVec.push_back(GetCheckpointTriangle(system.planetVec[planet]));
+	for (unsigned int asteroid = 0; asteroid < system.asteroidVec.size(); asteroid++)
+		triangleVec.push_back(GetCheckpointTriangle(system.asteroidVec[asteroid]));
+	header.triangleOffset = data.size();
+	AppendCheckpointArray(data, &triangleVec[0], triangleVec.size());
+
+	std::vector<CheckpointSplat> splatVec;
+	for (unsigned int splat = 0; splat < system.asteroidSplatVec.size(); splat++)
+		splatVec.push_back(GetCheckpointSplat(system.asteroidSplatVec[splat]));
+	header.splatOffset = data.size();
+	AppendCheckpointArray(data, splatVec.empty() ? NULL : &splatVec[0], splatVec.size());
+
+	CheckpointMesh mesh = CheckpointMesh();
+	mesh.transform = system.alienPlanetRings.transform;
+	mesh.relativePosition = system.alienPlanetRings.relativePosition;
+	mesh.vertexCount = system.alienPlanetRings.modelXVec.size();
+	mesh.faceCount = system.alienPlanetRings.faceVec.size();
+	std::vector<CheckpointMeshFace> faceVec(mesh.faceCount);
+	for (unsigned int face = 0; face < mesh.faceCount; face++)
+	{
+		faceVec[face].color = system.alienPlanetRings.faceVec[face].color;
+		faceVec[face].primitiveId = system.alienPlanetRings.faceVec[face].primitiveId;
+		faceVec[face].dirty = system.alienPlanetRings.faceVec[face].dirty ? 1 : 0;
+	}
+	header.meshOffset = data.size();
+	AppendCheckpointArray(data, &mesh, 1);
+	if (mesh.faceCount != 0)
+	{
+		AppendCheckpointArray(data, &system.alienPlanetRings.modelXVec[0], mesh.vertexCount);
+		AppendCheckpointArray(data, &system.alienPlanetRings.modelYVec[0], mesh.vertexCount);
+		AppendCheckpointArray(data, &system.alienPlanetRings.modelZVec[0], mesh.vertexCount);
+		AppendCheckpointArray(data, &system.alienPlanetRings.indexVec[0], mesh.faceCount * 3);
+		AppendCheckpointArray(data, &faceVec[0], mesh.faceCount);
+	}
+
+	header.depthBufferOffset = data.size();
+	context.depthBuffer->AppendCheckpoint(data);
+	header.depthBufferBytes = data.size() - header.depthBufferOffset;
+	header.fileBytes = data.size();
+	memcpy(&data[0], &header, sizeof(header));
+
+	std::string temporaryPath = path + ".tmp";
+	FILE *file = fopen(temporaryPath.c_str(), "wb");
+	if (file == NULL)
+		return false;
+	bool written = fwrite(&data[0], 1, data.size(), file) == data.size();
+	written = (fclose(file) == 0) && written;
+	if (!written || rename(temporaryPath.c_str(), path.c_str()) != 0)
+	{
+		remove(temporaryPath.c_str());
+		return false;
+	}
+	return true;
+}
+
+/*
+ * Restores system and context's depth buffer from a checkpoint's bytes. Everything is checked
+ * before anything is changed, so on failure the current scene is left as it was.
+ */
+bool RestoreSolarSystem(const char *data, size_t bytes, SolarSystem &system, RenderContext &context)
+{
+	if (bytes < sizeof(CheckpointHeader))
+		return false;
+	CheckpointHeader header;
+	memcpy(&header, data, sizeof(header));
+	header.storageName[CheckpointHeader::NAME_LENGTH - 1] = header.blendName[CheckpointHeader::NAME_LENGTH - 1] = '\0';
+	if (header.magic != CheckpointHeader::MAGIC || header.version != CheckpointHeader::VERSION || header.fileBytes != bytes)
+		return false;
+	if (header.width != context.depthBuffer->GetWidth() || header.height != context.depthBuffer->GetHeight() ||
+		strcmp(header.storageName, context.depthBuffer->GetStorageName()) != 0 || strcmp(header.blendName, context.depthBuffer->GetName()) != 0 ||
+		header.depthBits != context.depthBuffer->GetDepthBits() || header.antiAliasing != (antiAliasing ? 1 : 0) ||
+		header.renderRowStep < 1 || header.renderRowStep > MAX_RENDER_ROW_STEP)
+		return false;
+	unsigned long long offsetArr[4] = { header.triangleOffset, header.splatOffset, header.meshOffset, header.depthBufferOffset };
+	for (int section = 0; section < 4; section++)
+		if (offsetArr[section] % 8 != 0 || offsetArr[section] < sizeof(CheckpointHeader) || offsetArr[section] > bytes)
+			return false;
+	if (header.depthBufferBytes > bytes - header.depthBufferOffset)
+		return false;
+
+	const CheckpointTriangle *triangleArr;
+	const CheckpointSplat *splatArr;
+	const char *section = data + header.triangleOffset;
+	size_t sectionBytes = bytes - header.triangleOffset;
+	if (!ReadCheckpointArray(section, sectionBytes, triangleArr, 2 + (size_t)header.planetCount + header.asteroidCount))
+		return false;
+	section = data + header.splatOffset;
+	sectionBytes = bytes - header.splatOffset;
+	if (!ReadCheckpointArray(section, sectionBytes, splatArr, header.splatCount))
+		return false;
+
+	const CheckpointMesh *mesh;
+	const float *modelXArr = NULL, *modelYArr = NULL, *modelZArr = NULL;
+	const unsigned int *indexArr = NULL;
+	const CheckpointMeshFace *faceArr = NULL;
+	section = data + header.meshOffset;
+	sectionBytes = bytes - header.meshOffset;
+	if (!ReadCheckpointArray(section, sectionBytes, mesh, 1))
+		return false;
+	if (mesh->faceCount != 0 &&
+		(!ReadCheckpointArray(section, sectionBytes, modelXArr, mesh->vertexCount) || !ReadCheckpointArray(section, sectionBytes, modelYArr, mesh->vertexCount) ||
+		!ReadCheckpointArray(section, sectionBytes, modelZArr, mesh->vertexCount) || !ReadCheckpointArray(section, sectionBytes, indexArr, (size_t)mesh->faceCount * 3) ||
+		!ReadCheckpointArray(section, sectionBytes, faceArr, mesh->faceCount)))
+		return false;
+	for (unsigned int index = 0; index < mesh->faceCount * 3; index++)
+		if (indexArr[index] >= mesh->vertexCount)
+			return false;
+
+	if (!context.depthBuffer->RestoreCheckpoint(data + header.depthBufferOffset, header.depthBufferBytes))
+		return false;
+
+	//The fragments are in; now the bodies they belong to.
+	system.theta = header.theta;
+	context.depthBuffer->SetRowStep(header.renderRowStep);
+	nextPrimitiveId = header.nextPrimitiveId;
+	system.random = header.random;
+	system.asteroidTime = 0;
+	system.timeOfLastCreatedAsteroid = -1;
+	system.spatialGrid = SpatialGrid();
+	RestoreTriangle(system, context, system.sun, triangleArr[0]);
+	RestoreTriangle(system, context, system.alienPlanet, triangleArr[1]);
+	system.planetVec.resize(header.planetCount);
+	for (unsigned int planet = 0; planet < header.planetCount; planet++)
+		RestoreTriangle(system, context, system.planetVec[planet], triangleArr[2 + planet]);
+	system.asteroidVec.resize(header.asteroidCount);
+	for (unsigned int asteroid = 0; asteroid < header.asteroidCount; asteroid++)
+		RestoreTriangle(system, context, system.asteroidVec[asteroid], triangleArr[2 + header.planetCount + asteroid]);
+	system.asteroidSplatVec.clear();
+	for (unsigned int splat = 0; splat < header.splatCount; splat++)
+	{
+		system.asteroidSplatVec.push_back(GetSplat(splatArr[splat]));
+		UpdateSpatialGrid(system.spatialGrid, system.asteroidSplatVec[splat]);
+	}
+
+	system.alienPlanetRings = TriangleMesh();
+	if (mesh->faceCount != 0)
+	{
+		system.alienPlanetRings.modelXVec.assign(modelXArr, modelXArr + mesh->vertexCount);
+		system.alienPlanetRings.modelYVec.assign(modelYArr, modelYArr + mesh->vertexCount);
+		system.alienPlanetRings.modelZVec.assign(modelZArr, modelZArr + mesh->vertexCount);
+		system.alienPlanetRings.xVec.resize(mesh->vertexCount);
+		system.alienPlanetRings.yVec.resize(mesh->vertexCount);
+		system.alienPlanetRings.zVec.resize(mesh->vertexCount);
+		system.alienPlanetRings.indexVec.assign(indexArr, indexArr + mesh->faceCount * 3);
+		system.alienPlanetRings.faceVec.resize(mesh->faceCount);
+		for (unsigned int face = 0; face < mesh->faceCount; face++)
+		{
+			MeshFace &meshFace = system.alienPlanetRings.faceVec[face];
+			meshFace.mesh = &system.alienPlanetRings;
+			meshFace.color = faceArr[face].color;
+			meshFace.primitiveId = faceArr[face].primitiveId;
+			for (int i = 0; i < 3; i++)
+				meshFace.indexArr[i] = indexArr[face * 3 + i];
+		}
+		system.alienPlanetRings.SetTransform(mesh->transform);
+		system.alienPlanetRings.relativePosition = mesh->relativePosition;
+		for (unsigned int face = 0; face < mesh->faceCount; face++)
+		{
+			system.alienPlanetRings.faceVec[face].dirty = (faceArr[face].dirty != 0);
+			if (!system.alienPlanetRings.faceVec[face].dirty)
+				SetCoveredSpans(context, system.alienPlanetRings.faceVec[face]);
+		}
+		UpdateSpatialGrid(system.spatialGrid, system.alienPlanetRings);
+	}
+	context.depthBuffer->Resolve(); //Nothing was blended, so nothing was drawn
+	return true;
+}
+
+/*
+ * Restores system and context's depth buffer from the checkpoint at path (see WriteCheckpoint()).
+ * On Linux the file is mapped rather than read, so that only the pages the restore touches are
+ * read in. Returns false if it can't be read, or was written by a different configuration.
+ */
+bool ReadCheckpoint(const std::string &path, SolarSystem &system, RenderContext &context)
+{
+#ifdef __linux__
+	int file = open(path.c_str(), O_RDONLY);
+	if (file < 0)
+		return false;
+	struct stat fileStat;
+	void *memory = (fstat(file, &fileStat) == 0 && fileStat.st_size > 0) ?
+		mmap(NULL, fileStat.st_size, PROT_READ, MAP_PRIVATE, file, 0) : MAP_FAILED;
+	close(file);
+	if (memory == MAP_FAILED)
+		return false;
+	madvise(memory, fileStat.st_size, MADV_SEQUENTIAL);
+	bool restored = RestoreSolarSystem((const char *)memory, fileStat.st_size, system, context);
+	munmap(memory, fileStat.st_size);
+	return restored;
+#else
+	FILE *file = fopen(path.c_str(), "rb");
+	if (file == NULL)
+		return false;
+	std::vector<char> data;
+	char bufferArr[65536];
+	size_t readBytes;
+	while ((readBytes = fread(bufferArr, 1, sizeof(bufferArr), file)) > 0)
+		data.insert(data.end(), bufferArr, bufferArr + readBytes);
+	fclose(file);
+	return !data.empty() && RestoreSolarSystem(&data[0], data.size(), system, context);
+#endif
+}
+
+//Restores the solar system from --restore's checkpoint if one was given, and creates it from scratch otherwise (or if that fails).
+void StartSolarSystem()
+{
+	solarSystem.random.Seed(randomSeed, 0);
+	if (restorePath != NULL)
+	{
+		if (ReadCheckpoint(restorePath, solarSystem, renderContext))
+			return;
+		printf("Couldn't restore the checkpoint %s, starting from scratch.\n", restorePath);
+	}
+	CreateSolarSystem(solarSystem, renderContext);
+}
+
+/*
+ * Renders frameCount frames of the solar system without a window, publishing each one if
+ * there's a --present-shm ring, and reports how long they took. How long the solar system took
+ * to start (created, or restored with --restore) and the first frame to be ready is reported on
+ * its own. The last frame is checkpointed if there's a --checkpoint.
+ */
+int RunHeadless(int frameCount)
+{
+	KernelTimer startTimer, firstFrameTimer, frameTimer;
+	firstFrameTimer.Start();
+	startTimer.Start();
+	StartSolarSystem();
+	startTimer.Stop();
+	frameTimer.Start();
+	for (int frame = 0; frame < frameCount; frame++)
+	{
+		std::chrono::steady_clock::time_point frameStart = std::chrono::steady_clock::now();
+		UpdateSolarSystemWithDebris(solarSystem, renderContext, debrisPerAsteroid);
+		renderContext.depthBuffer->ResolveFrame();
+		SetRenderRowStep(solarSystem, renderContext, resolutionController.AddFrame(std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - frameStart).count(),
+			renderContext.depthBuffer->GetRowStep()));
+		if (presentRing.IsOpen())
+			presentRing.Publish(renderContext.depthBuffer->GetPixelBuffer());
+		if (frame == 0)
+		{
+			firstFrameTimer.Stop();
+			printf("Started the solar system in %.3f ms, first frame ready after %.3f ms\n", startTimer.totalNanoseconds / 1000000.0,
+				firstFrameTimer.totalNanoseconds / 1000000.0);
+		}
+	}
+	frameTimer.Stop();
+	printf("Rendered %d frames, %.3f ms per frame\n", frameCount, (frameCount == 0) ? 0.0 : frameTimer.totalNanoseconds / frameCount / 1000000.0);
+	if (resolutionController.IsEnabled())
+		printf("Held a %.3f ms frame target by changing the resolution %u times, ending on every %u row(s)\n",
+			resolutionController.GetTargetMilliseconds(), resolutionController.GetChangeCount(), renderContext.depthBuffer->GetRowStep());
+
+	if (checkpointPath != NULL)
+	{
+		KernelTimer checkpointTimer;
+		checkpointTimer.Start();
+		bool written = WriteCheckpoint(checkpointPath, solarSystem, renderContext);
+		checkpointTimer.Stop();
+		if (!written)
+		{
+			printf("Couldn't write the checkpoint %s.\n", checkpointPath);
+			return 1;
+		}
+		printf("Wrote the checkpoint %s in %.3f ms\n", checkpointPath, checkpointTimer.totalNanoseconds / 1000000.0);
+	}
+	ReportFragmentUsage();
+	return 0;
+}
+
+//Reports how much memory the depth buffer's fragments take, and the regions and primitives that take the most.
+void ReportFragmentUsage()
+{
+	const unsigned int LISTED_COUNT = 3;
+	const double MB = 1024.0 * 1024.0;
+	FragmentUsage usage;
+	renderContext.depthBuffer->GetFragmentUsage(usage);
+	printf("Fragments: %.3f MB now, %.3f MB at peak, %.3f MB held", usage.currentBytes / MB, usage.peakBytes / MB, usage.heldBytes / MB);
+	if (usage.budgetBytes != 0)
+		printf(", %.3f MB budget, %llu merged", usage.budgetBytes / MB, usage.mergedCount);
+	printf("\n");
+
+	std::vector<unsigned int> regionVec;
+	for (unsigned int region = 0; region < usage.regionBytesVec.size(); region++)
+		regionVec.push_back(region);
+	std::sort(regionVec.begin(), regionVec.end(), [&usage](unsigned int a, unsigned int b)
+	{
+		return usage.regionBytesVec[a] > usage.regionBytesVec[b];
+	});
+	unsigned int regionColumns = (WINDOW_WIDTH + GRID_CELL_SIZE - 1) / GRID_CELL_SIZE;
+	for (unsigned int i = 0; i < LISTED_COUNT && i < regionVec.size() && usage.regionBytesVec[regionVec[i]] != 0; i++)
+		printf("  region at (%u, %u): %.3f MB\n", (regionVec[i] % regionColumns) * GRID_CELL_SIZE, (regionVec[i] / regionColumns) * GRID_CELL_SIZE,
+			usage.regionBytesVec[regionVec[i]] / MB);
+	for (unsigned int i = 0; i < LISTED_COUNT && i < usage.primitiveBytesVec.size(); i++)
+		printf("  primitive %u: %.3f MB\n", usage.primitiveBytesVec[i].first, usage.primitiveBytesVec[i].second / MB);
+}
+
+/*
+ * One solar system, rendered on its own into whichever RenderContext it's given. Asteroids are
+ * spawned every frame they're allowed to, the same as RenderSolarSystemScene() spawns them, so
+ * a scene's frames depend only on its seed and not on what else is rendered alongside it.
+ */
+class Scene
+{
+public:
+	/*
+	 * Constructor
+	 */
+	Scene(unsigned long long newSeed = 1, int newFrameCount = 0)
+	{
+		seed = newSeed;
+		frameCount = newFrameCount;
+		checksum = 0;
+	}
+
+	/*
+	 * Mutators
+	 */
+	//Creates the solar system in context, which is cleared first, renders all of its frames and takes the last one's checksum.
+	void Render(RenderContext &context)
+	{
+		nextPrimitiveId = BACKGROUND_PRIMITIVE_ID + 1;
+		context.depthBuffer->SetRowStep(1);
+		context.depthBuffer->Clear();
+		system.random.Seed(seed, 0);
+		startTimer.Start();
+		CreateSolarSystem(system, context);
+		startTimer.Stop();
+
+		for (int frame = 0; frame < frameCount; frame++)
+		{
+			frameTimer.Start();
+			system.timeOfLastCreatedAsteroid = GetAsteroidTime(system) - NEEDED_ELAPSED_TIME;
+			UpdateSolarSystem(system, context);
+			context.depthBuffer->ResolveFrame();
+			frameTimer.Stop();
+		}
+
+		std::vector<unsigned char> frame;
+		CaptureFrame(context, frame);
+		checksum = 2166136261u; //FNV-1a
+		for (unsigned int byte = 0; byte < frame.size(); byte++)
+			checksum = (checksum ^ frame[byte]) * 16777619u;
+		system = SolarSystem(); //Its fragments are left for the next scene rendered into context to clear
+	}
+
+public:
+	unsigned long long seed;
+	int frameCount;
+	unsigned int checksum; //Of the last frame, once it's rendered
+	KernelTimer startTimer;
+	KernelTimer frameTimer;
+private:
+	SolarSystem system;
+};
+
+/*
+ * Renders sceneCount independent solar systems for frameCount frames each, seeded randomSeed,
+ * randomSeed + 1 and so on, in one process. The scenes are tasks on the worker pool: up to
+ * liveSceneCount workers each take the next scene waiting and render all of its frames into a
+ * RenderContext of their own, so scenes run at the same time without sharing a buffer. The
+ * first context is renderContext, and the rest get depth buffers configured the same, with
+ * their own pixel buffers and fragment stores. Each scene's start time, time per frame and last
+ * frame's checksum are reported once they're all done.
+ */
+int RunScenes(int sceneCount, int liveSceneCount, int frameCount)
+{
+	unsigned int runnerCount = workerPool.GetWorkerCount();
+	runnerCount = (runnerCount > (unsigned int)liveSceneCount) ? (unsigned int)liveSceneCount : runnerCount;
+	runnerCount = (runnerCount > (unsigned int)sceneCount) ? (unsigned int)sceneCount : runnerCount;
+
+	KernelTimer totalTimer;
+	totalTimer.Start();
+	DepthBuffer *firstDepthBuffer = renderContext.depthBuffer;
+	std::deque<FragmentStore> fragmentStoreDeque(runnerCount - 1);
+	std::vector<RenderContext> contextVec(1, renderContext);
+	for (unsigned int context = 1; context < runnerCount; context++)
+	{
+		DepthBuffer *contextDepthBuffer = NewDepthBuffer(firstDepthBuffer->GetStorageName(), firstDepthBuffer->GetName(), firstDepthBuffer->GetDepthBits(),
+			firstDepthBuffer->GetWidth(), firstDepthBuffer->GetHeight());
+		contextDepthBuffer->SetPixelBuffer(NewPixelBuffer());
+		contextDepthBuffer->SetFragmentBudget(firstDepthBuffer->GetFragmentBudget());
+		contextVec.push_back(RenderContext(contextDepthBuffer, &fragmentStoreDeque[context - 1]));
+	}
+
+	std::vector<Scene> sceneVec;
+	for (int scene = 0; scene < sceneCount; scene++)
+		sceneVec.push_back(Scene(randomSeed + scene, frameCount));
+	std::atomic<int> nextScene(0);
+	workerPool.Run([&](unsigned int workerIndex)
+	{
+		if (workerIndex >= runnerCount)
+			return;
+		for (int scene = nextScene++; scene < sceneCount; scene = nextScene++)
+			sceneVec[scene].Render(contextVec[workerIndex]);
+	});
+	totalTimer.Stop();
+
+	for (int scene = 0; scene < sceneCount; scene++)
+		printf("Scene %2d (seed %llu): started in %.3f ms, %.3f ms per frame, checksum %08x\n", scene, sceneVec[scene].seed,
+			sceneVec[scene].startTimer.totalNanoseconds / 1000000.0,
+			(frameCount == 0) ? 0.0 : sceneVec[scene].frameTimer.totalNanoseconds / frameCount / 1000000.0, sceneVec[scene].checksum);
+	printf("Rendered %d scenes of %d frames, %u at a time, in %.3f ms (%.3f ms per frame)\n", sceneCount, frameCount, runnerCount,
+		totalTimer.totalNanoseconds / 1000000.0, totalTimer.totalNanoseconds / ((double)sceneCount * frameCount) / 1000000.0);
+
+	for (unsigned int context = 1; context < contextVec.size(); context++)
+	{
+		FreeLargeBuffer(contextVec[context].depthBuffer->GetPixelBuffer(), WINDOW_WIDTH * WINDOW_HEIGHT * 3 * sizeof(float));
+		delete contextVec[context].depthBuffer;
+	}
+	return 0;
+}
+
+/*
+ * The reference consumer of --present-shm. Maps the ring called name read-only and follows
+ * its frames as they're published, until frameCount have been read or none has arrived for
+ * VIEWER_TIMEOUT_MS. Each frame is read in place: its mean brightness and checksum are
+ * printed, and it's written to dumpDirectory as a PPM if one was given. Frames published
+ * while the last one was being read are counted as skipped, and frames that were overwritten
+ * while being read as torn.
+ */
+int RunFrameViewer(const char *name, int frameCount, const char *dumpDirectory)
+{
+	const int VIEWER_TIMEOUT_MS = 5000;
+	SharedFrameRing ring;
+	if (!ring.Open(name))
+	{
+		printf("There's no shared-memory frame ring called %s.\n", name);
+		return 1;
+	}
+	unsigned int width = ring.GetHeader().width, height = ring.GetHeader().height;
+
+	int framesRead = 0, framesSkipped = 0, framesTorn = 0;
+	unsigned long long lastFrame = ring.GetLatestFrame();
+	std::chrono::steady_clock::time_point lastArrival = std::chrono::steady_clock::now();
+	while (framesRead < frameCount)
+	{
+		unsigned long long frame = ring.GetLatestFrame();
+		if (frame == lastFrame)
+		{
+			if (std::chrono::steady_clock::now() - lastArrival > std::chrono::milliseconds(VIEWER_TIMEOUT_MS))
+				break;
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			continue;
+		}
+		framesSkipped += (lastFrame == 0) ? 0 : (int)(frame - lastFrame - 1);
+		lastFrame = frame;
+		lastArrival = std::chrono::steady_clock::now();
+
+		const unsigned char *pixels = ring.GetFrame(frame);
+		if (pixels == NULL)
+		{
+			framesTorn++;
+			continue;
+		}
+		unsigned long long sum = 0;
+		unsigned int checksum = 2166136261u; //FNV-1a
+		for (unsigned int byte = 0; byte < width * height * 3; byte++)
+		{
+			sum += pixels[byte];
+			checksum = (checksum ^ pixels[byte]) * 16777619u;
+		}
+		char path[512] = "";
+		if (dumpDirectory != NULL)
+		{
+			snprintf(path, sizeof(path), "%s/frame-%06llu.ppm", dumpDirectory, frame);
+			WritePPM(path, pixels, width, height);
+		}
+		if (!ring.IsFrameIntact(frame))
+		{
+			if (dumpDirectory != NULL)
+				remove(path);
+			framesTorn++;
+			continue;
+		}
+
+		printf("frame %6llu  %ux%u  mean %6.2f  checksum %08x\n", frame, width, height, (double)sum / (width * height * 3), checksum);
+		framesRead++;
+	}
+	printf("%d frames read, %d skipped, %d torn\n", framesRead, framesSkipped, framesTorn);
+	return (framesRead == frameCount) ? 0 : 1;
+}